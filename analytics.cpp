@@ -0,0 +1,416 @@
+/*
+ * This file contains the implementation of corpus analytics: solved problems stored column by column, with filter and
+ * aggregate kernels that scan whole columns and a small query API on top
+ */
+#include <chrono>
+#include <cmath>
+#include <random>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#include "analytics.h"
+#include "bitboard.h"
+#include "error.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kNumSmallColumns = 7;
+
+/* This function takes in a count and returns it capped to fit a byte column.
+ */
+static uint8_t capByte(int count) {
+    return uint8_t(std::max(0, std::min(count, 255)));
+}
+
+void CorpusColumns::addRow(int king, int queens, int rooks, int bishops, int knights, int active, long nodes,
+                           float micros) {
+    int values[kNumSmallColumns] = {king, queens, rooks, bishops, knights, queens + rooks + bishops + knights + 1,
+                                    active};
+    for (int column = 0; column < kNumSmallColumns; column++) {
+        _small[column].push_back(capByte(values[column]));
+    }
+    _nodes.push_back(nodes);
+    _micros.push_back(micros);
+}
+
+/* This function takes in a problem and its run and appends a row. A placed piece is active if it attacks a square
+ * around the king with every placed piece blocking, worked out from the run's result without the board.
+ */
+void CorpusColumns::add(const Problem &problem, const EngineRun &run) {
+    int counts[4] = {};
+    for (char piece : problem.pieces) {
+        size_t type = string("QRBH").find(piece);
+        if (type != string::npos) {
+            counts[type]++;
+        }
+    }
+    int kingSquare = problem.kingLoc.row * 8 + problem.kingLoc.col;
+    uint64_t around = attackMask('K', kingSquare, 0);
+    uint64_t occupied = uint64_t(1) << kingSquare;
+    for (char piece : run.result) {
+        for (GridLocation loc : run.result.get(piece)) {
+            occupied |= uint64_t(1) << (loc.row * 8 + loc.col);
+        }
+    }
+    int active = 0;
+    for (char piece : run.result) {
+        for (GridLocation loc : run.result.get(piece)) {
+            active += (attackMask(piece, loc.row * 8 + loc.col, occupied) & around) != 0;
+        }
+    }
+    addRow(kingSquare, counts[0], counts[1], counts[2], counts[3], active, run.nodes, run.micros);
+    _small[int(Column::Pieces)].back() = capByte(problem.pieces.size());
+}
+
+double CorpusColumns::value(Column column, long row) const {
+    if (column == Column::Nodes) {
+        return _nodes[row];
+    }
+    if (column == Column::Micros) {
+        return _micros[row];
+    }
+    return _small[int(column)][row];
+}
+
+long CorpusColumns::size() const {
+    return _nodes.size();
+}
+
+CorpusQuery::CorpusQuery(const CorpusColumns &corpus) : _corpus(corpus) {
+    long rows = corpus.size();
+    _selected.assign((rows + 63) / 64, ~uint64_t(0));
+    if (rows % 64) {
+        _selected.back() = (uint64_t(1) << (rows % 64)) - 1;
+    }
+}
+
+/* This function takes in 64 bytes and a range [low, low + span] and returns a bit per byte inside it. Subtracting low
+ * wraps the bytes below the range past the top, so one unsigned comparison tests both ends; with SSE2 it runs sixteen
+ * bytes per instruction, taking the maximum with span and comparing for equality since there is no unsigned
+ * less-than.
+ */
+static uint64_t rangeBits(const uint8_t *data, uint8_t low, uint8_t span) {
+    uint64_t bits = 0;
+#if defined(__SSE2__)
+    __m128i lows = _mm_set1_epi8(char(low));
+    __m128i spans = _mm_set1_epi8(char(span));
+    for (int part = 0; part < 4; part++) {
+        __m128i shifted = _mm_sub_epi8(_mm_loadu_si128((const __m128i *) (data + part * 16)), lows);
+        __m128i inside = _mm_cmpeq_epi8(_mm_max_epu8(shifted, spans), spans);
+        bits |= uint64_t(uint16_t(_mm_movemask_epi8(inside))) << (part * 16);
+    }
+#else
+    for (int i = 0; i < 64; i++) {
+        bits |= uint64_t(uint8_t(data[i] - low) <= span) << i;
+    }
+#endif
+    return bits;
+}
+
+/* This function takes in a byte column, the inclusive range to keep and the selection, and clears the bits of rows
+ * outside the range, a word of 64 rows at a time with the last partial word done byte by byte.
+ */
+static void filterBytes(const vector<uint8_t> &data, int low, int high, vector<uint64_t> &selected) {
+    if (low > high) {
+        fill(selected.begin(), selected.end(), 0);
+        return;
+    }
+    long rows = data.size();
+    long words = rows / 64;
+    for (long word = 0; word < words; word++) {
+        selected[word] &= rangeBits(data.data() + word * 64, uint8_t(low), uint8_t(high - low));
+    }
+    if (rows % 64) {
+        uint64_t bits = 0;
+        for (long row = words * 64; row < rows; row++) {
+            bits |= uint64_t(data[row] >= low && data[row] <= high) << (row - words * 64);
+        }
+        selected[words] &= bits;
+    }
+}
+
+/* This function takes in a wide column, a comparison, a value and the selection, and clears the bits of rows that
+ * compare false. The comparison is chosen once outside the loop, so each loop body is a plain comparison the compiler
+ * can vectorise.
+ */
+template <typename T>
+static void filterWide(const vector<T> &data, Compare compare, double value, vector<uint64_t> &selected) {
+    long rows = data.size();
+    for (long word = 0; word * 64 < rows; word++) {
+        const T *block = data.data() + word * 64;
+        int count = int(std::min<long>(64, rows - word * 64));
+        uint64_t bits = 0;
+        switch (compare) {
+            case Compare::Less:
+                for (int i = 0; i < count; i++) bits |= uint64_t(double(block[i]) < value) << i;
+                break;
+            case Compare::LessEqual:
+                for (int i = 0; i < count; i++) bits |= uint64_t(double(block[i]) <= value) << i;
+                break;
+            case Compare::Equal:
+                for (int i = 0; i < count; i++) bits |= uint64_t(double(block[i]) == value) << i;
+                break;
+            case Compare::GreaterEqual:
+                for (int i = 0; i < count; i++) bits |= uint64_t(double(block[i]) >= value) << i;
+                break;
+            case Compare::Greater:
+                for (int i = 0; i < count; i++) bits |= uint64_t(double(block[i]) > value) << i;
+                break;
+        }
+        selected[word] &= bits;
+    }
+}
+
+/* This function takes in a column, comparison and value. A byte column turns the comparison into an inclusive range
+ * of byte values for filterBytes; the others compare directly.
+ */
+CorpusQuery &CorpusQuery::where(Column column, Compare compare, double value) {
+    if (column == Column::Nodes) {
+        filterWide(_corpus._nodes, compare, value, _selected);
+    } else if (column == Column::Micros) {
+        filterWide(_corpus._micros, compare, value, _selected);
+    } else {
+        double low = 0;
+        double high = 255;
+        switch (compare) {
+            case Compare::Less:
+                high = ceil(value) - 1;
+                break;
+            case Compare::LessEqual:
+                high = floor(value);
+                break;
+            case Compare::Equal:
+                low = ceil(value);
+                high = floor(value);
+                break;
+            case Compare::GreaterEqual:
+                low = ceil(value);
+                break;
+            case Compare::Greater:
+                low = floor(value) + 1;
+                break;
+        }
+        // a value far outside the byte range must not reach the int conversion, and NaN compares false to everything
+        low = isnan(value) ? 256 : std::min(std::max(low, 0.0), 256.0);
+        high = isnan(value) ? -1 : std::max(std::min(high, 255.0), -1.0);
+        filterBytes(_corpus._small[int(column)], int(low), int(high), _selected);
+    }
+    return *this;
+}
+
+long CorpusQuery::count() const {
+    long total = 0;
+    for (uint64_t word : _selected) {
+        total += countSquares(word);
+    }
+    return total;
+}
+
+/* This function takes in a column and the selection and returns the sum of the selected values. A fully selected word
+ * is summed straight through in the column's own type, widened from bytes, which vectorises, and any other word by its
+ * set bits.
+ */
+template <typename T>
+static double sumSelected(const vector<T> &data, const vector<uint64_t> &selected) {
+    double total = 0;
+    for (size_t word = 0; word < selected.size(); word++) {
+        const T *block = data.data() + word * 64;
+        if (selected[word] == ~uint64_t(0)) {
+            auto partial = T() + 0;
+            for (int i = 0; i < 64; i++) {
+                partial += block[i];
+            }
+            total += partial;
+        } else {
+            for (uint64_t bits = selected[word]; bits; bits &= bits - 1) {
+                total += block[lowestSquare(bits)];
+            }
+        }
+    }
+    return total;
+}
+
+double CorpusQuery::sum(Column column) const {
+    if (column == Column::Nodes) {
+        return sumSelected(_corpus._nodes, _selected);
+    }
+    if (column == Column::Micros) {
+        return sumSelected(_corpus._micros, _selected);
+    }
+    return sumSelected(_corpus._small[int(column)], _selected);
+}
+
+double CorpusQuery::mean(Column column) const {
+    long rows = count();
+    return rows == 0 ? 0 : sum(column) / rows;
+}
+
+double CorpusQuery::max(Column column) const {
+    double largest = 0;
+    bool any = false;
+    for (size_t word = 0; word < _selected.size(); word++) {
+        for (uint64_t bits = _selected[word]; bits; bits &= bits - 1) {
+            double value = _corpus.value(column, word * 64 + lowestSquare(bits));
+            largest = any ? std::max(largest, value) : value;
+            any = true;
+        }
+    }
+    return largest;
+}
+
+Vector<long> CorpusQuery::countBy(Column key) const {
+    if (key == Column::Nodes || key == Column::Micros) {
+        error("countBy needs a column of small values");
+    }
+    const vector<uint8_t> &keys = _corpus._small[int(key)];
+    Vector<long> counts(256, 0);
+    for (size_t word = 0; word < _selected.size(); word++) {
+        for (uint64_t bits = _selected[word]; bits; bits &= bits - 1) {
+            counts[keys[word * 64 + lowestSquare(bits)]]++;
+        }
+    }
+    return counts;
+}
+
+Vector<double> CorpusQuery::meanBy(Column key, Column column) const {
+    Vector<long> counts = countBy(key);
+    const vector<uint8_t> &keys = _corpus._small[int(key)];
+    Vector<double> sums(256, 0);
+    for (size_t word = 0; word < _selected.size(); word++) {
+        for (uint64_t bits = _selected[word]; bits; bits &= bits - 1) {
+            long row = word * 64 + lowestSquare(bits);
+            sums[keys[row]] += _corpus.value(column, row);
+        }
+    }
+    for (int value = 0; value < 256; value++) {
+        sums[value] = counts[value] == 0 ? 0 : sums[value] / counts[value];
+    }
+    return sums;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/** A solved problem as one record, the layout the columns replace
+ */
+struct SolveRecord {
+    int king;
+    int counts[4];
+    int pieces;
+    int active;
+    long nodes;
+    float micros;
+};
+
+PROVIDED_TEST("Corpus queries match a scan of records") {
+    CorpusColumns corpus;
+    Vector<SolveRecord> records;
+    mt19937_64 random(94);
+    for (int i = 0; i < 1000; i++) {
+        SolveRecord record = {int(random() % 64), {int(random() % 4), int(random() % 4), int(random() % 3),
+                              int(random() % 3)}, 0, int(random() % 7), long(random() % 100000),
+                              float(random() % 5000) / 4};
+        record.pieces = record.counts[0] + record.counts[1] + record.counts[2] + record.counts[3] + 1;
+        records.add(record);
+        corpus.addRow(record.king, record.counts[0], record.counts[1], record.counts[2], record.counts[3],
+                      record.active, record.nodes, record.micros);
+    }
+    CorpusQuery query(corpus);
+    query.where(Column::Active, Compare::GreaterEqual, 4).where(Column::Nodes, Compare::Less, 50000)
+         .where(Column::Queens, Compare::Equal, 1).where(Column::Micros, Compare::Greater, 300.5);
+    long expected = 0;
+    double nodes = 0;
+    Vector<long> byKing(256, 0);
+    for (const SolveRecord &record : records) {
+        if (record.active >= 4 && record.nodes < 50000 && record.counts[0] == 1 && record.micros > 300.5) {
+            expected++;
+            nodes += record.nodes;
+            byKing[record.king]++;
+        }
+    }
+    EXPECT(expected > 0);
+    EXPECT_EQUAL(query.count(), expected);
+    EXPECT_EQUAL(query.sum(Column::Nodes), nodes);
+    EXPECT_EQUAL(query.countBy(Column::King), byKing);
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Rooks, Compare::Less, 0.5).count(),
+                 CorpusQuery(corpus).where(Column::Rooks, Compare::Equal, 0).count());
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Rooks, Compare::Equal, 0.5).count(), 0);
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Active, Compare::Greater, 1e10).count(), 0);
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Active, Compare::Less, -1e10).count(), 0);
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Active, Compare::Less, 1e10).count(), corpus.size());
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Active, Compare::Greater, -1e10).count(), corpus.size());
+    EXPECT_EQUAL(CorpusQuery(corpus).where(Column::Active, Compare::Equal, nan("")).count(), 0);
+    EXPECT_EQUAL(CorpusQuery(corpus).sum(Column::Pieces), corpus.size() + CorpusQuery(corpus).sum(Column::Queens)
+                 + CorpusQuery(corpus).sum(Column::Rooks) + CorpusQuery(corpus).sum(Column::Bishops)
+                 + CorpusQuery(corpus).sum(Column::Knights));
+    EXPECT_ERROR(CorpusQuery(corpus).countBy(Column::Nodes));
+}
+
+PROVIDED_TEST("Corpus columns from solved problems") {
+    Vector<Problem> problems = generateCorpus(940, 50, 10);
+    CorpusColumns corpus;
+    for (const Problem &problem : problems) {
+        corpus.add(problem, runEngine(findEngine("sorted-greedy"), problem.kingLoc, problem.pieces));
+    }
+    EXPECT_EQUAL(corpus.size(), long(problems.size()));
+    CorpusQuery all(corpus);
+    for (int row = 0; row < problems.size(); row++) {
+        EXPECT_EQUAL(corpus.value(Column::Pieces, row), problems[row].pieces.size());
+        EXPECT(corpus.value(Column::Active, row) >= 1);
+        EXPECT(corpus.value(Column::Active, row) <= problems[row].pieces.size());
+    }
+    Vector<long> squares = CorpusQuery(corpus).where(Column::Active, Compare::GreaterEqual, 4).countBy(Column::King);
+    cout << "Mean active pieces " << all.mean(Column::Active) << ", most " << all.max(Column::Active)
+         << ", king squares needing 4+:";
+    for (int square = 0; square < 64; square++) {
+        if (squares[square] > 0) {
+            cout << " r" << square / 8 << "c" << square % 8;
+        }
+    }
+    cout << endl;
+    clearBoard();
+}
+
+PROVIDED_TEST("Column scans against record scans") {
+    const int rows = 1 << 22;
+    CorpusColumns corpus;
+    Vector<SolveRecord> records;
+    mt19937_64 random(4);
+    for (int i = 0; i < rows; i++) {
+        SolveRecord record = {int(random() % 64), {int(random() % 5), int(random() % 5), int(random() % 5),
+                              int(random() % 5)}, 0, int(random() % 9), long(random() % 1000000),
+                              float(random() % 100000) / 8};
+        record.pieces = record.counts[0] + record.counts[1] + record.counts[2] + record.counts[3] + 1;
+        records.add(record);
+        corpus.addRow(record.king, record.counts[0], record.counts[1], record.counts[2], record.counts[3],
+                      record.active, record.nodes, record.micros);
+    }
+    auto start = chrono::steady_clock::now();
+    Vector<long> byRecord(64, 0);
+    double recordNodes = 0;
+    for (const SolveRecord &record : records) {
+        if (record.active >= 4 && record.pieces <= 12) {
+            byRecord[record.king]++;
+            recordNodes += record.nodes;
+        }
+    }
+    double recordMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    CorpusQuery query(corpus);
+    query.where(Column::Active, Compare::GreaterEqual, 4).where(Column::Pieces, Compare::LessEqual, 12);
+    Vector<long> byColumn = query.countBy(Column::King);
+    double columnNodes = query.sum(Column::Nodes);
+    double columnMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+    for (int square = 0; square < 64; square++) {
+        EXPECT_EQUAL(byColumn[square], byRecord[square]);
+    }
+    EXPECT_EQUAL(columnNodes, recordNodes);
+    start = chrono::steady_clock::now();
+    long selected = CorpusQuery(corpus).where(Column::Active, Compare::GreaterEqual, 4).count();
+    double filterMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    cout << rows << " rows: records " << recordMillis << " ms, columns " << columnMillis << " ms, one filter "
+         << filterMillis << " ms (" << rows / filterMillis / 1e6 << " GB/s of the column, " << selected
+         << " selected)" << endl;
+}
@@ -0,0 +1,154 @@
+/*
+ * This file contains the declarations for corpus analytics: solved problems stored column by column, with filter and
+ * aggregate kernels that scan whole columns and a small query API on top
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "vector.h"
+#include "engines.h"
+#include "martin.h"
+
+/** The columns of a solved corpus
+ */
+enum class Column {
+    King,       // king square, row * 8 + col
+    Queens,
+    Rooks,
+    Bishops,
+    Knights,
+    Pieces,     // pieces besides the opponent king
+    Active,     // placed pieces attacking a square around the king
+    Nodes,      // search nodes
+    Micros      // solve time
+};
+
+/** Comparison a filter applies between a column and a value
+ */
+enum class Compare {
+    Less,
+    LessEqual,
+    Equal,
+    GreaterEqual,
+    Greater
+};
+
+/** A solved corpus held as one array per column, so a scan reads only the columns it needs, contiguously
+ */
+class CorpusColumns {
+public:
+    /**
+     * Append a solved problem
+     * @param the problem and the engine's run on it
+     *
+     * This function runs in O(n) for n pieces
+     */
+    void add(const Problem &problem, const EngineRun &run);
+
+    /**
+     * Append a row directly, each count capped at 255
+     * @param king square, piece counts, active pieces, nodes and time
+     *
+     * This function runs in O(1) amortised
+     */
+    void addRow(int king, int queens, int rooks, int bishops, int knights, int active, long nodes, float micros);
+
+    /**
+     * Value of one cell
+     * @param column and row
+     * @return the value as a double
+     *
+     * This function runs in O(1)
+     */
+    double value(Column column, long row) const;
+
+    long size() const;
+
+private:
+    friend class CorpusQuery;
+
+    std::vector<uint8_t> _small[7];     // King through Active, indexed by Column
+    std::vector<int64_t> _nodes;
+    std::vector<float> _micros;
+};
+
+/** A filter over a corpus kept as a bitmap of selected rows, one bit per row, narrowed by each where and read by the
+ * aggregates
+ */
+class CorpusQuery {
+public:
+    /**
+     * Start with every row selected
+     * @param corpus, which must outlive the query
+     *
+     * This function runs in O(n / 64) for n rows
+     */
+    CorpusQuery(const CorpusColumns &corpus);
+
+    /**
+     * Keep only the rows whose column compares true with a value
+     * @param column, comparison and value
+     * @return this query, so filters can be chained
+     *
+     * This function runs in O(n) for n rows
+     */
+    CorpusQuery &where(Column column, Compare compare, double value);
+
+    /**
+     * Number of selected rows
+     * @return count
+     *
+     * This function runs in O(n / 64) for n rows
+     */
+    long count() const;
+
+    /**
+     * Sum of a column over the selected rows
+     * @param column
+     * @return sum
+     *
+     * This function runs in O(n) for n rows
+     */
+    double sum(Column column) const;
+
+    /**
+     * Mean of a column over the selected rows
+     * @param column
+     * @return mean, 0 if no row is selected
+     *
+     * This function runs in O(n) for n rows
+     */
+    double mean(Column column) const;
+
+    /**
+     * Largest value of a column over the selected rows
+     * @param column
+     * @return maximum, 0 if no row is selected
+     *
+     * This function runs in O(n) for n rows
+     */
+    double max(Column column) const;
+
+    /**
+     * Selected rows for each value of a column of small values, such as the king square
+     * @param column from King to Active
+     * @return count for each value from 0 to 255
+     *
+     * This function runs in O(n) for n rows
+     */
+    Vector<long> countBy(Column key) const;
+
+    /**
+     * Mean of a column for each value of a column of small values
+     * @param key column from King to Active, and the column to average
+     * @return mean for each value from 0 to 255, 0 where no row is selected
+     *
+     * This function runs in O(n) for n rows
+     */
+    Vector<double> meanBy(Column key, Column column) const;
+
+private:
+    const CorpusColumns &_corpus;
+    std::vector<uint64_t> _selected;
+};
@@ -0,0 +1,294 @@
+/*
+ * This file contains the implementation of the solvable antichain: per canonical king square, the minimal piece
+ * multisets known to stalemate, indexed with bit-sliced counts so any problem holding one of them is answered at once
+ */
+#include <chrono>
+#include "antichain.h"
+#include "bitboard.h"
+#include "engines.h"
+#include "error.h"
+#include "patterns.h"
+#include "sat.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kFieldBits = 5;
+static const int kSliceBits = 4;
+
+/* This function takes in a chain and rebuilds its slices from the entries' packed counts.
+ */
+void SolvableAntichain::rebuildSlices(KingChain &chain) {
+    size_t words = (chain.counts.size() + 63) / 64;
+    for (int type = 0; type < 5; type++) {
+        for (int bit = 0; bit < kSliceBits; bit++) {
+            chain.slices[type][bit].assign(words, 0);
+        }
+    }
+    for (int i = 0; i < chain.counts.size(); i++) {
+        for (int type = 0; type < 5; type++) {
+            int count = (chain.counts[i] >> (type * kFieldBits)) & 31;
+            for (int bit = 0; bit < kSliceBits; bit++) {
+                if (count & (1 << bit)) {
+                    chain.slices[type][bit][i / 64] |= uint64_t(1) << (i % 64);
+                }
+            }
+        }
+    }
+}
+
+/* This function takes in a placement and returns its pieces in canonical order with their locations in the same order.
+ */
+static DbEntry placementEntry(GridLocation kingLoc, Map<char, Vector<GridLocation>> &placement) {
+    DbEntry entry;
+    entry.kingLoc = kingLoc;
+    for (char piece : placement) {
+        for (int i = 0; i < placement[piece].size(); i++) {
+            entry.pieces.add(piece);
+        }
+    }
+    entry.pieces = canonicalPieces(entry.pieces);
+    for (int i = 0; i < entry.pieces.size(); i++) {
+        if (i == 0 || entry.pieces[i] != entry.pieces[i - 1]) {
+            for (GridLocation loc : placement[entry.pieces[i]]) {
+                entry.locs.add(loc);
+            }
+        }
+    }
+    return entry;
+}
+
+/* This function takes in a verified stalemate, moves it onto the canonical king square and shrinks it: each piece in
+ * turn is taken out and left out if verifyStalemate still accepts the rest. The shrunken multiset is then compared
+ * with the chain: if a kept one is contained in it nothing changes, and otherwise the kept ones containing it are
+ * dropped and it is added.
+ */
+bool SolvableAntichain::insert(GridLocation kingLoc, Map<char, Vector<GridLocation>> placement) {
+    Vector<char> pieces;
+    for (char piece : placement) {
+        for (int i = 0; i < placement[piece].size(); i++) {
+            pieces.add(piece);
+        }
+    }
+    if (!verifyStalemate(kingLoc, pieces, placement)) {
+        error("SolvableAntichain only learns verified stalemates");
+    }
+    int symmetry = canonicalSymmetry(kingLoc);
+    GridLocation canonicalKing = transformLoc(kingLoc, symmetry);
+    placement = transformPlacement(placement, symmetry);
+    for (char piece : placement.keys()) {
+        for (int i = placement[piece].size() - 1; i >= 0; i--) {
+            Map<char, Vector<GridLocation>> smaller = placement;
+            smaller[piece].remove(i);
+            if (smaller[piece].isEmpty()) {
+                smaller.remove(piece);
+            }
+            Vector<char> rest = pieces;
+            rest.remove(rest.indexOf(piece));
+            if (verifyStalemate(canonicalKing, rest, smaller)) {
+                placement = smaller;
+                pieces = rest;
+            }
+        }
+    }
+
+    DbEntry entry = placementEntry(canonicalKing, placement);
+    int counts = packPieceCounts(entry.pieces);
+    KingChain &chain = _chains[canonicalKingIndex(canonicalKing)];
+    if (!subsetsOf(canonicalKing, counts).isEmpty()) {
+        return false;
+    }
+    KingChain kept;
+    for (int i = 0; i < chain.entries.size(); i++) {
+        if (!piecesAvailable(counts, chain.counts[i])) {
+            kept.entries.add(chain.entries[i]);
+            kept.counts.add(chain.counts[i]);
+        }
+    }
+    _size += kept.entries.size() + 1 - chain.entries.size();
+    kept.entries.add(entry);
+    kept.counts.add(counts);
+    rebuildSlices(kept);
+    chain = kept;
+    return true;
+}
+
+/* This function takes in a canonical king location and packed counts. For each piece type it walks the slices from
+ * the highest bit keeping two masks, entries whose count equals the query's so far and entries already below it, and
+ * an entry is contained in the query if every type's count is below or equal.
+ */
+Vector<int> SolvableAntichain::subsetsOf(GridLocation kingLoc, int counts) const {
+    Vector<int> found;
+    int index = canonicalKingIndex(kingLoc);
+    if (index < 0) {
+        return found;
+    }
+    const KingChain &chain = _chains[index];
+    size_t words = (chain.counts.size() + 63) / 64;
+    for (size_t word = 0; word < words; word++) {
+        uint64_t contained = ~uint64_t(0);
+        for (int type = 0; type < 5 && contained; type++) {
+            int count = (counts >> (type * kFieldBits)) & 31;
+            if (count >= (1 << kSliceBits)) {
+                continue;
+            }
+            uint64_t equal = ~uint64_t(0);
+            uint64_t below = 0;
+            for (int bit = kSliceBits - 1; bit >= 0; bit--) {
+                uint64_t slice = chain.slices[type][bit][word];
+                if (count & (1 << bit)) {
+                    below |= equal & ~slice;
+                    equal &= slice;
+                } else {
+                    equal &= ~slice;
+                }
+            }
+            contained &= below | equal;
+        }
+        if (word == words - 1 && chain.counts.size() % 64 != 0) {
+            contained &= (uint64_t(1) << (chain.counts.size() % 64)) - 1;
+        }
+        for (; contained; contained &= contained - 1) {
+            found.add(word * 64 + lowestSquare(contained));
+        }
+    }
+    return found;
+}
+
+/* This function takes in a problem and a map for the placement and tries each kept multiset the problem contains, the
+ * way matchPattern tries templates: the kept stalemate is mapped back from the canonical square and put on the board,
+ * the remaining pieces are placed, and the board is reset to the king alone if verifyStalemate rejects the result.
+ */
+bool SolvableAntichain::solve(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &result) const {
+    int symmetry = canonicalSymmetry(kingLoc);
+    GridLocation canonicalKing = transformLoc(kingLoc, symmetry);
+    const KingChain &chain = _chains[canonicalKingIndex(canonicalKing)];
+    int inverse = inverseSymmetry(symmetry);
+    for (int index : subsetsOf(canonicalKing, packAvailableCounts(pieces))) {
+        const DbEntry &entry = chain.entries[index];
+        result.clear();
+        for (int i = 0; i < entry.pieces.size(); i++) {
+            GridLocation loc = transformLoc(entry.locs[i], inverse);
+            result[entry.pieces[i]].add(loc);
+            _board[loc] = entry.pieces[i];
+        }
+        Vector<char> remaining = pieces;
+        Set<GridLocation> exclusion;
+        calculateExclusion(exclusion, kingLoc, result);
+        removeUsedPieces(remaining, result);
+        placeUselessPieces(remaining, exclusion, kingLoc, result);
+        if (verifyStalemate(kingLoc, pieces, result)) {
+            return true;
+        }
+        for (char piece : result) {
+            for (GridLocation loc : result[piece]) {
+                _board[loc] = 'E';
+            }
+        }
+    }
+    result.clear();
+    return false;
+}
+
+Vector<DbEntry> SolvableAntichain::entries(GridLocation kingLoc) const {
+    int index = canonicalKingIndex(kingLoc);
+    return index < 0 ? Vector<DbEntry>() : _chains[index].entries;
+}
+
+int SolvableAntichain::size() const {
+    return _size;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Bit-sliced subset queries match a direct check") {
+    setRandomSeed(91);
+    SolvableAntichain chain;
+    GridLocation kingLoc = GridLocation(0, 0);
+    Vector<char> pieces = {'K', 'Q', 'B'};
+    Map<char, Vector<GridLocation>> placement = {{'K', {GridLocation(2, 0)}}, {'Q', {GridLocation(2, 1)}},
+                                                 {'B', {GridLocation(3, 3)}}};
+    clearBoard();
+    _board[kingLoc] = 'K';
+    if (!verifyStalemate(kingLoc, pieces, placement)) {
+        placement = calculateStalemateSat(kingLoc, pieces);
+    }
+    EXPECT(chain.insert(kingLoc, placement));
+    EXPECT_EQUAL(chain.size(), 1);
+    Vector<DbEntry> kept = chain.entries(kingLoc);
+    int stored = packPieceCounts(kept[0].pieces);
+    EXPECT(kept[0].pieces.size() <= 3);
+    for (int trial = 0; trial < 200; trial++) {
+        Vector<char> query;
+        for (int i = 0; i < randomInteger(0, 8); i++) {
+            query.add(string("KQRBH")[randomInteger(0, 4)]);
+        }
+        int counts = packPieceCounts(query);
+        EXPECT_EQUAL(chain.subsetsOf(kingLoc, counts).size(), piecesAvailable(stored, counts) ? 1 : 0);
+    }
+    EXPECT(!chain.insert(kingLoc, placement));
+    EXPECT(chain.subsetsOf(GridLocation(4, 4), stored).isEmpty());
+    clearBoard();
+}
+
+PROVIDED_TEST("Antichain keeps only minimal multisets") {
+    SolvableAntichain chain;
+    for (const Problem &problem : generateCorpus(910, 150, 8)) {
+        EngineRun run = runEngine(findEngine("sat"), problem.kingLoc, problem.pieces);
+        if (run.verified) {
+            chain.insert(problem.kingLoc, run.result);
+        }
+    }
+    int total = 0;
+    for (int index = 0; index < kNumCanonicalKings; index++) {
+        Vector<DbEntry> entries = chain.entries(canonicalKingSquare(index));
+        total += entries.size();
+        for (int i = 0; i < entries.size(); i++) {
+            Map<char, Vector<GridLocation>> placement;
+            for (int j = 0; j < entries[i].pieces.size(); j++) {
+                placement[entries[i].pieces[j]].add(entries[i].locs[j]);
+            }
+            EXPECT(verifyStalemate(entries[i].kingLoc, entries[i].pieces, placement));
+            for (int j = 0; j < entries.size(); j++) {
+                if (i != j) {
+                    EXPECT(!piecesAvailable(packPieceCounts(entries[j].pieces), packPieceCounts(entries[i].pieces)));
+                }
+            }
+        }
+    }
+    EXPECT_EQUAL(total, chain.size());
+    cout << "Antichain of " << chain.size() << " minimal multisets" << endl;
+    clearBoard();
+}
+
+PROVIDED_TEST("Antichain answers supersets without searching") {
+    SolvableAntichain chain;
+    for (const Problem &problem : generateCorpus(911, 100, 6)) {
+        EngineRun run = runEngine(findEngine("sat"), problem.kingLoc, problem.pieces);
+        if (run.verified) {
+            chain.insert(problem.kingLoc, run.result);
+        }
+    }
+    Vector<Problem> problems = generateCorpus(912, 200, 10);
+    int answered = 0;
+    double chainMicros = 0;
+    double searchMicros = 0;
+    for (const Problem &problem : problems) {
+        clearBoard();
+        _board[problem.kingLoc] = 'K';
+        Map<char, Vector<GridLocation>> result;
+        auto start = chrono::steady_clock::now();
+        bool found = chain.solve(problem.kingLoc, problem.pieces, result);
+        chainMicros += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (found) {
+            answered++;
+            EXPECT(verifyStalemate(problem.kingLoc, problem.pieces, result));
+            searchMicros += runEngine(findEngine("sorted-greedy"), problem.kingLoc, problem.pieces).micros;
+        }
+    }
+    cout << "Antichain of " << chain.size() << " answered " << answered << "/" << problems.size() << " in "
+         << chainMicros / problems.size() << " us each; sorted-greedy took " << searchMicros / max(answered, 1)
+         << " us on those" << endl;
+    EXPECT(answered * 2 > problems.size());
+    clearBoard();
+}
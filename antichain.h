@@ -0,0 +1,77 @@
+/*
+ * This file contains the declarations for the solvable antichain: per canonical king square, the minimal piece
+ * multisets known to stalemate, indexed with bit-sliced counts so any problem holding one of them is answered at once
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+#include "soldb.h"
+#include "symmetry.h"
+
+/** Minimal solvable multisets with a stalemate for each. A multiset is only kept if no kept multiset is contained in
+ * it, so the multisets of a king square form an antichain under containment
+ */
+class SolvableAntichain {
+public:
+    /**
+     * Learn from a verified stalemate: pieces whose removal keeps the stalemate are dropped one at a time, and the
+     * multiset left is added unless a kept multiset is contained in it, removing the kept multisets that contain it
+     * @param opponent king location and map of pieces to their locations, raising an error if it is not a stalemate
+     * or the multiset left has a piece without a field in packPieceCounts
+     * @return whether the antichain changed
+     *
+     * This function runs in O(n^2) for n pieces plus O(m) for m kept multisets of the king square
+     */
+    bool insert(GridLocation kingLoc, Map<char, Vector<GridLocation>> placement);
+
+    /**
+     * Find the kept multisets of a canonical king square contained in a multiset, 64 at a time: the counts of each
+     * piece type are stored as four bit slices, one bit per multiset, and compared with the query's counts slice by
+     * slice from the highest bit
+     * @param canonical king location and packed piece counts from packPieceCounts
+     * @return indices of the contained multisets into entries(kingLoc)
+     *
+     * This function runs in O(m / 64) for m kept multisets, plus the number of matches
+     */
+    Vector<int> subsetsOf(GridLocation kingLoc, int counts) const;
+
+    /**
+     * Answer a problem from a kept multiset it contains: the kept stalemate is mapped onto the problem's king, the
+     * other pieces are placed with placeUselessPieces and the result is checked with verifyStalemate, trying the next
+     * contained multiset if an unused piece blocks a line
+     * @param opponent king location, pieces and map to fill with the placement, on a board holding only the king
+     * @return whether a verified placement was found
+     *
+     * This function runs in O(m / 64 + c n) for m kept multisets, c contained ones and n pieces
+     */
+    bool solve(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &result) const;
+
+    /**
+     * Kept multisets and their stalemates for a canonical king square
+     * @param canonical king location
+     * @return entries in canonical form
+     *
+     * This function runs in O(m) for m kept multisets
+     */
+    Vector<DbEntry> entries(GridLocation kingLoc) const;
+
+    int size() const;
+
+private:
+    /** One canonical king square's multisets
+     */
+    struct KingChain {
+        Vector<DbEntry> entries;
+        Vector<int> counts;                 // packed counts of each entry
+        std::vector<uint64_t> slices[5][4]; // bit b of each entry's count of piece type t
+    };
+
+    void rebuildSlices(KingChain &chain);
+
+    KingChain _chains[kNumCanonicalKings];
+    int _size = 0;
+};
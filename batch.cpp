@@ -0,0 +1,310 @@
+/*
+ * This file contains the implementation of solving batches of problems, scheduled shortest predicted job first with
+ * long solves preempted at node-budget checkpoints
+ */
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "batch.h"
+#include "hashmap.h"
+#include "placement.h"
+#include "priorityqueue.h"
+#include "queue.h"
+#include "searchstate.h"
+#include "strlib.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/** Scheduling state of one problem in a batch
+ */
+struct BatchJob {
+    Engine engine;
+    double predictedMicros;
+    long budget;
+    bool resumable;         // engine's search runs as a GreedySearch that is suspended instead of restarted
+    bool sortPieces;
+    std::string state;      // serialised GreedySearch of a preempted resumable job
+    double micros;          // time spent on the job so far
+};
+
+/* This function takes in a resumable job, its problem and a node budget. It resumes the job's search from its saved
+ * state, or starts it, and runs it for at most the budget. A search that runs out of budget is saved back into the job
+ * and reported as stopped; otherwise the solve is finished and verified.
+ */
+static EngineRun resumeJob(BatchJob &job, const Problem &problem, long budget) {
+    auto start = chrono::steady_clock::now();
+    resetSearch();
+    Vector<char> pieces = problem.pieces;
+    if (job.sortPieces) {
+        sort(pieces);
+    }
+    GreedySearch search = job.state.empty() ? GreedySearch(problem.kingLoc, pieces)
+                                            : GreedySearch::deserialize(job.state);
+    EngineRun run;
+    run.stopped = search.run(budget) == SearchStatus::Running;
+    if (run.stopped) {
+        job.state = search.serialize();
+    } else {
+        run.result = search.finish();
+        run.verified = verifyStalemate(problem.kingLoc, problem.pieces, run.result);
+    }
+    run.nodes = search.nodes();
+    job.micros += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    run.micros = job.micros;
+    return run;
+}
+
+/* This function takes in problems, a cost model and options and fills in a run and completion time per problem and the
+ * batch's preemption count. Every problem is routed to an engine and queued by its predicted time, or by submission
+ * order when shortestFirst is off. Each solve runs with a node budget of the quantum; a solve that spends it is
+ * preempted and queued behind every problem that has not run yet. Engines that GreedySearch reproduces are suspended
+ * and later resumed where they stopped, until their total nodes reach the node limit and they are abandoned. Other
+ * engines restart from scratch after preemption, so their budget is doubled each time, which keeps the repeated work
+ * below the work of the final run.
+ */
+static void scheduleBatch(const Vector<Problem> &problems, const CostModel &model, const BatchOptions &options,
+                          Vector<EngineRun> &runs, Vector<double> &completionMicros, int &preemptions) {
+    runs = Vector<EngineRun>(problems.size());
+    completionMicros = Vector<double>(problems.size(), 0);
+
+    long budget = options.quantum;
+    if (options.nodeLimit >= 0 && (budget < 0 || budget > options.nodeLimit)) {
+        budget = options.nodeLimit;
+    }
+    Vector<BatchJob> jobs;
+    PriorityQueue<int> waiting;
+    Queue<int> preempted;
+    for (int i = 0; i < problems.size(); i++) {
+        ProblemFeatures features = extractFeatures(problems[i].kingLoc, problems[i].pieces);
+        int engine = routeEngine(model, features);
+        double predicted = predictMicros(model, engine, features);
+        bool sortPieces;
+        bool resumable = isResumableEngine(model.engines[engine], sortPieces);
+        jobs.add({findEngine(model.engines[engine]), predicted, budget, resumable, sortPieces, "", 0});
+        waiting.enqueue(i, options.shortestFirst ? predicted : i);
+    }
+
+    mutex queueLock;
+    condition_variable queueChanged;
+    int remaining = problems.size();
+    auto start = chrono::steady_clock::now();
+
+    auto worker = [&](int index) {
+        if (options.pinWorkers) {
+            pinThreadToNode(index % numaNodeCount());
+        }
+        while (true) {
+            int job;
+            {
+                unique_lock<mutex> lock(queueLock);
+                queueChanged.wait(lock, [&]() {
+                    return remaining == 0 || !waiting.isEmpty() || !preempted.isEmpty();
+                });
+                if (remaining == 0) {
+                    return;
+                }
+                job = waiting.isEmpty() ? preempted.dequeue() : waiting.dequeue();
+            }
+
+            EngineRun run;
+            if (jobs[job].resumable) {
+                run = resumeJob(jobs[job], problems[job], jobs[job].budget);
+            } else {
+                run = runEngine(jobs[job].engine, problems[job].kingLoc, problems[job].pieces, 1, nullptr,
+                                jobs[job].budget);
+            }
+            double now = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+            lock_guard<mutex> lock(queueLock);
+            long spent = jobs[job].resumable ? run.nodes : jobs[job].budget;
+            bool abandon = run.stopped && options.nodeLimit >= 0 && spent >= options.nodeLimit;
+            if (run.stopped && !abandon) {
+                if (!jobs[job].resumable) {
+                    jobs[job].budget *= 2;
+                    if (options.nodeLimit >= 0) {
+                        jobs[job].budget = min(jobs[job].budget, options.nodeLimit);
+                    }
+                }
+                preemptions++;
+                preempted.enqueue(job);
+            } else {
+                runs[job] = run;
+                completionMicros[job] = now;
+                jobs[job].state.clear();
+                remaining--;
+            }
+            queueChanged.notify_all();
+        }
+    };
+
+    vector<thread> workers;
+    for (int t = 0; t < max(1, options.threads); t++) {
+        workers.emplace_back(worker, t);
+    }
+    for (thread &t : workers) {
+        t.join();
+    }
+}
+
+/* This function takes in problems, a cost model and options and solves the batch. With deduplication on, every problem
+ * is first put in canonical form, its king moved to the canonical square and its pieces sorted, and problems with the
+ * same canonical key are grouped with a hash map. Each unique problem is scheduled and solved once, and its result is
+ * mapped back through the inverse symmetry for every problem in its group and verified against that problem.
+ */
+BatchResult solveBatch(Vector<Problem> problems, const CostModel &model, BatchOptions options) {
+    BatchResult batch;
+    batch.runs = Vector<EngineRun>(problems.size());
+    batch.completionMicros = Vector<double>(problems.size(), 0);
+    batch.stats.problems = problems.size();
+
+    Vector<Problem> unique;
+    Vector<int> uniqueOf;
+    Vector<int> symmetries;
+    HashMap<string, int> uniqueIndex;
+    for (const Problem &problem : problems) {
+        int symmetry = 0;
+        string key = integerToString(unique.size());
+        if (options.deduplicate) {
+            symmetry = canonicalSymmetry(problem.kingLoc);
+            key = canonicalKey(problem.kingLoc, problem.pieces);
+        }
+        if (!uniqueIndex.containsKey(key)) {
+            uniqueIndex[key] = unique.size();
+            Problem canonical = problem;
+            if (options.deduplicate) {
+                canonical.kingLoc = transformLoc(problem.kingLoc, symmetry);
+                canonical.pieces = canonicalPieces(problem.pieces);
+            }
+            unique.add(canonical);
+        }
+        uniqueOf.add(uniqueIndex[key]);
+        symmetries.add(symmetry);
+    }
+
+    Vector<EngineRun> uniqueRuns;
+    Vector<double> uniqueCompletions;
+    scheduleBatch(unique, model, options, uniqueRuns, uniqueCompletions, batch.stats.preemptions);
+
+    for (int i = 0; i < problems.size(); i++) {
+        EngineRun run = uniqueRuns[uniqueOf[i]];
+        run.result = transformPlacement(run.result, inverseSymmetry(symmetries[i]));
+        run.verified = !run.threw && verifyStalemate(problems[i].kingLoc, problems[i].pieces, run.result);
+        batch.runs[i] = run;
+        batch.completionMicros[i] = uniqueCompletions[uniqueOf[i]];
+    }
+
+    batch.stats.uniqueProblems = unique.size();
+    batch.stats.dedupRatio = unique.isEmpty() ? 1 : double(problems.size()) / unique.size();
+    Vector<double> completions = batch.completionMicros;
+    completions.sort();
+    double total = 0;
+    for (int i = 0; i < problems.size(); i++) {
+        total += completions[i];
+        batch.stats.solved += batch.runs[i].verified;
+        batch.stats.abandoned += batch.runs[i].stopped;
+    }
+    if (!problems.isEmpty()) {
+        int n = problems.size();
+        batch.stats.meanCompletionMicros = total / n;
+        batch.stats.p50CompletionMicros = completions[(n - 1) / 2];
+        batch.stats.p99CompletionMicros = completions[(n - 1) * 99 / 100];
+        batch.stats.makespanMicros = completions[n - 1];
+    }
+    return batch;
+}
+
+/* This function takes in an output stream and batch statistics and prints them on one line.
+ */
+void printBatchStats(ostream &out, const BatchStats &stats) {
+    out << "Batch of " << stats.problems << " (" << stats.uniqueProblems << " unique, dedup ratio " << stats.dedupRatio
+        << "): solved " << stats.solved << ", preemptions " << stats.preemptions
+        << ", abandoned " << stats.abandoned
+        << ", completion mean " << stats.meanCompletionMicros / 1000 << " ms, p50 "
+        << stats.p50CompletionMicros / 1000 << " ms, p99 " << stats.p99CompletionMicros / 1000 << " ms, makespan "
+        << stats.makespanMicros / 1000 << " ms" << endl;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/* This function returns a cost model fit on a small harness corpus for the batch tests. It routes between the greedy
+ * engines only, whose searches are long enough to be preempted.
+ */
+static CostModel batchTestModel() {
+    HarnessReport report = runHarness(79, 20, 6, 1, {findEngine("greedy"), findEngine("sorted-greedy")});
+    Vector<string> names;
+    for (const Engine &engine : report.engines) {
+        names.add(engine.name);
+    }
+    return fitCostModel(names, costSamples(report));
+}
+
+PROVIDED_TEST("solveBatch gives every problem a verified result") {
+    CostModel model = batchTestModel();
+    Vector<Problem> problems = generateCorpus(790, 40, 6);
+    BatchOptions options;
+    options.quantum = 50;
+    options.nodeLimit = 20000;
+    options.threads = 2;
+    options.pinWorkers = true;
+    BatchResult batch = solveBatch(problems, model, options);
+    EXPECT_EQUAL(batch.runs.size(), problems.size());
+    for (int i = 0; i < problems.size(); i++) {
+        EXPECT_EQUAL(batch.runs[i].verified,
+                     verifyStalemate(problems[i].kingLoc, problems[i].pieces, batch.runs[i].result));
+        EXPECT(batch.completionMicros[i] > 0);
+    }
+    EXPECT(batch.stats.preemptions > 0);
+    printBatchStats(cout, batch.stats);
+    clearBoard();
+}
+
+PROVIDED_TEST("Shortest predicted job first against submission order") {
+    CostModel model = batchTestModel();
+    Vector<Problem> problems = generateCorpus(791, 60, 6);
+    BatchOptions fifo;
+    fifo.shortestFirst = false;
+    fifo.quantum = -1;
+    fifo.nodeLimit = 20000;
+    BatchOptions scheduling;
+    scheduling.quantum = 200;
+    scheduling.nodeLimit = 20000;
+    BatchResult inOrder = solveBatch(problems, model, fifo);
+    BatchResult scheduled = solveBatch(problems, model, scheduling);
+    EXPECT_EQUAL(inOrder.stats.preemptions, 0);
+    EXPECT_EQUAL(inOrder.stats.solved, scheduled.stats.solved);
+    printBatchStats(cout, inOrder.stats);
+    printBatchStats(cout, scheduled.stats);
+    clearBoard();
+}
+
+PROVIDED_TEST("solveBatch solves problems equal up to symmetry once") {
+    CostModel model = batchTestModel();
+    Vector<Problem> problems;
+    for (const Problem &problem : generateCorpus(792, 10, 5)) {
+        for (int symmetry = 0; symmetry < kNumSymmetries; symmetry += 3) {
+            Vector<char> pieces = problem.pieces;
+            pieces.reverse();
+            problems.add({transformLoc(problem.kingLoc, symmetry), symmetry % 2 ? pieces : problem.pieces});
+        }
+    }
+    BatchOptions options;
+    options.nodeLimit = 20000;
+    BatchResult batch = solveBatch(problems, model, options);
+    EXPECT(batch.stats.uniqueProblems <= 10);
+    EXPECT(batch.stats.dedupRatio >= 3);
+    for (int i = 0; i < problems.size(); i++) {
+        EXPECT_EQUAL(batch.runs[i].verified,
+                     verifyStalemate(problems[i].kingLoc, problems[i].pieces, batch.runs[i].result));
+    }
+
+    options.deduplicate = false;
+    BatchResult plain = solveBatch(problems, model, options);
+    EXPECT_EQUAL(plain.stats.uniqueProblems, problems.size());
+    printBatchStats(cout, plain.stats);
+    printBatchStats(cout, batch.stats);
+    clearBoard();
+}
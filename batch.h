@@ -0,0 +1,62 @@
+/*
+ * This file contains the declarations for solving batches of problems, scheduled shortest predicted job first with
+ * long solves preempted at node-budget checkpoints
+ */
+#pragma once
+
+#include <iostream>
+#include "map.h"
+#include "vector.h"
+#include "engines.h"
+#include "router.h"
+
+/** How a batch is scheduled
+ */
+struct BatchOptions {
+    bool shortestFirst = true;  // run problems in order of predicted cost instead of submission order
+    long quantum = 2000;        // search nodes a solve gets before it is preempted, -1 to never preempt
+    long nodeLimit = -1;        // give up on a problem once a solve of this many nodes is preempted, -1 for never
+    int threads = 1;            // worker threads
+    bool deduplicate = true;    // solve problems equal up to symmetry and piece order once
+    bool pinWorkers = false;    // pin worker threads round robin to NUMA nodes
+};
+
+/** Summary of a solved batch
+ */
+struct BatchStats {
+    int problems = 0;
+    int uniqueProblems = 0;             // problems left after deduplication
+    double dedupRatio = 1;              // problems per unique problem
+    int solved = 0;
+    int preemptions = 0;
+    int abandoned = 0;                  // problems given up on at the node limit
+    double meanCompletionMicros = 0;    // mean time from batch start until a problem finished
+    double p50CompletionMicros = 0;
+    double p99CompletionMicros = 0;
+    double makespanMicros = 0;
+};
+
+/** Results of a batch, in submission order
+ */
+struct BatchResult {
+    Vector<EngineRun> runs;             // final run of each problem
+    Vector<double> completionMicros;
+    BatchStats stats;
+};
+
+/**
+ * Solve a batch, each problem with the engine the cost model routes it to
+ * @param problems, cost model used for routing and ordering, and scheduling options
+ * @return results and statistics
+ *
+ * This function runs in the total time of the routed engines, plus the work repeated after preemptions
+ */
+BatchResult solveBatch(Vector<Problem> problems, const CostModel &model, BatchOptions options = BatchOptions());
+
+/**
+ * Print batch statistics
+ * @param output stream and statistics
+ *
+ * This function runs in O(1)
+ */
+void printBatchStats(std::ostream &out, const BatchStats &stats);
@@ -0,0 +1,596 @@
+/*
+ * This file contains the implementation of the square-pair line tables and the attack board, which keeps the squares
+ * attacked by the placed pieces up to date as pieces are placed and removed
+ */
+#include <chrono>
+#include <random>
+#include <vector>
+#include "bitboard.h"
+#include "engines.h"
+#include "pieces.h"
+#include "random.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/** Between and line bitboards for every pair of squares
+ */
+struct LineTables {
+    uint64_t between[64][64];
+    uint64_t line[64][64];
+};
+
+static const int kRookDirs[4][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
+static const int kBishopDirs[4][2] = {{1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+
+/* This function takes in a row and column and returns whether it is on the 8x8 board.
+ */
+static bool onBoard(int row, int col) {
+    return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+/* This function builds the tables by walking the eight directions from every square: each square reached gets the
+ * squares walked over so far as its between set, and the line is the two rays of the direction's axis joined.
+ */
+static LineTables buildLineTables() {
+    LineTables tables = {};
+    for (int from = 0; from < 64; from++) {
+        for (const int (*dirs)[2] : {kRookDirs, kBishopDirs}) {
+            for (int d = 0; d < 4; d++) {
+                uint64_t axis = uint64_t(1) << from;
+                for (int sign : {1, -1}) {
+                    int dr = dirs[d][0] * sign;
+                    int dc = dirs[d][1] * sign;
+                    for (int row = from / 8 + dr, col = from % 8 + dc; onBoard(row, col); row += dr, col += dc) {
+                        axis |= uint64_t(1) << (row * 8 + col);
+                    }
+                }
+                uint64_t walked = 0;
+                int dr = dirs[d][0];
+                int dc = dirs[d][1];
+                for (int row = from / 8 + dr, col = from % 8 + dc; onBoard(row, col); row += dr, col += dc) {
+                    int to = row * 8 + col;
+                    tables.between[from][to] = walked;
+                    tables.line[from][to] = axis;
+                    walked |= uint64_t(1) << to;
+                }
+            }
+        }
+    }
+    return tables;
+}
+
+static const LineTables kTables = buildLineTables();
+
+/* This function takes in a non-empty bitboard and returns the number of its lowest set square.
+ */
+int lowestSquare(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_ctzll(bits);
+#else
+    int square = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        square++;
+    }
+    return square;
+#endif
+}
+
+/* This function takes in a bitboard and returns how many squares it holds.
+ */
+int countSquares(uint64_t bits) {
+#if defined(__GNUC__) || defined(__clang__)
+    return __builtin_popcountll(bits);
+#else
+    int count = 0;
+    for (; bits; bits &= bits - 1) {
+        count++;
+    }
+    return count;
+#endif
+}
+
+uint64_t betweenMask(int from, int to) {
+    return kTables.between[from][to];
+}
+
+uint64_t lineMask(int from, int to) {
+    return kTables.line[from][to];
+}
+
+/* This function takes in a square, directions and the occupied squares and returns the squares along each direction
+ * up to and including the first occupied square, the attacks a magic table stores.
+ */
+static uint64_t rayAttacks(int square, const int (*dirs)[2], uint64_t occupied) {
+    uint64_t attacks = 0;
+    for (int d = 0; d < 4; d++) {
+        for (int row = square / 8 + dirs[d][0], col = square % 8 + dirs[d][1]; onBoard(row, col);
+             row += dirs[d][0], col += dirs[d][1]) {
+            uint64_t bit = uint64_t(1) << (row * 8 + col);
+            attacks |= bit;
+            if (occupied & bit) {
+                break;
+            }
+        }
+    }
+    return attacks;
+}
+
+/** Magic lookup for one square and kind of line: multiplying the occupied squares of mask by multiplier and keeping the
+ * top bits gives a slot, from offset on, holding the attacks for every occupancy with those squares
+ */
+struct Magic {
+    uint64_t mask;          // squares whose occupancy can stop a ray, the board's edge left out
+    uint64_t multiplier;
+    int shift;
+    int offset;
+};
+
+/** What attackMask needs for one piece character, generated from its descriptor
+ */
+struct PieceAttacks {
+    bool known = false;
+    bool leapsOntoPieces = false;
+    bool ridesStraight = false;
+    bool ridesDiagonal = false;
+    uint64_t leaps[64] = {};
+};
+
+/** Attack tables generated from the piece descriptors: every piece's jumps by character and square, and one magic table
+ * for ranks and files and one for diagonals
+ */
+struct AttackTables {
+    PieceAttacks pieces[128];
+    Magic straight[64];
+    Magic diagonal[64];
+    vector<uint64_t> slots;
+};
+
+/* This function takes in the directions of a kind of line, a seed and the magic array to fill, and appends each
+ * square's slots to slots. For every square the ray squares short of the edge form the mask, all their subsets are
+ * walked with the carry-rippler trick, and sparse random multipliers are tried until no two subsets with different
+ * attacks share a slot.
+ */
+static void findMagics(const int (*dirs)[2], uint64_t seed, Magic magics[64], vector<uint64_t> &slots) {
+    mt19937_64 random(seed);
+    vector<uint64_t> subsets;
+    vector<uint64_t> attacks;
+    vector<int> stamp;
+    for (int square = 0; square < 64; square++) {
+        uint64_t mask = 0;
+        for (int d = 0; d < 4; d++) {
+            for (int row = square / 8 + dirs[d][0], col = square % 8 + dirs[d][1];
+                 onBoard(row + dirs[d][0], col + dirs[d][1]); row += dirs[d][0], col += dirs[d][1]) {
+                mask |= uint64_t(1) << (row * 8 + col);
+            }
+        }
+        subsets.clear();
+        attacks.clear();
+        uint64_t subset = 0;
+        do {
+            subsets.push_back(subset);
+            attacks.push_back(rayAttacks(square, dirs, subset));
+            subset = (subset - mask) & mask;
+        } while (subset != 0);
+        int bits = countSquares(mask);
+        Magic &magic = magics[square];
+        magic.mask = mask;
+        magic.shift = 64 - bits;
+        magic.offset = slots.size();
+        slots.resize(slots.size() + (size_t(1) << bits));
+        stamp.assign(size_t(1) << bits, 0);
+        for (int attempt = 1; ; attempt++) {
+            magic.multiplier = random() & random() & random();
+            bool collided = false;
+            for (size_t i = 0; i < subsets.size() && !collided; i++) {
+                size_t slot = (subsets[i] * magic.multiplier) >> magic.shift;
+                uint64_t &entry = slots[magic.offset + slot];
+                if (stamp[slot] != attempt) {
+                    stamp[slot] = attempt;
+                    entry = attacks[i];
+                } else if (entry != attacks[i]) {
+                    collided = true;
+                }
+            }
+            if (!collided) {
+                break;
+            }
+        }
+    }
+}
+
+/* This function builds the tables from the descriptors: each jump is added from every square where it stays on the
+ * board, and the magics are searched with fixed seeds so every run builds the same tables.
+ */
+static AttackTables buildAttackTables() {
+    AttackTables tables;
+    for (const PieceDescriptor &descriptor : pieceDescriptors()) {
+        PieceAttacks &piece = tables.pieces[int(descriptor.symbol)];
+        piece.known = true;
+        piece.leapsOntoPieces = descriptor.leapsOntoPieces;
+        piece.ridesStraight = descriptor.ridesStraight;
+        piece.ridesDiagonal = descriptor.ridesDiagonal;
+        for (int square = 0; square < 64; square++) {
+            for (pair<int, int> leap : descriptor.leaps) {
+                if (onBoard(square / 8 + leap.first, square % 8 + leap.second)) {
+                    piece.leaps[square] |= uint64_t(1) << (square + leap.first * 8 + leap.second);
+                }
+            }
+        }
+    }
+    findMagics(kRookDirs, 1091, tables.straight, tables.slots);
+    findMagics(kBishopDirs, 1092, tables.diagonal, tables.slots);
+    return tables;
+}
+
+static const AttackTables kAttacks = buildAttackTables();
+
+/* This function takes in a square's magic and the occupied squares and returns the attacks along its lines up to and
+ * including the first occupied square.
+ */
+static inline uint64_t rideAttacks(const Magic &magic, uint64_t occupied) {
+    return kAttacks.slots[magic.offset + (((occupied & magic.mask) * magic.multiplier) >> magic.shift)];
+}
+
+/* This function takes in a piece, its square and the occupied squares and returns the squares it attacks, matching
+ * pieceAttackingLocs on a board with those squares occupied. Everything comes from the piece's generated tables, so
+ * no piece has code of its own: jumps are masked by occupancy unless they land on pieces, and the magic lookups'
+ * blockers are taken off since a line stops before an occupied square.
+ */
+uint64_t attackMask(char piece, int square, uint64_t occupied) {
+    unsigned char index = piece;
+    if (index >= 128 || !kAttacks.pieces[index].known) {
+        error("Invalid character representation of a piece");
+    }
+    const PieceAttacks &attacks = kAttacks.pieces[index];
+    uint64_t leaps = attacks.leaps[square];
+    uint64_t rides = 0;
+    if (attacks.ridesStraight) {
+        rides |= rideAttacks(kAttacks.straight[square], occupied);
+    }
+    if (attacks.ridesDiagonal) {
+        rides |= rideAttacks(kAttacks.diagonal[square], occupied);
+    }
+    return (attacks.leapsOntoPieces ? leaps : leaps & ~occupied) | (rides & ~occupied);
+}
+
+/* This function takes in a square and the new attacks of its piece and updates the attack counts by the difference
+ * from the old attacks, setting or clearing a square in the attacked set when its count leaves or reaches zero.
+ */
+void AttackBoard::setAttacks(int square, uint64_t attacks) {
+    uint64_t gained = attacks & ~_attacks[square];
+    uint64_t lost = _attacks[square] & ~attacks;
+    _attacks[square] = attacks;
+    for (; gained; gained &= gained - 1) {
+        int target = lowestSquare(gained);
+        if (_counts[target]++ == 0) {
+            _attacked |= uint64_t(1) << target;
+        }
+    }
+    for (; lost; lost &= lost - 1) {
+        int target = lowestSquare(lost);
+        if (--_counts[target] == 0) {
+            _attacked &= ~(uint64_t(1) << target);
+        }
+    }
+}
+
+/* This function takes in a square whose occupancy just changed and recomputes the pieces that can see it: riders on a
+ * line through it whose piece rides that line and with nothing between, and pieces whose blocked jumps land on it,
+ * such as a king next to it. Knights and every other rider keep their attacks.
+ */
+void AttackBoard::refreshAround(int square) {
+    uint64_t bit = uint64_t(1) << square;
+    for (uint64_t sliders = _sliders; sliders; sliders &= sliders - 1) {
+        int from = lowestSquare(sliders);
+        if (!kTables.line[from][square] || (kTables.between[from][square] & _occupied)) {
+            continue;
+        }
+        char piece = _pieces[from];
+        if (attackMask(piece, from, 0) & bit) {
+            setAttacks(from, attackMask(piece, from, _occupied));
+        }
+    }
+    for (uint64_t steppers = _steppers; steppers; steppers &= steppers - 1) {
+        int from = lowestSquare(steppers);
+        char piece = _pieces[from];
+        if (attackMask(piece, from, 0) & bit) {
+            setAttacks(from, attackMask(piece, from, _occupied));
+        }
+    }
+}
+
+/* This function takes in a piece and the bit of its square and files the square under the pieces refreshAround has to
+ * revisit: riders, and pieces whose jumps stop at occupied squares.
+ */
+void AttackBoard::track(char piece, uint64_t bit) {
+    const PieceDescriptor *descriptor = findPiece(piece);
+    if (descriptor == nullptr) {
+        return;
+    }
+    if (descriptor->ridesStraight || descriptor->ridesDiagonal) {
+        _sliders |= bit;
+    }
+    if (!descriptor->leaps.isEmpty() && !descriptor->leapsOntoPieces) {
+        _steppers |= bit;
+    }
+}
+
+/* This function takes in the opponent king location and a placement and rebuilds the board from scratch.
+ */
+void AttackBoard::reset(GridLocation kingLoc, const Map<char, Vector<GridLocation>> &placement) {
+    _occupied = 0;
+    _attacked = 0;
+    _sliders = 0;
+    _steppers = 0;
+    for (int square = 0; square < 64; square++) {
+        _pieces[square] = 'E';
+        _attacks[square] = 0;
+        _counts[square] = 0;
+        if (_board[square / 8][square % 8] != 'E') {
+            _occupied |= uint64_t(1) << square;
+        }
+    }
+    int kingSquare = kingLoc.row * 8 + kingLoc.col;
+    _kingBit = uint64_t(1) << kingSquare;
+    _neighbourhood = attackMask('K', kingSquare, 0) | _kingBit;
+    for (char piece : placement) {
+        for (GridLocation loc : placement[piece]) {
+            int square = loc.row * 8 + loc.col;
+            _pieces[square] = piece;
+            track(piece, uint64_t(1) << square);
+            setAttacks(square, attackMask(piece, square, _occupied));
+        }
+    }
+}
+
+/* This function takes in a piece and a location, marks the square occupied, cuts the lines through it and adds the
+ * piece's own attacks.
+ */
+void AttackBoard::place(char piece, GridLocation loc) {
+    int square = loc.row * 8 + loc.col;
+    uint64_t bit = uint64_t(1) << square;
+    _occupied |= bit;
+    refreshAround(square);
+    _pieces[square] = piece;
+    track(piece, bit);
+    setAttacks(square, attackMask(piece, square, _occupied));
+}
+
+/* This function takes in a location, drops its piece's attacks, marks the square empty and extends the lines that
+ * stopped at it.
+ */
+void AttackBoard::remove(GridLocation loc) {
+    int square = loc.row * 8 + loc.col;
+    uint64_t bit = uint64_t(1) << square;
+    setAttacks(square, 0);
+    _pieces[square] = 'E';
+    _sliders &= ~bit;
+    _steppers &= ~bit;
+    _occupied &= ~bit;
+    refreshAround(square);
+}
+
+bool AttackBoard::isStalemate() const {
+    return (_attacked & _neighbourhood) == (_neighbourhood & ~_kingBit);
+}
+
+uint64_t AttackBoard::attacked() const {
+    return _attacked;
+}
+
+uint64_t AttackBoard::occupied() const {
+    return _occupied;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Between and line tables") {
+    EXPECT_EQUAL(betweenMask(0, 63), 0x0040201008040200ULL);
+    EXPECT_EQUAL(lineMask(0, 63), 0x8040201008040201ULL);
+    EXPECT_EQUAL(betweenMask(0, 7), 0x7eULL);
+    EXPECT_EQUAL(lineMask(3, 59), 0x0808080808080808ULL);
+    EXPECT_EQUAL(betweenMask(0, 1), 0ULL);
+    EXPECT_EQUAL(lineMask(0, 17), 0ULL);
+    EXPECT_EQUAL(betweenMask(0, 17), 0ULL);
+    for (int from = 0; from < 64; from++) {
+        for (int to = 0; to < 64; to++) {
+            EXPECT_EQUAL(betweenMask(from, to), betweenMask(to, from));
+            EXPECT_EQUAL(lineMask(from, to), lineMask(to, from));
+        }
+    }
+}
+
+PROVIDED_TEST("AttackBoard matches pieceAttackingLocs through random moves") {
+    setRandomSeed(88);
+    string types = "KQRBH";
+    for (int trial = 0; trial < 50; trial++) {
+        clearBoard();
+        GridLocation kingLoc = GridLocation(randomInteger(0, 7), randomInteger(0, 7));
+        _board[kingLoc] = 'K';
+        Map<char, Vector<GridLocation>> placement;
+        AttackBoard board;
+        board.reset(kingLoc, placement);
+        Vector<GridLocation> placed;
+        for (int step = 0; step < 40; step++) {
+            if (!placed.isEmpty() && (placed.size() >= 14 || randomChance(0.3))) {
+                GridLocation loc = placed.remove(randomInteger(0, placed.size() - 1));
+                char piece = _board[loc];
+                placement[piece].remove(placement[piece].indexOf(loc));
+                _board[loc] = 'E';
+                board.remove(loc);
+            } else {
+                GridLocation loc = GridLocation(randomInteger(0, 7), randomInteger(0, 7));
+                if (_board[loc] != 'E') {
+                    continue;
+                }
+                char piece = types[randomInteger(0, types.size() - 1)];
+                placement[piece].add(loc);
+                placed.add(loc);
+                _board[loc] = piece;
+                board.place(piece, loc);
+            }
+            uint64_t expected = 0;
+            for (char piece : placement) {
+                for (GridLocation loc : placement[piece]) {
+                    for (GridLocation target : pieceAttackingLocs(piece, loc)) {
+                        expected |= uint64_t(1) << (target.row * 8 + target.col);
+                    }
+                }
+            }
+            EXPECT_EQUAL(board.attacked(), expected);
+            EXPECT_EQUAL(board.isStalemate(), isStalemate(kingLoc, placement));
+        }
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Incremental updates against isStalemate on crowded boards") {
+    setRandomSeed(880);
+    clearBoard();
+    GridLocation kingLoc = GridLocation(3, 3);
+    _board[kingLoc] = 'K';
+    Map<char, Vector<GridLocation>> placement;
+    string types = "QQRRBBHHKQRB";
+    for (char piece : types) {
+        GridLocation loc;
+        do {
+            loc = GridLocation(randomInteger(0, 7), randomInteger(0, 7));
+        } while (_board[loc] != 'E');
+        placement[piece].add(loc);
+        _board[loc] = piece;
+    }
+    AttackBoard board;
+    board.reset(kingLoc, placement);
+    Vector<GridLocation> empty;
+    for (int square = 0; square < 64; square++) {
+        if (_board[square / 8][square % 8] == 'E') {
+            empty.add(GridLocation(square / 8, square % 8));
+        }
+    }
+
+    const int kMoves = 20000;
+    auto start = chrono::steady_clock::now();
+    int stalemates = 0;
+    for (int i = 0; i < kMoves; i++) {
+        GridLocation loc = empty[i % empty.size()];
+        board.place('R', loc);
+        stalemates += board.isStalemate();
+        board.remove(loc);
+    }
+    double incremental = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+    start = chrono::steady_clock::now();
+    int expected = 0;
+    for (int i = 0; i < kMoves; i++) {
+        GridLocation loc = empty[i % empty.size()];
+        _board[loc] = 'R';
+        placement['R'].add(loc);
+        expected += isStalemate(kingLoc, placement);
+        placement['R'].removeBack();
+        _board[loc] = 'E';
+    }
+    double full = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    cout << types.size() << " pieces: incremental " << incremental * 1000 / kMoves << " ns per move, full recompute "
+         << full * 1000 / kMoves << " ns per move (" << full / incremental << "x)" << endl;
+    EXPECT_EQUAL(stalemates, expected);
+    clearBoard();
+}
+
+PROVIDED_TEST("Generated attack tables against walking the descriptors") {
+    mt19937_64 random(97);
+    for (const PieceDescriptor &piece : pieceDescriptors()) {
+        for (int trial = 0; trial < 2000; trial++) {
+            int square = random() % 64;
+            uint64_t occupied = (random() & random()) & ~(uint64_t(1) << square);
+            uint64_t expected = 0;
+            for (pair<int, int> leap : piece.leaps) {
+                int row = square / 8 + leap.first;
+                int col = square % 8 + leap.second;
+                uint64_t bit = onBoard(row, col) ? uint64_t(1) << (row * 8 + col) : 0;
+                if (!(occupied & bit) || piece.leapsOntoPieces) {
+                    expected |= bit;
+                }
+            }
+            if (piece.ridesStraight) {
+                expected |= rayAttacks(square, kRookDirs, occupied) & ~occupied;
+            }
+            if (piece.ridesDiagonal) {
+                expected |= rayAttacks(square, kBishopDirs, occupied) & ~occupied;
+            }
+            EXPECT_EQUAL(attackMask(piece.symbol, square, occupied), expected);
+        }
+    }
+    EXPECT_ERROR(attackMask('E', 0, 0));
+    EXPECT_EQUAL(countSquares(attackMask('A', 0, 0)), 21 + 2);
+    EXPECT_EQUAL(countSquares(attackMask('M', 27, 0)), 8);
+}
+
+PROVIDED_TEST("AttackBoard with fairy pieces through random moves") {
+    setRandomSeed(97);
+    string types = "KQRBHACM";
+    for (int trial = 0; trial < 30; trial++) {
+        clearBoard();
+        GridLocation kingLoc = GridLocation(randomInteger(0, 7), randomInteger(0, 7));
+        _board[kingLoc] = 'K';
+        Map<char, Vector<GridLocation>> placement;
+        AttackBoard board;
+        board.reset(kingLoc, placement);
+        Vector<GridLocation> placed;
+        for (int step = 0; step < 40; step++) {
+            if (!placed.isEmpty() && (placed.size() >= 14 || randomChance(0.3))) {
+                GridLocation loc = placed.remove(randomInteger(0, placed.size() - 1));
+                char piece = _board[loc];
+                placement[piece].remove(placement[piece].indexOf(loc));
+                _board[loc] = 'E';
+                board.remove(loc);
+            } else {
+                GridLocation loc = GridLocation(randomInteger(0, 7), randomInteger(0, 7));
+                if (_board[loc] != 'E') {
+                    continue;
+                }
+                char piece = types[randomInteger(0, types.size() - 1)];
+                placement[piece].add(loc);
+                placed.add(loc);
+                _board[loc] = piece;
+                board.place(piece, loc);
+            }
+            uint64_t expected = 0;
+            for (char piece : placement) {
+                for (GridLocation loc : placement[piece]) {
+                    for (GridLocation target : pieceAttackingLocs(piece, loc)) {
+                        expected |= uint64_t(1) << (target.row * 8 + target.col);
+                    }
+                }
+            }
+            EXPECT_EQUAL(board.attacked(), expected);
+        }
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Magic lookups against walking the rays") {
+    mt19937_64 random(970);
+    const int kLookups = 1 << 20;
+    Vector<uint64_t> occupancies;
+    for (int i = 0; i < 1024; i++) {
+        occupancies.add(random() & random());
+    }
+    uint64_t walked = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < kLookups; i++) {
+        uint64_t occupied = occupancies[i & 1023];
+        walked ^= (rayAttacks(i & 63, kRookDirs, occupied) | rayAttacks(i & 63, kBishopDirs, occupied)) & ~occupied;
+    }
+    double walking = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    uint64_t looked = 0;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < kLookups; i++) {
+        looked ^= attackMask('Q', i & 63, occupancies[i & 1023]);
+    }
+    double magic = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    cout << "Queen attacks: ray walking " << walking * 1000 / kLookups << " ns, magic lookup "
+         << magic * 1000 / kLookups << " ns (" << walking / magic << "x)" << endl;
+    EXPECT_EQUAL(looked, walked);
+}
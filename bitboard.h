@@ -0,0 +1,115 @@
+/*
+ * This file contains the declarations for the square-pair line tables and the attack board, which keeps the squares
+ * attacked by the placed pieces up to date as pieces are placed and removed
+ */
+#pragma once
+
+#include <cstdint>
+#include "grid.h"
+#include "map.h"
+#include "vector.h"
+
+/**
+ * Lowest square of a bitboard
+ * @param non-empty bitboard
+ * @return square number, row * 8 + col
+ *
+ * This function runs in O(1) where the compiler has a builtin, in O(64) otherwise
+ */
+int lowestSquare(uint64_t bits);
+
+/**
+ * Number of squares in a bitboard
+ * @param bitboard
+ * @return population count
+ *
+ * This function runs in O(1) where the compiler has a builtin, in O(64) otherwise
+ */
+int countSquares(uint64_t bits);
+
+/**
+ * Squares strictly between two squares on a shared rank, file or diagonal
+ * @param two squares numbered row * 8 + col
+ * @return bitboard of the squares between them, empty if they share no line or are adjacent
+ *
+ * This function runs in O(1) from a table built once
+ */
+uint64_t betweenMask(int from, int to);
+
+/**
+ * The whole rank, file or diagonal through two squares
+ * @param two squares numbered row * 8 + col
+ * @return bitboard of the line including both squares, empty if they share no line
+ *
+ * This function runs in O(1) from a table built once
+ */
+uint64_t lineMask(int from, int to);
+
+/**
+ * Squares a piece attacks with the given squares occupied, by the rules of pieceAttackingLocs: lines stop before an
+ * occupied square and a king does not attack occupied squares, while a knight attacks all its squares. Any piece with
+ * a descriptor in pieces.h is supported, looked up in tables generated from the descriptors
+ * @param piece, its square and the occupied squares
+ * @return bitboard of attacked squares
+ *
+ * This function runs in O(1), with magic lookups for the lines
+ */
+uint64_t attackMask(char piece, int square, uint64_t occupied);
+
+/** The pieces of a placement with the squares each attacks and how many pieces attack each square. When a square
+ * changes, only the riders whose lines reach it without anything in between and the pieces whose blocked jumps land on
+ * it, such as a king next to it, are recomputed
+ */
+class AttackBoard {
+public:
+    /**
+     * Start from a placement: every non-empty square of the current thread's board is occupied and the placement's
+     * pieces attack
+     * @param opponent king location and map of pieces to their locations
+     *
+     * This function runs in O(64 + n) for n pieces
+     */
+    void reset(GridLocation kingLoc, const Map<char, Vector<GridLocation>> &placement);
+
+    /**
+     * Put a piece on an empty square
+     * @param piece and location
+     *
+     * This function runs in O(s) for s sliders and kings on the board
+     */
+    void place(char piece, GridLocation loc);
+
+    /**
+     * Take the piece off a square placed with place or reset
+     * @param location
+     *
+     * This function runs in O(s) for s sliders and kings on the board
+     */
+    void remove(GridLocation loc);
+
+    /**
+     * Whether the placement stalemates the opponent king, with the same answer as isStalemate
+     * @return true if every square around the king is attacked and the king's own square is not
+     *
+     * This function runs in O(1)
+     */
+    bool isStalemate() const;
+
+    uint64_t attacked() const;
+    uint64_t occupied() const;
+
+private:
+    void setAttacks(int square, uint64_t attacks);
+    void refreshAround(int square);
+    void track(char piece, uint64_t bit);
+
+    char _pieces[64];           // attacking piece on each square, 'E' for none
+    uint64_t _attacks[64];      // squares attacked by the piece on each square
+    uint8_t _counts[64];        // number of pieces attacking each square
+    uint64_t _occupied = 0;
+    uint64_t _attacked = 0;     // squares with a non-zero count
+    uint64_t _sliders = 0;      // squares holding a piece that rides a line, such as a queen, rook or bishop
+    uint64_t _steppers = 0;     // squares holding a piece whose jumps skip occupied squares, such as a white king
+    uint64_t _kingBit = 0;
+    uint64_t _neighbourhood = 0;
+};
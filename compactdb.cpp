@@ -0,0 +1,498 @@
+/*
+ * This file contains the implementation of the compact solution database: solutions grouped by piece multiset, stored
+ * as bit-packed squares relative to the king and found through an Elias-Fano index of the groups' offsets
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include "compactdb.h"
+#include "bitboard.h"
+#include "error.h"
+#include "patterns.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const char kCompactMagic[4] = {'M', 'S', 'D', 'C'};
+static const int kCompactVersion = 1;
+static const int kHeaderBytes = 32;
+static const int kCodeBits = 6;
+static const int kSelectSample = 64;
+
+/* This function takes in packed piece counts and returns the number of pieces.
+ */
+static int pieceTotal(int counts) {
+    int total = 0;
+    for (; counts; counts >>= 5) {
+        total += counts & 31;
+    }
+    return total;
+}
+
+/* This function takes in words, a bit position and a width of at most 57 bits and returns the bits stored there.
+ */
+static uint64_t readBits(const vector<uint64_t> &words, size_t pos, int width) {
+    if (width == 0) {
+        return 0;
+    }
+    size_t word = pos / 64;
+    int shift = pos % 64;
+    uint64_t value = words[word] >> shift;
+    if (shift + width > 64) {
+        value |= words[word + 1] << (64 - shift);
+    }
+    return value & ((uint64_t(1) << width) - 1);
+}
+
+/* This function takes in words, a bit position, a width and a value and stores the value there, growing the words as
+ * needed. The bits written to must still be zero.
+ */
+static void writeBits(vector<uint64_t> &words, size_t pos, int width, uint64_t value) {
+    if (width == 0) {
+        return;
+    }
+    size_t last = (pos + width - 1) / 64;
+    if (words.size() <= last) {
+        words.resize(last + 1, 0);
+    }
+    words[pos / 64] |= value << (pos % 64);
+    if (pos % 64 + width > 64) {
+        words[pos / 64 + 1] |= value >> (64 - pos % 64);
+    }
+}
+
+/* This function takes in a buffer, a value and a number of bytes and appends the value little-endian.
+ */
+static void appendBytes(string &buffer, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buffer += char((value >> (8 * i)) & 0xFF);
+    }
+}
+
+/* This function takes in a buffer, a position and a number of bytes, returns the little-endian value stored there and
+ * advances the position, raising an error if the buffer ends first.
+ */
+static uint64_t takeBytes(const string &buffer, size_t &pos, int bytes) {
+    if (pos + bytes > buffer.size()) {
+        error("Compact database is truncated");
+    }
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= uint64_t((unsigned char) buffer[pos + i]) << (8 * i);
+    }
+    pos += bytes;
+    return value;
+}
+
+/* This function takes in a buffer and words and appends the number of words followed by the words.
+ */
+static void appendWords(string &buffer, const vector<uint64_t> &words) {
+    appendBytes(buffer, words.size(), 8);
+    for (uint64_t word : words) {
+        appendBytes(buffer, word, 8);
+    }
+}
+
+/* This function takes in a buffer and a position and reads words written by appendWords.
+ */
+static vector<uint64_t> takeWords(const string &buffer, size_t &pos) {
+    uint64_t count = takeBytes(buffer, pos, 8);
+    if (count > (buffer.size() - pos) / 8) {
+        error("Compact database is truncated");
+    }
+    vector<uint64_t> words(count);
+    for (uint64_t &word : words) {
+        word = takeBytes(buffer, pos, 8);
+    }
+    return words;
+}
+
+/* This function takes in bytes and returns their 64-bit FNV-1a hash, used as the file checksum.
+ */
+static uint64_t checksum(const char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ (unsigned char) data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* This function takes in non-decreasing values and encodes them. With u one more than the last value and n values,
+ * each value keeps its low floor(log2(u / n)) bits in the low array, and value i's remaining high part h sets bit
+ * h + i of the high array, so the high array has about 2n bits whatever the universe.
+ */
+EliasFano::EliasFano(const vector<uint64_t> &values) {
+    _count = values.size();
+    if (_count == 0) {
+        return;
+    }
+    uint64_t universe = values.back() + 1;
+    while (_lowBits < 56 && (universe >> (_lowBits + 1)) >= uint64_t(_count)) {
+        _lowBits++;
+    }
+    for (int i = 0; i < _count; i++) {
+        writeBits(_low, size_t(i) * _lowBits, _lowBits, values[i] & ((uint64_t(1) << _lowBits) - 1));
+        size_t position = (values[i] >> _lowBits) + i;
+        writeBits(_high, position, 1, 1);
+        if (i % kSelectSample == 0) {
+            _samples.push_back(position);
+        }
+    }
+}
+
+/* This function takes in an index and returns the value there: the sample before the index gives the position of a
+ * nearby one in the high array, whole words are skipped by population count until the word holding the index's one,
+ * and the one's position minus the index is the high part.
+ */
+uint64_t EliasFano::at(int index) const {
+    int sample = index / kSelectSample;
+    size_t position = _samples[sample];
+    int remaining = index - sample * kSelectSample;
+    size_t word = position / 64;
+    uint64_t bits = _high[word] & (~uint64_t(0) << (position % 64));
+    for (int ones = countSquares(bits); remaining >= ones; ones = countSquares(bits)) {
+        remaining -= ones;
+        bits = _high[++word];
+    }
+    for (; remaining > 0; remaining--) {
+        bits &= bits - 1;
+    }
+    uint64_t high = word * 64 + lowestSquare(bits) - index;
+    return (high << _lowBits) | readBits(_low, size_t(index) * _lowBits, _lowBits);
+}
+
+int EliasFano::size() const {
+    return _count;
+}
+
+size_t EliasFano::bits() const {
+    return 64 * (_low.size() + _high.size() + _samples.size());
+}
+
+void EliasFano::write(string &buffer) const {
+    appendBytes(buffer, _count, 4);
+    appendBytes(buffer, _lowBits, 4);
+    appendWords(buffer, _low);
+    appendWords(buffer, _high);
+    appendWords(buffer, _samples);
+}
+
+/* This function takes in a buffer and a position and reads an encoding written by write, checking that the arrays are
+ * long enough for the count so that at never reads past them.
+ */
+EliasFano EliasFano::read(const string &buffer, size_t &pos) {
+    EliasFano sequence;
+    sequence._count = takeBytes(buffer, pos, 4);
+    sequence._lowBits = takeBytes(buffer, pos, 4);
+    sequence._low = takeWords(buffer, pos);
+    sequence._high = takeWords(buffer, pos);
+    sequence._samples = takeWords(buffer, pos);
+    int ones = 0;
+    for (uint64_t word : sequence._high) {
+        ones += countSquares(word);
+    }
+    if (sequence._count < 0 || sequence._lowBits > 56 || ones != sequence._count
+            || sequence._low.size() * 64 < size_t(sequence._count) * sequence._lowBits
+            || sequence._samples.size() != size_t((sequence._count + kSelectSample - 1) / kSelectSample)) {
+        error("Invalid Elias-Fano sequence");
+    }
+    for (uint64_t sample : sequence._samples) {
+        if (sample >= sequence._high.size() * 64) {
+            error("Invalid Elias-Fano sequence");
+        }
+    }
+    return sequence;
+}
+
+/* This function takes in a filename and entries and writes the compact database. Entries are grouped in a map by
+ * packed piece counts and then by canonical king index, so both come out sorted and a repeated problem keeps its first
+ * entry. Each group's codes are written king by king in index order.
+ */
+void writeCompactDatabase(string filename, Vector<DbEntry> entries) {
+    Map<int, Map<int, int>> groups;
+    for (int i = 0; i < entries.size(); i++) {
+        const DbEntry &entry = entries[i];
+        int index = canonicalKingIndex(entry.kingLoc);
+        if (entry.pieces.size() > kMaxDbPieces || entry.locs.size() != entry.pieces.size() || index < 0
+                || !hasPackedCounts(entry.pieces)) {
+            error("Database entry does not fit in a compact record");
+        }
+        int counts = packPieceCounts(entry.pieces);
+        if (!groups[counts].containsKey(index)) {
+            groups[counts][index] = i;
+        }
+    }
+
+    string body;
+    vector<uint64_t> offsets;
+    vector<uint64_t> codes;
+    size_t position = 0;
+    int count = 0;
+    for (int counts : groups) {
+        appendBytes(body, counts, 4);
+    }
+    for (int counts : groups) {
+        int kings = 0;
+        offsets.push_back(position);
+        for (int index : groups[counts]) {
+            kings |= 1 << index;
+            const DbEntry &entry = entries[groups[counts][index]];
+            int kingSquare = entry.kingLoc.row * 8 + entry.kingLoc.col;
+            for (GridLocation loc : entry.locs) {
+                writeBits(codes, position, kCodeBits, (loc.row * 8 + loc.col - kingSquare) & 63);
+                position += kCodeBits;
+            }
+            count++;
+        }
+        appendBytes(body, kings, 2);
+    }
+    EliasFano(offsets).write(body);
+    appendWords(body, codes);
+
+    string header(kCompactMagic, 4);
+    appendBytes(header, kCompactVersion, 4);
+    appendBytes(header, groups.size(), 4);
+    appendBytes(header, count, 4);
+    appendBytes(header, checksum(body.data(), body.size()), 8);
+    appendBytes(header, 0, kHeaderBytes - header.size());
+
+    ofstream out(filename, ios::binary);
+    out << header << body;
+    if (!out) {
+        error("Cannot write compact database " + filename);
+    }
+}
+
+/* This function takes in a filename and reads the whole file, then checks everything decode relies on: the header and
+ * checksum, groups sorted by counts with at least one king each, and every group's offset following from the one
+ * before, with the codes long enough for the last group.
+ */
+void CompactDatabase::load(string filename) {
+    ifstream in(filename, ios::binary);
+    if (!in) {
+        error("Cannot open compact database " + filename);
+    }
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    if (contents.size() < size_t(kHeaderBytes) || memcmp(contents.data(), kCompactMagic, 4) != 0) {
+        error("Not a compact database: " + filename);
+    }
+    size_t pos = 4;
+    if (takeBytes(contents, pos, 4) != uint64_t(kCompactVersion)) {
+        error("Unsupported compact database version: " + filename);
+    }
+    uint64_t groups = takeBytes(contents, pos, 4);
+    uint64_t entries = takeBytes(contents, pos, 4);
+    uint64_t sum = takeBytes(contents, pos, 8);
+    pos = kHeaderBytes;
+    if (sum != checksum(contents.data() + pos, contents.size() - pos)) {
+        error("Compact database checksum mismatch: " + filename);
+    }
+    if (groups > (contents.size() - pos) / 6) {
+        error("Compact database is truncated");
+    }
+    vector<uint32_t> counts(groups);
+    vector<uint16_t> kings(groups);
+    for (uint32_t &value : counts) {
+        value = takeBytes(contents, pos, 4);
+    }
+    for (uint16_t &value : kings) {
+        value = takeBytes(contents, pos, 2);
+    }
+    EliasFano offsets = EliasFano::read(contents, pos);
+    vector<uint64_t> codes = takeWords(contents, pos);
+
+    uint64_t expected = 0;
+    uint64_t total = 0;
+    for (size_t g = 0; g < groups; g++) {
+        int pieces = pieceTotal(counts[g]);
+        if ((g > 0 && counts[g] <= counts[g - 1]) || kings[g] == 0 || kings[g] >> kNumCanonicalKings
+                || pieces > kMaxDbPieces || offsets.size() != int(groups) || offsets.at(g) != expected) {
+            error("Invalid compact database: " + filename);
+        }
+        expected += uint64_t(countSquares(kings[g])) * pieces * kCodeBits;
+        total += countSquares(kings[g]);
+    }
+    if (total != entries || expected > codes.size() * 64) {
+        error("Invalid compact database: " + filename);
+    }
+    _counts = counts;
+    _kings = kings;
+    _offsets = offsets;
+    _codes = codes;
+    _entries = entries;
+    _bytes = contents.size();
+}
+
+/* This function takes in packed counts, a canonical king square and an array for the squares. It binary searches the
+ * groups for the counts, ranks the king among the group's kings with a population count, reads the group's offset from
+ * the index, and turns each code back into a square by adding the king's square.
+ */
+int CompactDatabase::decode(int counts, int kingSquare, int *squares) const {
+    auto it = lower_bound(_counts.begin(), _counts.end(), uint32_t(counts));
+    int index = canonicalKingIndex(GridLocation(kingSquare / 8, kingSquare % 8));
+    if (it == _counts.end() || *it != uint32_t(counts) || index < 0) {
+        return -1;
+    }
+    int group = it - _counts.begin();
+    int kings = _kings[group];
+    if (!(kings & (1 << index))) {
+        return -1;
+    }
+    int pieces = pieceTotal(counts);
+    size_t position = _offsets.at(group) + size_t(countSquares(kings & ((1 << index) - 1))) * pieces * kCodeBits;
+    for (int i = 0; i < pieces; i++) {
+        squares[i] = (readBits(_codes, position + i * kCodeBits, kCodeBits) + kingSquare) & 63;
+    }
+    return pieces;
+}
+
+/* This function takes in a problem and a map for its solution, puts the problem in canonical form, decodes its entry
+ * and maps the squares back through the inverse symmetry.
+ */
+bool CompactDatabase::lookup(GridLocation kingLoc, Vector<char> pieces,
+                             Map<char, Vector<GridLocation>> &result) const {
+    Vector<char> sorted = canonicalPieces(pieces);
+    if (sorted.size() > kMaxDbPieces || !hasPackedCounts(sorted)) {
+        return false;
+    }
+    int symmetry = canonicalSymmetry(kingLoc);
+    GridLocation king = transformLoc(kingLoc, symmetry);
+    int squares[kMaxDbPieces];
+    if (decode(packPieceCounts(sorted), king.row * 8 + king.col, squares) != sorted.size()) {
+        return false;
+    }
+    result.clear();
+    int inverse = inverseSymmetry(symmetry);
+    for (int i = 0; i < sorted.size(); i++) {
+        result[sorted[i]].add(transformLoc(GridLocation(squares[i] / 8, squares[i] % 8), inverse));
+    }
+    return true;
+}
+
+int CompactDatabase::size() const {
+    return _entries;
+}
+
+size_t CompactDatabase::bytes() const {
+    return _bytes;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Elias-Fano random access") {
+    setRandomSeed(89);
+    for (int count : {0, 1, 63, 64, 65, 1000}) {
+        vector<uint64_t> values;
+        uint64_t value = 0;
+        for (int i = 0; i < count; i++) {
+            value += randomChance(0.3) ? 0 : randomInteger(1, 5000);
+            values.push_back(value);
+        }
+        EliasFano sequence(values);
+        string buffer;
+        sequence.write(buffer);
+        size_t pos = 0;
+        EliasFano copy = EliasFano::read(buffer, pos);
+        EXPECT_EQUAL(pos, buffer.size());
+        EXPECT_EQUAL(copy.size(), count);
+        for (int i = 0; i < count; i++) {
+            EXPECT_EQUAL(sequence.at(i), values[i]);
+            EXPECT_EQUAL(copy.at(i), values[i]);
+        }
+        if (count == 1000) {
+            EXPECT(sequence.bits() < size_t(count) * 20);
+        }
+    }
+}
+
+PROVIDED_TEST("Compact database round trip and invalid files") {
+    Vector<Problem> problems = generateCorpus(891, 40, 8);
+    Vector<DbEntry> entries = buildDbEntries(problems, findEngine("patterns"));
+    string dbFile = "compactdb_test.db";
+    writeCompactDatabase(dbFile, entries);
+    CompactDatabase db;
+    db.load(dbFile);
+    EXPECT_EQUAL(db.size(), entries.size());
+    Map<char, Vector<GridLocation>> result;
+    int found = 0;
+    for (const Problem &problem : problems) {
+        if (db.lookup(problem.kingLoc, problem.pieces, result)) {
+            found++;
+            EXPECT(verifyStalemate(problem.kingLoc, problem.pieces, result));
+            Vector<char> reversed = problem.pieces;
+            reversed.reverse();
+            EXPECT(db.lookup(transformLoc(problem.kingLoc, 3), reversed, result));
+            EXPECT(verifyStalemate(transformLoc(problem.kingLoc, 3), reversed, result));
+        }
+    }
+    EXPECT(found >= entries.size());
+    EXPECT(!db.lookup(GridLocation(3, 3), Vector<char>(14, 'B'), result));
+
+    ifstream in(dbFile, ios::binary);
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    in.close();
+    string badFile = "compactdb_bad_test.db";
+    for (size_t cut : {size_t(10), contents.size() / 2, contents.size() - 1}) {
+        ofstream(badFile, ios::binary) << contents.substr(0, cut);
+        EXPECT_ERROR(db.load(badFile));
+    }
+    string flipped = contents;
+    flipped[kHeaderBytes + 2] ^= 1;
+    ofstream(badFile, ios::binary) << flipped;
+    EXPECT_ERROR(db.load(badFile));
+    EXPECT_ERROR(db.load("missing_compactdb_test.db"));
+    remove(dbFile.c_str());
+    remove(badFile.c_str());
+    clearBoard();
+}
+
+PROVIDED_TEST("Compact database size and decode time") {
+    Vector<Problem> problems = generateCorpus(890, 400, 10);
+    auto start = chrono::steady_clock::now();
+    Vector<DbEntry> entries = buildDbEntries(problems, findEngine("patterns"));
+    double solveMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    string rawFile = "compactdb_raw_test.db";
+    string dbFile = "compactdb_test.db";
+    writeSolutionDatabase(rawFile, entries);
+    writeCompactDatabase(dbFile, entries);
+    ifstream raw(rawFile, ios::binary | ios::ate);
+    size_t rawBytes = raw.tellg();
+    raw.close();
+    CompactDatabase db;
+    db.load(dbFile);
+
+    Vector<int> counts;
+    Vector<int> kingSquares;
+    for (const DbEntry &entry : entries) {
+        counts.add(packPieceCounts(entry.pieces));
+        kingSquares.add(entry.kingLoc.row * 8 + entry.kingLoc.col);
+    }
+    const int kRounds = 200;
+    int squares[kMaxDbPieces];
+    long decoded = 0;
+    start = chrono::steady_clock::now();
+    for (int round = 0; round < kRounds; round++) {
+        for (int i = 0; i < counts.size(); i++) {
+            decoded += db.decode(counts[i], kingSquares[i], squares);
+        }
+    }
+    double decodeNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count()
+                         / (kRounds * counts.size());
+    Map<char, Vector<GridLocation>> result;
+    start = chrono::steady_clock::now();
+    for (const Problem &problem : problems) {
+        db.lookup(problem.kingLoc, problem.pieces, result);
+    }
+    double lookupNanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count()
+                         / problems.size();
+    cout << entries.size() << " entries: raw " << rawBytes << " bytes, compact " << db.bytes() << " bytes ("
+         << double(db.bytes()) / entries.size() << " per entry); decode " << decodeNanos << " ns, lookup "
+         << lookupNanos << " ns, solve " << solveMicros * 1000 / problems.size() << " ns" << endl;
+    EXPECT(decoded > 0);
+    EXPECT(db.bytes() * 2 < rawBytes);
+    remove(rawFile.c_str());
+    remove(dbFile.c_str());
+    clearBoard();
+}
@@ -0,0 +1,118 @@
+/*
+ * This file contains the declarations for the compact solution database: solutions grouped by piece multiset, stored
+ * as bit-packed squares relative to the king and found through an Elias-Fano index of the groups' offsets
+ */
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "map.h"
+#include "vector.h"
+#include "soldb.h"
+
+/** A non-decreasing sequence in Elias-Fano form: the low bits of each value packed side by side and the high bits as
+ * a unary bit vector, with the position of every 64th one sampled so any value is read in constant time
+ */
+class EliasFano {
+public:
+    EliasFano() {}
+
+    /**
+     * Encode a sequence
+     * @param non-decreasing values
+     *
+     * This function runs in O(n) for n values
+     */
+    EliasFano(const std::vector<uint64_t> &values);
+
+    /**
+     * Read a value
+     * @param index
+     * @return value at the index
+     *
+     * This function runs in O(1) in expectation
+     */
+    uint64_t at(int index) const;
+
+    int size() const;
+
+    /**
+     * Size of the encoding
+     * @return bits used by the low bits, the unary high bits and the samples
+     *
+     * This function runs in O(1)
+     */
+    size_t bits() const;
+
+    /**
+     * Append the encoding to a buffer, or read it back from one
+     * @param buffer, and for read the position to read from, which is advanced, raising an error if the buffer is
+     *        too short
+     *
+     * This function runs in O(b) for b bits
+     */
+    void write(std::string &buffer) const;
+    static EliasFano read(const std::string &buffer, size_t &pos);
+
+private:
+    int _count = 0;
+    int _lowBits = 0;
+    std::vector<uint64_t> _low;
+    std::vector<uint64_t> _high;
+    std::vector<uint64_t> _samples;   // position in _high of ones 0, 64, 128, ...
+};
+
+/**
+ * Write a compact database file: entries grouped by their packed piece counts, each group holding a mask of the
+ * canonical king squares it has solutions for and, per square, one six-bit code per piece, the piece's square minus the
+ * king's modulo 64. The groups' bit offsets into the codes are indexed with Elias-Fano
+ * @param filename and entries, raising an error if an entry has too many pieces or a piece packPieceCounts has no
+ * field for
+ *
+ * This function runs in O(n log n) for n entries
+ */
+void writeCompactDatabase(std::string filename, Vector<DbEntry> entries);
+
+/** A compact database loaded into memory
+ */
+class CompactDatabase {
+public:
+    /**
+     * Read and validate a file written by writeCompactDatabase
+     * @param filename, raising an error if the file is missing or invalid
+     *
+     * This function runs in O(b) for b bytes
+     */
+    void load(std::string filename);
+
+    /**
+     * Look up a problem's solution
+     * @param opponent king location, pieces and map to fill with the solution
+     * @return whether the problem, up to symmetry and piece order, is in the database
+     *
+     * This function runs in O(log g + p log p) for g groups and p pieces
+     */
+    bool lookup(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &result) const;
+
+    /**
+     * Decode one entry's squares without building a map, the inner step of lookup
+     * @param packed piece counts from packPieceCounts, canonical king square, and an array for up to kMaxDbPieces
+     *        squares in canonical piece order
+     * @return number of squares written, or -1 if there is no such entry
+     *
+     * This function runs in O(log g + p) for g groups and p pieces
+     */
+    int decode(int counts, int kingSquare, int *squares) const;
+
+    int size() const;
+    size_t bytes() const;
+
+private:
+    std::vector<uint32_t> _counts;      // packed piece counts of each group, sorted
+    std::vector<uint16_t> _kings;       // canonical king squares of each group, one bit per square
+    EliasFano _offsets;                 // bit offset of each group's first code
+    std::vector<uint64_t> _codes;
+    int _entries = 0;
+    size_t _bytes = 0;
+};
@@ -0,0 +1,418 @@
+/*
+ * This file contains the implementation of binary corpus files, plain sequences of fixed-size solution records, and the
+ * external merge sort that orders and deduplicates them by canonical key in bounded memory
+ */
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <thread>
+#include <vector>
+#include "corpusfile.h"
+#include "error.h"
+#include "hashset.h"
+#include "strlib.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+void encodeCorpusRecord(const DbEntry &entry, unsigned char *record) {
+    if (entry.pieces.size() > kMaxDbPieces || entry.locs.size() != entry.pieces.size()) {
+        error("Corpus entry does not fit in a record");
+    }
+    memset(record, 0, kCorpusRecordBytes);
+    record[0] = entry.kingLoc.row * 8 + entry.kingLoc.col;
+    record[1] = entry.pieces.size();
+    for (int i = 0; i < entry.pieces.size(); i++) {
+        record[2 + i] = entry.pieces[i];
+        record[kCorpusKeyBytes + i] = entry.locs[i].row * 8 + entry.locs[i].col;
+    }
+}
+
+DbEntry decodeCorpusRecord(const unsigned char *record) {
+    DbEntry entry;
+    entry.kingLoc = GridLocation(record[0] / 8, record[0] % 8);
+    for (int i = 0; i < record[1] && i < kMaxDbPieces; i++) {
+        entry.pieces.add(char(record[2 + i]));
+        entry.locs.add(GridLocation(record[kCorpusKeyBytes + i] / 8, record[kCorpusKeyBytes + i] % 8));
+    }
+    return entry;
+}
+
+void appendCorpusFile(string filename, const Vector<DbEntry> &entries) {
+    string bytes(size_t(entries.size()) * kCorpusRecordBytes, '\0');
+    for (int i = 0; i < entries.size(); i++) {
+        encodeCorpusRecord(entries[i], (unsigned char *) &bytes[size_t(i) * kCorpusRecordBytes]);
+    }
+    ofstream out(filename, ios::binary | ios::app);
+    out.write(bytes.data(), bytes.size());
+    if (!out) {
+        error("Cannot write corpus file " + filename);
+    }
+}
+
+/** Reads a file's records through a buffer filled by large sequential reads
+ */
+class RecordReader {
+public:
+    RecordReader(const string &filename, size_t bufferBytes)
+            : _in(filename, ios::binary), _filename(filename),
+              _buffer(max<size_t>(1, bufferBytes / kCorpusRecordBytes) * kCorpusRecordBytes) {
+        if (!_in) {
+            error("Cannot open corpus file " + filename);
+        }
+    }
+
+    /* This function returns the next record, refilling the buffer when it runs out, or nullptr at the end of the
+     * file. A file that ends inside a record raises an error.
+     */
+    const unsigned char *next() {
+        if (_position == _end) {
+            _in.read((char *) _buffer.data(), _buffer.size());
+            _end = _in.gcount();
+            _position = 0;
+            if (_end % kCorpusRecordBytes != 0) {
+                error("Corpus file " + _filename + " is not a whole number of records");
+            }
+            if (_end == 0) {
+                return nullptr;
+            }
+        }
+        const unsigned char *record = _buffer.data() + _position;
+        _position += kCorpusRecordBytes;
+        return record;
+    }
+
+private:
+    ifstream _in;
+    string _filename;
+    vector<unsigned char> _buffer;
+    size_t _position = 0;
+    size_t _end = 0;
+};
+
+/** Writes records through a buffer emptied by large sequential writes, skipping a record whose key equals the last
+ * one written
+ */
+class RecordWriter {
+public:
+    RecordWriter(const string &filename, size_t bufferBytes)
+            : _out(filename, ios::binary | ios::trunc), _filename(filename),
+              _buffer(max<size_t>(1, bufferBytes / kCorpusRecordBytes) * kCorpusRecordBytes) {
+        if (!_out) {
+            error("Cannot write corpus file " + filename);
+        }
+    }
+
+    void write(const unsigned char *record) {
+        if (_written > 0 && memcmp(_last, record, kCorpusKeyBytes) == 0) {
+            return;
+        }
+        if (_used == _buffer.size()) {
+            flush();
+        }
+        memcpy(_buffer.data() + _used, record, kCorpusRecordBytes);
+        memcpy(_last, record, kCorpusKeyBytes);
+        _used += kCorpusRecordBytes;
+        _written++;
+    }
+
+    void flush() {
+        _out.write((const char *) _buffer.data(), _used);
+        _used = 0;
+        if (!_out) {
+            error("Cannot write corpus file " + _filename);
+        }
+    }
+
+    long written() const {
+        return _written;
+    }
+
+private:
+    ofstream _out;
+    string _filename;
+    vector<unsigned char> _buffer;
+    size_t _used = 0;
+    unsigned char _last[kCorpusKeyBytes];
+    long _written = 0;
+};
+
+Vector<DbEntry> readCorpusFile(string filename) {
+    RecordReader reader(filename, 1 << 20);
+    Vector<DbEntry> entries;
+    for (const unsigned char *record = reader.next(); record != nullptr; record = reader.next()) {
+        entries.add(decodeCorpusRecord(record));
+    }
+    return entries;
+}
+
+/* This function takes in a run's records, their count and a number of threads and returns the record indices in key
+ * order, equal keys in file order. Each thread sorts a slice of the indices, then neighbouring slices are merged in
+ * pairs, also in parallel, until one slice is left.
+ */
+static vector<uint32_t> sortRun(const unsigned char *records, size_t count, int threads) {
+    vector<uint32_t> order(count);
+    for (size_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    auto before = [records](uint32_t a, uint32_t b) {
+        int compare = memcmp(records + size_t(a) * kCorpusRecordBytes, records + size_t(b) * kCorpusRecordBytes,
+                             kCorpusKeyBytes);
+        return compare < 0 || (compare == 0 && a < b);
+    };
+    int slices = max(1, min<int>(threads, count));
+    vector<size_t> bounds;
+    for (int i = 0; i <= slices; i++) {
+        bounds.push_back(count * i / slices);
+    }
+    vector<thread> workers;
+    for (int i = 0; i < slices; i++) {
+        workers.emplace_back([&, i]() {
+            sort(order.begin() + bounds[i], order.begin() + bounds[i + 1], before);
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    for (int width = 1; width < slices; width *= 2) {
+        workers.clear();
+        for (int i = 0; i + width < slices; i += 2 * width) {
+            workers.emplace_back([&, i, width]() {
+                inplace_merge(order.begin() + bounds[i], order.begin() + bounds[i + width],
+                              order.begin() + bounds[min(i + 2 * width, slices)], before);
+            });
+        }
+        for (thread &worker : workers) {
+            worker.join();
+        }
+    }
+    return order;
+}
+
+/* This function takes in run files in input order, an output file and the bytes for buffers, and merges the runs with
+ * a heap of each run's next record, ordered by key and then by run so the first record of each key in input order is
+ * the one kept. It returns the number of records written.
+ */
+static long mergeRuns(const vector<string> &runs, const string &output, size_t memoryBytes, size_t ioBytes) {
+    size_t bufferBytes = min(ioBytes, memoryBytes / (runs.size() + 1));
+    vector<unique_ptr<RecordReader>> readers;
+    for (const string &run : runs) {
+        readers.emplace_back(new RecordReader(run, bufferBytes));
+    }
+    typedef pair<const unsigned char *, size_t> Head;
+    auto after = [](const Head &a, const Head &b) {
+        int compare = memcmp(a.first, b.first, kCorpusKeyBytes);
+        return compare > 0 || (compare == 0 && a.second > b.second);
+    };
+    priority_queue<Head, vector<Head>, decltype(after)> heads(after);
+    for (size_t i = 0; i < readers.size(); i++) {
+        const unsigned char *record = readers[i]->next();
+        if (record != nullptr) {
+            heads.push(Head(record, i));
+        }
+    }
+    RecordWriter writer(output, bufferBytes);
+    while (!heads.empty()) {
+        Head head = heads.top();
+        heads.pop();
+        writer.write(head.first);
+        const unsigned char *record = readers[head.second]->next();
+        if (record != nullptr) {
+            heads.push(Head(record, head.second));
+        }
+    }
+    writer.flush();
+    return writer.written();
+}
+
+/* This function takes in input and output filenames and options. Run generation fills a buffer of as many records as
+ * the memory allows with large reads, sorts their indices on several threads and writes the records in order, each key
+ * once, to a run file. Runs are then merged maxFanIn at a time into longer runs until one last merge writes the
+ * output. A record is only ever dropped for an earlier record with the same key, so the output keeps the first record
+ * of each key in the input.
+ */
+CorpusSortStats sortCorpusFile(string input, string output, CorpusSortOptions options) {
+    auto start = chrono::steady_clock::now();
+    if (input == output) {
+        error("Sorting a corpus file needs a different output file");
+    }
+    string prefix = options.tempPrefix.empty() ? output : options.tempPrefix;
+    size_t ioBytes = max<size_t>(kCorpusRecordBytes, options.ioBytes);
+    size_t runRecords = max<size_t>(1, options.memoryBytes / (kCorpusRecordBytes + sizeof(uint32_t)));
+    CorpusSortStats stats;
+
+    vector<string> runs;
+    vector<unsigned char> chunk(runRecords * kCorpusRecordBytes);
+    RecordReader reader(input, ioBytes);
+    for (bool done = false; !done; ) {
+        size_t count = 0;
+        for (const unsigned char *record = nullptr; count < runRecords; count++) {
+            record = reader.next();
+            if (record == nullptr) {
+                done = true;
+                break;
+            }
+            memcpy(chunk.data() + count * kCorpusRecordBytes, record, kCorpusRecordBytes);
+        }
+        if (count == 0) {
+            break;
+        }
+        stats.records += count;
+        string run = prefix + ".run" + integerToString(runs.size());
+        RecordWriter writer(run, ioBytes);
+        for (uint32_t index : sortRun(chunk.data(), count, options.threads)) {
+            writer.write(chunk.data() + size_t(index) * kCorpusRecordBytes);
+        }
+        writer.flush();
+        runs.push_back(run);
+    }
+    chunk = vector<unsigned char>();
+    stats.runs = runs.size();
+
+    int fanIn = max(2, options.maxFanIn);
+    for (int pass = 0; runs.size() > size_t(fanIn); pass++) {
+        vector<string> merged;
+        for (size_t first = 0; first < runs.size(); first += fanIn) {
+            vector<string> group(runs.begin() + first, runs.begin() + min(runs.size(), first + fanIn));
+            string run = prefix + ".pass" + integerToString(pass) + "." + integerToString(merged.size());
+            mergeRuns(group, run, options.memoryBytes, ioBytes);
+            for (const string &old : group) {
+                remove(old.c_str());
+            }
+            merged.push_back(run);
+        }
+        runs = merged;
+        stats.mergePasses++;
+    }
+    stats.unique = mergeRuns(runs, output, options.memoryBytes, ioBytes);
+    stats.mergePasses++;
+    for (const string &run : runs) {
+        remove(run.c_str());
+    }
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    return stats;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/* This function takes in a generator and a pool size and returns an entry whose key is one of pool keys and whose
+ * squares are random, so equal keys usually carry different records.
+ */
+static DbEntry randomEntry(mt19937_64 &random, int pool) {
+    mt19937_64 keyRandom(random() % pool);
+    DbEntry entry;
+    entry.kingLoc = canonicalKingSquare(keyRandom() % kNumCanonicalKings);
+    Vector<char> pieces = {'K'};
+    int count = 1 + keyRandom() % 8;
+    for (int i = 0; i < count; i++) {
+        pieces.add("QRBH"[keyRandom() % 4]);
+    }
+    entry.pieces = canonicalPieces(pieces);
+    for (int i = 0; i < entry.pieces.size(); i++) {
+        entry.locs.add(GridLocation(random() % 8, random() % 8));
+    }
+    return entry;
+}
+
+/* This function takes in a filename and returns the file's bytes.
+ */
+static string fileBytes(const string &filename) {
+    ifstream in(filename, ios::binary);
+    return string((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+}
+
+PROVIDED_TEST("Corpus file round trip") {
+    string corpusFile = "corpus_test.bin";
+    remove(corpusFile.c_str());
+    Vector<DbEntry> entries = buildDbEntries(generateCorpus(950, 20, 8), findEngine("sorted-greedy"));
+    appendCorpusFile(corpusFile, entries);
+    appendCorpusFile(corpusFile, entries);
+    Vector<DbEntry> read = readCorpusFile(corpusFile);
+    EXPECT_EQUAL(read.size(), 2 * entries.size());
+    for (int i = 0; i < read.size(); i++) {
+        const DbEntry &entry = entries[i % entries.size()];
+        EXPECT_EQUAL(read[i].kingLoc, entry.kingLoc);
+        EXPECT_EQUAL(read[i].pieces, entry.pieces);
+        EXPECT_EQUAL(read[i].locs, entry.locs);
+    }
+    ofstream(corpusFile, ios::binary | ios::app) << "partial";
+    EXPECT_ERROR(readCorpusFile(corpusFile));
+    EXPECT_ERROR(readCorpusFile("missing_corpus_test.bin"));
+    remove(corpusFile.c_str());
+    clearBoard();
+}
+
+PROVIDED_TEST("External sort keeps the first record of each key in key order") {
+    string input = "corpus_sort_test.bin";
+    string output = "corpus_sorted_test.bin";
+    remove(input.c_str());
+    mt19937_64 random(95);
+    Vector<DbEntry> entries;
+    for (int i = 0; i < 20000; i++) {
+        entries.add(randomEntry(random, 3000));
+    }
+    appendCorpusFile(input, entries);
+
+    Map<string, string> expected;
+    for (const DbEntry &entry : entries) {
+        unsigned char record[kCorpusRecordBytes];
+        encodeCorpusRecord(entry, record);
+        string key((const char *) record, kCorpusKeyBytes);
+        if (!expected.containsKey(key)) {
+            expected[key] = string((const char *) record, kCorpusRecordBytes);
+        }
+    }
+    string sorted;
+    for (const string &key : expected) {
+        sorted += expected[key];
+    }
+
+    for (int threads : {1, 3}) {
+        CorpusSortOptions options;
+        options.memoryBytes = 64 << 10;
+        options.ioBytes = 4 << 10;
+        options.threads = threads;
+        options.maxFanIn = 4;
+        CorpusSortStats stats = sortCorpusFile(input, output, options);
+        EXPECT_EQUAL(stats.records, entries.size());
+        EXPECT_EQUAL(stats.unique, expected.size());
+        EXPECT(stats.runs > 4);
+        EXPECT(stats.mergePasses > 1);
+        EXPECT(fileBytes(output) == sorted);
+    }
+    EXPECT_ERROR(sortCorpusFile(input, input));
+    remove(input.c_str());
+    remove(output.c_str());
+}
+
+PROVIDED_TEST("External sort throughput") {
+    string input = "corpus_bench_test.bin";
+    string output = "corpus_bench_sorted_test.bin";
+    remove(input.c_str());
+    mt19937_64 random(96);
+    const int records = 1 << 20;
+    for (int block = 0; block < 16; block++) {
+        Vector<DbEntry> entries;
+        for (int i = 0; i < records / 16; i++) {
+            entries.add(randomEntry(random, records / 4));
+        }
+        appendCorpusFile(input, entries);
+    }
+    CorpusSortOptions options;
+    options.memoryBytes = 8 << 20;
+    options.threads = max(1, int(thread::hardware_concurrency()));
+    CorpusSortStats stats = sortCorpusFile(input, output, options);
+    double megabytes = double(stats.records) * kCorpusRecordBytes / (1 << 20);
+    cout << stats.records << " records (" << megabytes << " MB) to " << stats.unique << " unique in " << stats.runs
+         << " runs, " << stats.mergePasses << " merge passes, " << stats.seconds << " s, " << megabytes / stats.seconds
+         << " MB/s" << endl;
+    EXPECT_EQUAL(readCorpusFile(output).size(), stats.unique);
+    remove(input.c_str());
+    remove(output.c_str());
+}
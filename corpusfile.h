@@ -0,0 +1,86 @@
+/*
+ * This file contains the declarations for binary corpus files, plain sequences of fixed-size solution records, and the
+ * external merge sort that orders and deduplicates them by canonical key in bounded memory
+ */
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include "vector.h"
+#include "soldb.h"
+
+/** Bytes in a corpus record: the canonical key, then the square of each piece, laid out as a solution database record
+ */
+const int kCorpusRecordBytes = 32;
+
+/** Bytes of a record's canonical key: king square, number of pieces, pieces padded with zeros; keys compare with memcmp
+ */
+const int kCorpusKeyBytes = 2 + kMaxDbPieces;
+
+/** Settings for sortCorpusFile
+ */
+struct CorpusSortOptions {
+    size_t memoryBytes = 256 << 20;     // records held at once, for sorting a run or as merge buffers
+    size_t ioBytes = 4 << 20;           // size of each sequential read and write, shrunk to fit a merge in memory
+    int threads = 1;                    // threads sorting slices of each run
+    int maxFanIn = 64;                  // runs merged at once; more runs are merged in several passes
+    std::string tempPrefix;             // prefix for run files, the output name if empty
+};
+
+/** Summary of a sortCorpusFile call
+ */
+struct CorpusSortStats {
+    long records = 0;       // records read
+    long unique = 0;        // records written, one per canonical key
+    int runs = 0;           // sorted runs written by run generation
+    int mergePasses = 0;    // passes over the data after run generation
+    double seconds = 0;
+};
+
+/**
+ * Write a record for an entry
+ * @param entry in canonical form and a buffer of kCorpusRecordBytes, raising an error if the entry has too many
+ *        pieces
+ *
+ * This function runs in O(n) for n pieces
+ */
+void encodeCorpusRecord(const DbEntry &entry, unsigned char *record);
+
+/**
+ * Read the entry a record holds
+ * @param record
+ * @return entry in canonical form
+ *
+ * This function runs in O(n) for n pieces
+ */
+DbEntry decodeCorpusRecord(const unsigned char *record);
+
+/**
+ * Append entries to a corpus file, creating it if needed; corpus files have no header, so files can be joined by
+ * concatenation
+ * @param filename and entries, raising an error if the file cannot be written
+ *
+ * This function runs in O(n) for n entries
+ */
+void appendCorpusFile(std::string filename, const Vector<DbEntry> &entries);
+
+/**
+ * Read every record of a corpus file
+ * @param filename, raising an error if the file cannot be read or is not a whole number of records
+ * @return entries in file order
+ *
+ * This function runs in O(n) for n records
+ */
+Vector<DbEntry> readCorpusFile(std::string filename);
+
+/**
+ * Sort a corpus file by canonical key and keep the first record of each key, in memory bounded by the options: runs
+ * that fit in memory are sorted on several threads and written out, then merged k ways with large sequential reads
+ * and writes
+ * @param input and output filenames, which must differ, and options; raises an error if a file cannot be read or
+ *        written
+ * @return summary of the sort
+ *
+ * This function runs in O(n log n) for n records, reading and writing the data once per merge pass
+ */
+CorpusSortStats sortCorpusFile(std::string input, std::string output, CorpusSortOptions options = CorpusSortOptions());
@@ -0,0 +1,733 @@
+/*
+ * This file contains the implementation of streaming corpus I/O: a writer and a reader for corpus files that keep
+ * several buffers in flight through io_uring, falling back to pread and pwrite where io_uring is not available
+ */
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <random>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#endif
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#endif
+#include "corpusio.h"
+#include "engines.h"
+#include "error.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/* This function takes in a filename, whether it is for writing and whether writes must be durable, and returns a
+ * descriptor, -1 on failure. A file for writing is created or truncated, and a durable one opened with O_DSYNC where
+ * the platform has it.
+ */
+static int openFile(const string &filename, bool forWriting, bool durable = false) {
+#if defined(__unix__) || defined(__APPLE__)
+    int sync = 0;
+#ifdef O_DSYNC
+    sync = durable ? O_DSYNC : 0;
+#endif
+    return forWriting ? open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | sync, 0644)
+                      : open(filename.c_str(), O_RDONLY);
+#else
+    return forWriting ? _open(filename.c_str(), _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE)
+                      : _open(filename.c_str(), _O_RDONLY | _O_BINARY);
+#endif
+}
+
+static void closeFile(int fd) {
+#if defined(__unix__) || defined(__APPLE__)
+    close(fd);
+#else
+    _close(fd);
+#endif
+}
+
+static uint64_t fileSize(int fd) {
+#if defined(__unix__) || defined(__APPLE__)
+    struct stat info;
+    return fstat(fd, &info) == 0 ? info.st_size : 0;
+#else
+    return _filelengthi64(fd);
+#endif
+}
+
+/* This function takes in a descriptor, bytes and a file offset and writes all the bytes there, retrying short writes.
+ * It returns false if a write fails.
+ */
+static bool positionalWrite(int fd, const unsigned char *data, size_t bytes, uint64_t offset) {
+    while (bytes > 0) {
+#if defined(__unix__) || defined(__APPLE__)
+        ssize_t written = pwrite(fd, data, bytes, offset);
+#else
+        long written = _lseeki64(fd, offset, SEEK_SET) < 0 ? -1 : _write(fd, data, unsigned(bytes));
+#endif
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            return false;
+        }
+        data += written;
+        bytes -= written;
+        offset += written;
+    }
+    return true;
+}
+
+/* This function takes in a descriptor, a buffer, a number of bytes and a file offset and reads all the bytes from
+ * there, retrying short reads. It returns false if a read fails or the file ends first.
+ */
+static bool positionalRead(int fd, unsigned char *data, size_t bytes, uint64_t offset) {
+    while (bytes > 0) {
+#if defined(__unix__) || defined(__APPLE__)
+        ssize_t read = pread(fd, data, bytes, offset);
+#else
+        long read = _lseeki64(fd, offset, SEEK_SET) < 0 ? -1 : _read(fd, data, unsigned(bytes));
+#endif
+        if (read < 0 && errno == EINTR) {
+            continue;
+        }
+        if (read <= 0) {
+            return false;
+        }
+        data += read;
+        bytes -= read;
+        offset += read;
+    }
+    return true;
+}
+
+#ifdef HAVE_IO_URING
+
+/** A minimal io_uring: one submission and one completion ring mapped from the kernel, driven with the raw system
+ * calls. Every request carries the index of its buffer as user data
+ */
+class UringQueue {
+public:
+    ~UringQueue() {
+        if (_sqes != nullptr) {
+            munmap(_sqes, _sqesBytes);
+        }
+        if (_cqRing != nullptr && _cqRing != _sqRing) {
+            munmap(_cqRing, _cqRingBytes);
+        }
+        if (_sqRing != nullptr) {
+            munmap(_sqRing, _sqRingBytes);
+        }
+        if (_fd >= 0) {
+            close(_fd);
+        }
+    }
+
+    /* This function takes in the number of requests that may be in flight and sets up and maps the rings, returning
+     * false if the kernel refuses, as it does under some sandboxes.
+     */
+    bool open(unsigned entries) {
+        io_uring_params params;
+        memset(&params, 0, sizeof(params));
+        _fd = syscall(__NR_io_uring_setup, entries, &params);
+        if (_fd < 0) {
+            return false;
+        }
+        _sqRingBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        _cqRingBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool single = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (single) {
+            _sqRingBytes = _cqRingBytes = max(_sqRingBytes, _cqRingBytes);
+        }
+        _sqRing = mmap(nullptr, _sqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                       IORING_OFF_SQ_RING);
+        if (_sqRing == MAP_FAILED) {
+            _sqRing = nullptr;
+            return false;
+        }
+        _cqRing = single ? _sqRing : mmap(nullptr, _cqRingBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                                          _fd, IORING_OFF_CQ_RING);
+        if (_cqRing == MAP_FAILED) {
+            _cqRing = nullptr;
+            return false;
+        }
+        _sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+        void *sqes = mmap(nullptr, _sqesBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _fd,
+                          IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            return false;
+        }
+        _sqes = (io_uring_sqe *) sqes;
+        char *sq = (char *) _sqRing;
+        char *cq = (char *) _cqRing;
+        _sqTail = (unsigned *) (sq + params.sq_off.tail);
+        _sqMask = *(unsigned *) (sq + params.sq_off.ring_mask);
+        _sqArray = (unsigned *) (sq + params.sq_off.array);
+        _cqHead = (unsigned *) (cq + params.cq_off.head);
+        _cqTail = (unsigned *) (cq + params.cq_off.tail);
+        _cqMask = *(unsigned *) (cq + params.cq_off.ring_mask);
+        _cqes = (io_uring_cqe *) (cq + params.cq_off.cqes);
+        return true;
+    }
+
+    /* This function takes in buffers of equal size and registers them with the kernel, so fixed reads and writes skip
+     * mapping the pages on every request. It returns false if registration is refused, for example by the locked
+     * memory limit, and requests then pass plain addresses.
+     */
+    bool registerBuffers(const vector<unsigned char *> &buffers, size_t bytes) {
+        vector<iovec> vectors;
+        for (unsigned char *buffer : buffers) {
+            vectors.push_back({buffer, bytes});
+        }
+        _registered = syscall(__NR_io_uring_register, _fd, IORING_REGISTER_BUFFERS, vectors.data(),
+                              vectors.size()) == 0;
+        return _registered;
+    }
+
+    /* This function takes in a read or write, a file, a buffer index and address, a length and a file offset, and
+     * queues the request; it reaches the kernel on the next submit.
+     */
+    void push(bool write, int fd, int buffer, unsigned char *address, size_t length, uint64_t offset) {
+        unsigned tail = *_sqTail;
+        unsigned index = tail & _sqMask;
+        io_uring_sqe *sqe = &_sqes[index];
+        memset(sqe, 0, sizeof(*sqe));
+        if (_registered) {
+            sqe->opcode = write ? IORING_OP_WRITE_FIXED : IORING_OP_READ_FIXED;
+            sqe->buf_index = buffer;
+        } else {
+            sqe->opcode = write ? IORING_OP_WRITE : IORING_OP_READ;
+        }
+        sqe->fd = fd;
+        sqe->addr = (uint64_t) address;
+        sqe->len = length;
+        sqe->off = offset;
+        sqe->user_data = buffer;
+        _sqArray[index] = index;
+        __atomic_store_n(_sqTail, tail + 1, __ATOMIC_RELEASE);
+        _queued++;
+    }
+
+    /* This function hands the queued requests to the kernel in one system call, returning false if it fails.
+     */
+    bool submit() {
+        while (_queued > 0) {
+            int submitted = syscall(__NR_io_uring_enter, _fd, _queued, 0, 0, nullptr, 0);
+            if (submitted < 0 && (errno == EINTR || errno == EAGAIN)) {
+                continue;
+            }
+            if (submitted <= 0) {
+                return false;
+            }
+            _queued -= submitted;
+        }
+        return true;
+    }
+
+    /* This function takes the oldest completion, waiting for one, and sets its buffer index and result: bytes moved,
+     * or a negative error number.
+     */
+    void complete(int &buffer, int &result) {
+        while (true) {
+            unsigned head = *_cqHead;
+            if (head != __atomic_load_n(_cqTail, __ATOMIC_ACQUIRE)) {
+                io_uring_cqe *cqe = &_cqes[head & _cqMask];
+                buffer = cqe->user_data;
+                result = cqe->res;
+                __atomic_store_n(_cqHead, head + 1, __ATOMIC_RELEASE);
+                return;
+            }
+            int waited = syscall(__NR_io_uring_enter, _fd, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            if (waited < 0 && errno != EINTR && errno != EAGAIN) {
+                buffer = -1;
+                result = -errno;
+                return;
+            }
+        }
+    }
+
+private:
+    int _fd = -1;
+    void *_sqRing = nullptr;
+    void *_cqRing = nullptr;
+    size_t _sqRingBytes = 0;
+    size_t _cqRingBytes = 0;
+    io_uring_sqe *_sqes = nullptr;
+    size_t _sqesBytes = 0;
+    unsigned *_sqTail = nullptr;
+    unsigned *_sqArray = nullptr;
+    unsigned _sqMask = 0;
+    unsigned *_cqHead = nullptr;
+    unsigned *_cqTail = nullptr;
+    unsigned _cqMask = 0;
+    io_uring_cqe *_cqes = nullptr;
+    unsigned _queued = 0;
+    bool _registered = false;
+};
+
+#else
+
+/** Stand-in where io_uring does not exist: it can never be opened, so streams use positional I/O
+ */
+class UringQueue {
+public:
+    bool open(unsigned entries) {
+        return false;
+    }
+    bool registerBuffers(const vector<unsigned char *> &buffers, size_t bytes) {
+        return false;
+    }
+    void push(bool write, int fd, int buffer, unsigned char *address, size_t length, uint64_t offset) {}
+    bool submit() {
+        return false;
+    }
+    void complete(int &buffer, int &result) {
+        buffer = -1;
+        result = -1;
+    }
+};
+
+#endif
+
+/* This function takes in a requested backend, a ring to set up and the buffers, and returns the backend in use: the
+ * ring is opened with room for every buffer and the buffers registered with it unless positional I/O was asked for or
+ * the ring cannot be opened, in which case the ring is dropped.
+ */
+static CorpusIoBackend openBackend(CorpusIoBackend backend, unique_ptr<UringQueue> &ring,
+                                   const vector<unsigned char *> &buffers, size_t bufferBytes) {
+    if (backend != CorpusIoBackend::Positional) {
+        ring.reset(new UringQueue());
+        if (ring->open(buffers.size())) {
+            ring->registerBuffers(buffers, bufferBytes);
+            return CorpusIoBackend::Uring;
+        }
+        ring.reset();
+    }
+    return CorpusIoBackend::Positional;
+}
+
+/* This function takes in the number of buffers and bytes per buffer asked for and lays out the buffers in one block,
+ * at least two, each a whole number of records.
+ */
+static void layOutBuffers(int count, size_t &bufferBytes, vector<unsigned char> &storage,
+                          vector<unsigned char *> &buffers) {
+    bufferBytes = max<size_t>(1, bufferBytes / kCorpusRecordBytes) * kCorpusRecordBytes;
+    count = max(2, count);
+    storage.assign(bufferBytes * count, 0);
+    for (int i = 0; i < count; i++) {
+        buffers.push_back(storage.data() + i * bufferBytes);
+    }
+}
+
+CorpusStreamWriter::CorpusStreamWriter(string filename, CorpusIoBackend backend, size_t bufferBytes, int buffers,
+                                       bool durable) {
+    _filename = filename;
+    _fd = openFile(filename, true, durable);
+    if (_fd < 0) {
+        error("Cannot write corpus file " + filename);
+    }
+    _bufferBytes = bufferBytes;
+    layOutBuffers(buffers, _bufferBytes, _storage, _buffers);
+    for (int i = _buffers.size() - 1; i >= 0; i--) {
+        _free.push_back(i);
+    }
+    _pending.assign(_buffers.size(), 0);
+    _offsets.assign(_buffers.size(), 0);
+    _backend = openBackend(backend, _ring, _buffers, _bufferBytes);
+}
+
+CorpusStreamWriter::~CorpusStreamWriter() {
+    try {
+        close();
+    } catch (...) {
+        // a destructor cannot report the error; call close to see it
+    }
+    // close has waited for every write it could; the ring goes before the buffers it may still refer to
+    _ring.reset();
+}
+
+void CorpusStreamWriter::write(const unsigned char *record) {
+    if (_current < 0) {
+        _current = reclaim();
+    }
+    memcpy(_buffers[_current] + _used, record, kCorpusRecordBytes);
+    _used += kCorpusRecordBytes;
+    _records++;
+    if (_used == _bufferBytes) {
+        submit(_current);
+        _current = -1;
+    }
+}
+
+void CorpusStreamWriter::write(const DbEntry &entry) {
+    unsigned char record[kCorpusRecordBytes];
+    encodeCorpusRecord(entry, record);
+    write(record);
+}
+
+/* This function takes in the buffer being filled and writes its bytes at the end of the file: with io_uring the write
+ * is queued and submitted and the buffer stays busy until its completion is reclaimed, and otherwise it is written
+ * with pwrite and is free again at once.
+ */
+void CorpusStreamWriter::submit(int buffer) {
+    size_t bytes = _used;
+    _used = 0;
+    if (_backend == CorpusIoBackend::Uring) {
+        _ring->push(true, _fd, buffer, _buffers[buffer], bytes, _offset);
+        if (!_ring->submit()) {
+            error("Cannot write corpus file " + _filename);
+        }
+        _pending[buffer] = bytes;
+        _offsets[buffer] = _offset;
+        _inFlight++;
+    } else {
+        if (!positionalWrite(_fd, _buffers[buffer], bytes, _offset)) {
+            error("Cannot write corpus file " + _filename);
+        }
+        _free.push_back(buffer);
+    }
+    _offset += bytes;
+}
+
+/* This function takes in a buffer whose write completed and its result, finishing a short write with pwrite and
+ * raising an error for a failed one.
+ */
+void CorpusStreamWriter::finish(int buffer, int result) {
+    _inFlight--;
+    if (buffer < 0 || result < 0 || !positionalWrite(_fd, _buffers[buffer] + result, _pending[buffer] - result,
+                                                     _offsets[buffer] + result)) {
+        error("Cannot write corpus file " + _filename);
+    }
+}
+
+/* This function returns a buffer to fill, waiting for the oldest write to complete if every buffer is busy.
+ */
+int CorpusStreamWriter::reclaim() {
+    if (_free.empty()) {
+        int buffer;
+        int result;
+        _ring->complete(buffer, result);
+        finish(buffer, result);
+        return buffer;
+    }
+    int buffer = _free.back();
+    _free.pop_back();
+    return buffer;
+}
+
+/* This function writes the partly filled buffer, waits for every write in flight and closes the file. A failed write
+ * does not stop it waiting for the others or closing the file; the error is raised once the file is closed.
+ */
+void CorpusStreamWriter::close() {
+    if (_fd < 0) {
+        return;
+    }
+    int fd = _fd;
+    bool failed = false;
+    if (_current >= 0 && _used > 0) {
+        try {
+            submit(_current);
+        } catch (ErrorException &) {
+            failed = true;
+        }
+    }
+    _current = -1;
+    while (_inFlight > 0) {
+        int buffer;
+        int result;
+        _ring->complete(buffer, result);
+        if (buffer < 0) {
+            break;
+        }
+        try {
+            finish(buffer, result);
+        } catch (ErrorException &) {
+            failed = true;
+        }
+        _free.push_back(buffer);
+    }
+    _fd = -1;
+    closeFile(fd);
+    if (failed || _inFlight > 0) {
+        error("Cannot write corpus file " + _filename);
+    }
+}
+
+CorpusIoBackend CorpusStreamWriter::backend() const {
+    return _backend;
+}
+
+long CorpusStreamWriter::records() const {
+    return _records;
+}
+
+CorpusStreamReader::CorpusStreamReader(string filename, CorpusIoBackend backend, size_t bufferBytes, int buffers) {
+    _filename = filename;
+    _fd = openFile(filename, false);
+    if (_fd < 0) {
+        error("Cannot open corpus file " + filename);
+    }
+    _size = fileSize(_fd);
+    if (_size % kCorpusRecordBytes != 0) {
+        closeFile(_fd);
+        error("Corpus file " + filename + " is not a whole number of records");
+    }
+    _bufferBytes = bufferBytes;
+    layOutBuffers(buffers, _bufferBytes, _storage, _buffers);
+    _lengths.assign(_buffers.size(), 0);
+    _offsets.assign(_buffers.size(), 0);
+    _backend = openBackend(backend, _ring, _buffers, _bufferBytes);
+}
+
+/* This function waits for the reads still in flight, which write into the buffers, before the buffers go away. Their
+ * results are dropped, since a failed read only matters to a caller still reading.
+ */
+CorpusStreamReader::~CorpusStreamReader() {
+    while (_inFlight > 0) {
+        int buffer;
+        int result;
+        _ring->complete(buffer, result);
+        if (buffer < 0) {
+            break;
+        }
+        _inFlight--;
+    }
+    // the ring goes before the buffers it may still refer to
+    _ring.reset();
+    closeFile(_fd);
+}
+
+/* This function takes in a consumed buffer and refills it with the next part of the file: queued and submitted with
+ * io_uring, or read with pread. A buffer past the end of the file is left empty.
+ */
+void CorpusStreamReader::submit(int buffer) {
+    size_t length = min<uint64_t>(_bufferBytes, _size - _nextOffset);
+    _offsets[buffer] = _nextOffset;
+    _nextOffset += length;
+    if (length == 0) {
+        _lengths[buffer] = 0;
+    } else if (_backend == CorpusIoBackend::Uring) {
+        _ring->push(false, _fd, buffer, _buffers[buffer], length, _offsets[buffer]);
+        if (!_ring->submit()) {
+            _lengths[buffer] = 0;
+            _failed = true;
+            error("Cannot read corpus file " + _filename);
+        }
+        _lengths[buffer] = -1;
+        _inFlight++;
+    } else {
+        if (!positionalRead(_fd, _buffers[buffer], length, _offsets[buffer])) {
+            _lengths[buffer] = 0;
+            _failed = true;
+            error("Cannot read corpus file " + _filename);
+        }
+        _lengths[buffer] = length;
+    }
+}
+
+/* This function takes in a buffer and waits until its read is complete, recording completions of other buffers on the
+ * way and finishing short reads with pread. A buffer whose read failed, whichever buffer is being waited for, is
+ * marked as no longer in flight before the error is raised, so no later wait blocks on it.
+ */
+void CorpusStreamReader::await(int buffer) {
+    while (_lengths[buffer] < 0) {
+        int done;
+        int result;
+        _ring->complete(done, result);
+        if (done < 0) {
+            _failed = true;
+            error("Cannot read corpus file " + _filename);
+        }
+        _inFlight--;
+        size_t length = min<uint64_t>(_bufferBytes, _size - _offsets[done]);
+        if (result < 0 || (size_t(result) < length && !positionalRead(_fd, _buffers[done] + result, length - result,
+                                                                      _offsets[done] + result))) {
+            _lengths[done] = 0;
+            _failed = true;
+            error("Cannot read corpus file " + _filename);
+        }
+        _lengths[done] = length;
+    }
+}
+
+/* This function returns the next record of the buffer being consumed. The first call submits a read for every buffer;
+ * after that a buffer is refilled as soon as it is consumed, and the reader moves on to the next buffer in turn. Once a
+ * read has failed every call raises the error again rather than returning what is left.
+ */
+const unsigned char *CorpusStreamReader::next() {
+    if (_failed) {
+        error("Cannot read corpus file " + _filename);
+    }
+    if (!_started) {
+        _started = true;
+        for (size_t buffer = 0; buffer < _buffers.size(); buffer++) {
+            submit(buffer);
+        }
+    }
+    while (true) {
+        await(_current);
+        if (_lengths[_current] == 0) {
+            return nullptr;
+        }
+        if (_position < size_t(_lengths[_current])) {
+            const unsigned char *record = _buffers[_current] + _position;
+            _position += kCorpusRecordBytes;
+            return record;
+        }
+        submit(_current);
+        _current = (_current + 1) % _buffers.size();
+        _position = 0;
+    }
+}
+
+CorpusIoBackend CorpusStreamReader::backend() const {
+    return _backend;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/* This function takes in a backend and returns its name for reports.
+ */
+static string backendName(CorpusIoBackend backend) {
+    return backend == CorpusIoBackend::Uring ? "io_uring" : "pread/pwrite";
+}
+
+PROVIDED_TEST("Corpus streams round trip on every backend") {
+    string corpusFile = "corpusio_test.bin";
+    Vector<DbEntry> entries = buildDbEntries(generateCorpus(960, 40, 8), findEngine("patterns"));
+    for (CorpusIoBackend backend : {CorpusIoBackend::Automatic, CorpusIoBackend::Uring,
+                                    CorpusIoBackend::Positional}) {
+        {
+            CorpusStreamWriter writer(corpusFile, backend, 100, 3);
+            for (int repeat = 0; repeat < 5; repeat++) {
+                for (const DbEntry &entry : entries) {
+                    writer.write(entry);
+                }
+            }
+            EXPECT_EQUAL(writer.records(), 5L * entries.size());
+            if (backend == CorpusIoBackend::Positional) {
+                EXPECT(writer.backend() == CorpusIoBackend::Positional);
+            }
+        }
+        Vector<DbEntry> read = readCorpusFile(corpusFile);
+        EXPECT_EQUAL(read.size(), 5 * entries.size());
+        CorpusStreamReader reader(corpusFile, backend, 96, 2);
+        int count = 0;
+        for (const unsigned char *record = reader.next(); record != nullptr; record = reader.next()) {
+            DbEntry entry = decodeCorpusRecord(record);
+            const DbEntry &expected = entries[count % entries.size()];
+            EXPECT_EQUAL(entry.kingLoc, expected.kingLoc);
+            EXPECT_EQUAL(entry.pieces, expected.pieces);
+            EXPECT_EQUAL(entry.locs, expected.locs);
+            count++;
+        }
+        EXPECT_EQUAL(count, 5 * entries.size());
+        EXPECT(reader.next() == nullptr);
+        {
+            CorpusStreamReader abandoned(corpusFile, backend, 96, 4);
+            EXPECT(abandoned.next() != nullptr);
+        }
+    }
+    ofstream(corpusFile, ios::binary | ios::app) << "partial";
+    EXPECT_ERROR(CorpusStreamReader reader(corpusFile));
+    EXPECT_ERROR(CorpusStreamReader reader("missing_corpusio_test.bin"));
+    remove(corpusFile.c_str());
+    clearBoard();
+}
+
+PROVIDED_TEST("Streaming benchmark by I/O backend") {
+    string problemFile = "corpusio_problems_test.bin";
+    string solutionFile = "corpusio_solutions_test.bin";
+    string durableFile = "corpusio_durable_test.bin";
+    Vector<Problem> problems = generateCorpus(961, 2000, 10);
+    {
+        CorpusStreamWriter writer(problemFile, CorpusIoBackend::Positional);
+        for (const Problem &problem : problems) {
+            DbEntry entry;
+            entry.kingLoc = transformLoc(problem.kingLoc, canonicalSymmetry(problem.kingLoc));
+            entry.pieces = canonicalPieces(problem.pieces);
+            entry.locs = Vector<GridLocation>(entry.pieces.size(), GridLocation(0, 0));
+            writer.write(entry);
+        }
+    }
+    const long records = 1 << 21;
+    unsigned char record[kCorpusRecordBytes] = {};
+    for (CorpusIoBackend backend : {CorpusIoBackend::Positional, CorpusIoBackend::Uring}) {
+        auto start = chrono::steady_clock::now();
+        CorpusIoBackend used;
+        {
+            CorpusStreamWriter writer(solutionFile, backend, 1 << 18, 8);
+            used = writer.backend();
+            for (long i = 0; i < records; i++) {
+                record[0] = i;
+                writer.write(record);
+            }
+        }
+        double writeSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        const long durableRecords = records / 8;
+        {
+            CorpusStreamWriter writer(durableFile, backend, 1 << 16, 8, true);
+            for (long i = 0; i < durableRecords; i++) {
+                writer.write(record);
+            }
+        }
+        double durableSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        start = chrono::steady_clock::now();
+        long read = 0;
+        {
+            CorpusStreamReader reader(solutionFile, backend, 1 << 18, 8);
+            for (const unsigned char *next = reader.next(); next != nullptr; next = reader.next()) {
+                read += next[0] == (read & 0xFF);
+            }
+        }
+        double readSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        EXPECT_EQUAL(read, records);
+
+        start = chrono::steady_clock::now();
+        int solved = 0;
+        {
+            CorpusStreamReader reader(problemFile, backend);
+            CorpusStreamWriter writer(solutionFile, backend, 4 << 10, 8, true);
+            for (const unsigned char *next = reader.next(); next != nullptr; next = reader.next()) {
+                DbEntry entry = decodeCorpusRecord(next);
+                EngineRun run = runEngine(findEngine("patterns"), entry.kingLoc, entry.pieces);
+                if (run.verified) {
+                    entry.locs.clear();
+                    for (int i = 0; i < entry.pieces.size(); i++) {
+                        if (i == 0 || entry.pieces[i] != entry.pieces[i - 1]) {
+                            for (GridLocation loc : run.result[entry.pieces[i]]) {
+                                entry.locs.add(loc);
+                            }
+                        }
+                    }
+                    writer.write(entry);
+                    solved++;
+                }
+            }
+        }
+        double solveSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        EXPECT(solved * 10 > problems.size() * 9);
+        double megabytes = double(records) * kCorpusRecordBytes / (1 << 20);
+        cout << backendName(used) << ": write " << megabytes / writeSeconds << " MB/s, durable write "
+             << megabytes / 8 / durableSeconds << " MB/s, read " << megabytes / readSeconds << " MB/s, solve stream "
+             << problems.size() / solveSeconds << " problems/s, " << solved << " solved" << endl;
+    }
+    remove(problemFile.c_str());
+    remove(solutionFile.c_str());
+    remove(durableFile.c_str());
+    clearBoard();
+}
@@ -0,0 +1,139 @@
+/*
+ * This file contains the declarations for streaming corpus I/O: a writer and a reader for corpus files that keep
+ * several buffers in flight through io_uring, falling back to pread and pwrite where io_uring is not available
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "corpusfile.h"
+
+/** How a corpus stream reaches the file
+ */
+enum class CorpusIoBackend {
+    Automatic,  // io_uring if the kernel allows it, otherwise positional
+    Uring,      // io_uring with registered buffers; falls back to positional if it cannot be set up
+    Positional  // blocking pread and pwrite from the calling thread
+};
+
+class UringQueue;
+
+/** Appends records to a new corpus file. Records are gathered into one of several buffers; a full buffer is handed to
+ * the kernel and the writer moves to the next, so filling one buffer overlaps with writing the others. The caller only
+ * waits when every buffer is still being written
+ */
+class CorpusStreamWriter {
+public:
+    /**
+     * Create or truncate a corpus file
+     * @param filename, backend, bytes per buffer, number of buffers, and whether each write must reach the device
+     *        before it completes; raises an error if the file cannot be opened
+     *
+     * This function runs in O(b) for b buffer bytes
+     */
+    CorpusStreamWriter(std::string filename, CorpusIoBackend backend = CorpusIoBackend::Automatic,
+                       size_t bufferBytes = 1 << 20, int buffers = 4, bool durable = false);
+    ~CorpusStreamWriter();
+    CorpusStreamWriter(const CorpusStreamWriter &) = delete;
+    CorpusStreamWriter &operator=(const CorpusStreamWriter &) = delete;
+
+    /**
+     * Append a record
+     * @param record of kCorpusRecordBytes, raising an error if an earlier write failed
+     *
+     * This function runs in O(1) amortised
+     */
+    void write(const unsigned char *record);
+
+    /**
+     * Append an entry's record
+     * @param entry in canonical form
+     *
+     * This function runs in O(n) for n pieces
+     */
+    void write(const DbEntry &entry);
+
+    /**
+     * Write what is buffered, wait for every write and close the file; called by the destructor if needed
+     *
+     * This function runs in O(b) for b buffered bytes
+     */
+    void close();
+
+    CorpusIoBackend backend() const;
+    long records() const;
+
+private:
+    void submit(int buffer);
+    int reclaim();
+    void finish(int buffer, int result);
+
+    int _fd = -1;
+    std::string _filename;
+    CorpusIoBackend _backend;
+    std::unique_ptr<UringQueue> _ring;
+    std::vector<unsigned char> _storage;
+    std::vector<unsigned char *> _buffers;
+    std::vector<int> _free;         // buffers not being written
+    size_t _bufferBytes;
+    int _current = -1;              // buffer being filled
+    size_t _used = 0;
+    uint64_t _offset = 0;           // file offset of the next buffer
+    std::vector<size_t> _pending;   // bytes each in-flight buffer was written with
+    std::vector<uint64_t> _offsets; // file offset each in-flight buffer was written at
+    int _inFlight = 0;
+    long _records = 0;
+};
+
+/** Reads a corpus file front to back. Reads of the next buffers are submitted ahead of the one being consumed, so the
+ * caller finds most buffers already filled
+ */
+class CorpusStreamReader {
+public:
+    /**
+     * Open a corpus file and start reading ahead
+     * @param filename, backend, bytes per buffer and number of buffers, raising an error if the file cannot be opened
+     *        or is not a whole number of records
+     *
+     * This function runs in O(b) for b buffer bytes
+     */
+    CorpusStreamReader(std::string filename, CorpusIoBackend backend = CorpusIoBackend::Automatic,
+                       size_t bufferBytes = 1 << 20, int buffers = 4);
+    ~CorpusStreamReader();
+    CorpusStreamReader(const CorpusStreamReader &) = delete;
+    CorpusStreamReader &operator=(const CorpusStreamReader &) = delete;
+
+    /**
+     * Next record
+     * @return pointer valid until the next call, or nullptr at the end of the file; raises an error if a read fails
+     *
+     * This function runs in O(1) amortised
+     */
+    const unsigned char *next();
+
+    CorpusIoBackend backend() const;
+
+private:
+    void submit(int buffer);
+    void await(int buffer);
+
+    int _fd = -1;
+    std::string _filename;
+    CorpusIoBackend _backend;
+    std::unique_ptr<UringQueue> _ring;
+    std::vector<unsigned char> _storage;
+    std::vector<unsigned char *> _buffers;
+    std::vector<long> _lengths;     // bytes read into each buffer, -1 while its read is in flight and 0 once failed
+    std::vector<uint64_t> _offsets; // file offset each buffer was read from
+    size_t _bufferBytes;
+    uint64_t _size = 0;
+    uint64_t _nextOffset = 0;       // file offset of the next read to submit
+    int _current = 0;               // buffer being consumed, buffers are read and consumed in turn
+    size_t _position = 0;
+    bool _started = false;
+    int _inFlight = 0;
+    bool _failed = false;           // a read failed, so the rest of the file cannot be trusted
+};
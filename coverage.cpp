@@ -0,0 +1,123 @@
+/*
+ * This file contains the implementation of the neighbourhood coverage helpers shared by the engines that search over
+ * which of the squares around the opponent king their pieces attack
+ */
+#include "coverage.h"
+#include "engines.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/* This function takes in a location and the opponent king location and returns the bit of the location in the 3x3
+ * neighbourhood of the king, with bit 4 the king's own square, or -1 outside it.
+ */
+int neighbourhoodBit(GridLocation loc, GridLocation kingLoc) {
+    int dr = loc.row - kingLoc.row;
+    int dc = loc.col - kingLoc.col;
+    if (abs(dr) > 1 || abs(dc) > 1) {
+        return -1;
+    }
+    return (dr + 1) * 3 + dc + 1;
+}
+
+/* This function takes in a set of locations and the opponent king location and returns the neighbourhood bits of the
+ * locations.
+ */
+int coverageMask(const Set<GridLocation> &locs, GridLocation kingLoc) {
+    int mask = 0;
+    for (GridLocation loc : locs) {
+        int bit = neighbourhoodBit(loc, kingLoc);
+        if (bit >= 0) {
+            mask |= 1 << bit;
+        }
+    }
+    return mask;
+}
+
+/* This function takes in a piece and the opponent king location and returns the squares outside the neighbourhood from
+ * which the piece attacks at least one neighbourhood square without giving check, with the squares it attacks. Attacks
+ * are computed once with the king lifted off the board: a line through the king's square is a check, and any other
+ * line is the same with the king on the board.
+ */
+Vector<Candidate> pieceCandidates(char piece, GridLocation kingLoc) {
+    Vector<Candidate> candidates;
+    char king = _board[kingLoc];
+    _board[kingLoc] = 'E';
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            GridLocation loc(row, col);
+            if (neighbourhoodBit(loc, kingLoc) >= 0) {
+                continue;
+            }
+            int mask = coverageMask(pieceAttackingLocs(piece, loc), kingLoc);
+            if (mask != 0 && !(mask & kCentreBit)) {
+                candidates.add({loc, mask});
+            }
+        }
+    }
+    _board[kingLoc] = king;
+    return candidates;
+}
+
+/* This function takes in the opponent king location, all pieces, the placed pieces with their locations and the result
+ * map. It puts the placed pieces on the board and checks them with isStalemate, then places the unused pieces with
+ * placeUselessPieces and checks again, since an unused piece can land on a line a slider needs, and that every piece
+ * found a square. If any check fails the board and result are cleared back to the king alone.
+ */
+bool completePlacement(GridLocation kingLoc, Vector<char> pieces, const Vector<char> &placedPieces,
+                       const Vector<GridLocation> &placedLocs, Map<char, Vector<GridLocation>> &result) {
+    for (int i = 0; i < placedPieces.size(); i++) {
+        result[placedPieces[i]].add(placedLocs[i]);
+        _board[placedLocs[i]] = placedPieces[i];
+    }
+    if (isStalemate(kingLoc, result)) {
+        Set<GridLocation> exclusion;
+        calculateExclusion(exclusion, kingLoc, result);
+        Vector<char> unused = pieces;
+        removeUsedPieces(unused, result);
+        placeUselessPieces(unused, exclusion, kingLoc, result);
+        int placed = 0;
+        for (char piece : result) {
+            placed += result[piece].size();
+        }
+        if (placed == pieces.size() && isStalemate(kingLoc, result)) {
+            return true;
+        }
+    }
+    for (char piece : result) {
+        for (GridLocation loc : result[piece]) {
+            _board[loc] = 'E';
+        }
+    }
+    result.clear();
+    return false;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Neighbourhood masks and candidates") {
+    clearBoard();
+    GridLocation kingLoc = GridLocation(0, 0);
+    _board[kingLoc] = 'K';
+    EXPECT_EQUAL(coverageMask(getAdjacentLocs(kingLoc), kingLoc), (1 << 4) | (1 << 5) | (1 << 7) | (1 << 8));
+    for (const Candidate &candidate : pieceCandidates('R', kingLoc)) {
+        EXPECT(!(candidate.mask & kCentreBit));
+        EXPECT(candidate.loc.row != 0 && candidate.loc.col != 0);
+    }
+    EXPECT_EQUAL(_board[kingLoc], 'K');
+    clearBoard();
+}
+
+PROVIDED_TEST("Completing a placement clears the board when it fails") {
+    clearBoard();
+    GridLocation kingLoc = GridLocation(0, 0);
+    _board[kingLoc] = 'K';
+    Map<char, Vector<GridLocation>> result;
+    EXPECT(!completePlacement(kingLoc, {'K', 'R'}, {'R'}, {GridLocation(1, 7)}, result));
+    EXPECT(result.isEmpty());
+    EXPECT_EQUAL(_board[GridLocation(1, 7)], 'E');
+
+    EXPECT(completePlacement(kingLoc, {'K', 'Q', 'H'}, {'Q'}, {GridLocation(2, 1)}, result));
+    EXPECT(verifyStalemate(kingLoc, {'K', 'Q', 'H'}, result));
+    clearBoard();
+}
@@ -0,0 +1,61 @@
+/*
+ * This file contains the declarations for the neighbourhood coverage helpers shared by the engines that search over
+ * which of the squares around the opponent king their pieces attack
+ */
+#pragma once
+
+#include "map.h"
+#include "set.h"
+#include "vector.h"
+#include "martin.h"
+
+/** Bit of the opponent king's own square in a neighbourhood mask
+ */
+const int kCentreBit = 1 << 4;
+
+/** A square a piece can stand on and the neighbourhood squares it attacks from there
+ */
+struct Candidate {
+    GridLocation loc;
+    int mask;
+};
+
+/**
+ * Bit of a location in the 3x3 neighbourhood of the opponent king, numbered row by row from the top left
+ * @param location and opponent king location
+ * @return bit from 0 to 8, with 4 the king's own square, or -1 outside the neighbourhood
+ *
+ * This function runs in O(1)
+ */
+int neighbourhoodBit(GridLocation loc, GridLocation kingLoc);
+
+/**
+ * Neighbourhood bits of a set of locations
+ * @param locations and opponent king location
+ * @return mask of the locations inside the neighbourhood
+ *
+ * This function runs in O(n) for n locations
+ */
+int coverageMask(const Set<GridLocation> &locs, GridLocation kingLoc);
+
+/**
+ * Squares outside the neighbourhood from which a piece attacks at least one neighbourhood square without giving check,
+ * computed with the king lifted off the board and no other pieces in the way
+ * @param piece and opponent king location
+ * @return candidates in row-major order
+ *
+ * This function runs in O(64 a) for a the cost of pieceAttackingLocs
+ */
+Vector<Candidate> pieceCandidates(char piece, GridLocation kingLoc);
+
+/**
+ * Complete a placement whose coverage masks reach every square around the king: the placed pieces are put on the
+ * board and checked with isStalemate, then the other pieces are placed with placeUselessPieces and checked again,
+ * along with every piece having found a square
+ * @param opponent king location, all pieces, the pieces placed and their locations, and map to fill with the placement
+ * @return whether both checks passed; if not, the board and result are cleared back to the king alone
+ *
+ * This function runs in O(n) calls to pieceAttackingLocs for n pieces
+ */
+bool completePlacement(GridLocation kingLoc, Vector<char> pieces, const Vector<char> &placedPieces,
+                       const Vector<GridLocation> &placedLocs, Map<char, Vector<GridLocation>> &result);
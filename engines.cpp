@@ -0,0 +1,252 @@
+/*
+ * This file contains the implementation of the engine registry, seeded problem corpora and the independent
+ * stalemate checker
+ */
+#include <chrono>
+#include "engines.h"
+#include "error.h"
+#include "mitm.h"
+#include "patterns.h"
+#include "pieces.h"
+#include "profiler.h"
+#include "random.h"
+#include "sat.h"
+#include "slowlog.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/* This function returns every registered engine. The first engine is the default and the baseline that the
+ * harness compares the others against.
+ */
+Vector<Engine> registeredEngines() {
+    return {
+        {"greedy", calculateStalemate},
+        {"sorted-greedy", calculateStalemateAlternative},
+        {"meet-in-middle", calculateStalemateMeetInMiddle},
+        {"sat", calculateStalemateSat},
+        {"patterns", calculateStalematePatterns},
+    };
+}
+
+/* This function takes in an engine name and returns the registered engine with that name.
+ */
+Engine findEngine(string name) {
+    for (const Engine &engine : registeredEngines()) {
+        if (engine.name == name) {
+            return engine;
+        }
+    }
+    error("No engine named " + name);
+}
+
+/* This function takes in a row and column and returns whether it is on the 8x8 board.
+ */
+static bool onBoard(int row, int col) {
+    return row >= 0 && row < 8 && col >= 0 && col < 8;
+}
+
+/* This function takes in a local board, attacked squares, a piece and its row and column. It marks every square
+ * the piece attacks following the rules of chess: jumps attack their square whatever stands on it and rays stop at the
+ * first occupied square, which is attacked (defended) as well. The moves are walked from the piece's descriptor rather
+ * than read from the attack tables. It returns false for a character that is not a piece.
+ */
+static bool markAttacks(char board[8][8], bool attacked[8][8], char piece, int row, int col) {
+    static const int steps[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+    const PieceDescriptor *descriptor = findPiece(piece);
+    if (descriptor == nullptr) {
+        return false;
+    }
+    for (pair<int, int> leap : descriptor->leaps) {
+        if (onBoard(row + leap.first, col + leap.second)) {
+            attacked[row + leap.first][col + leap.second] = true;
+        }
+    }
+    int first = descriptor->ridesStraight ? 0 : 4;
+    int last = descriptor->ridesDiagonal ? 8 : 4;
+    for (int i = first; i < last; i++) {
+        int r = row + steps[i][0];
+        int c = col + steps[i][1];
+        while (onBoard(r, c)) {
+            attacked[r][c] = true;
+            if (board[r][c] != 0) {
+                break;
+            }
+            r += steps[i][0];
+            c += steps[i][1];
+        }
+    }
+    return true;
+}
+
+/* This function takes in the opponent king location, the pieces that had to be placed and a placement. It rebuilds
+ * the position on a local board and checks that the placement uses exactly the given pieces on distinct squares,
+ * the white king is not next to the opponent king, the opponent king is not in check and every square the
+ * opponent king could move to is attacked. It shares no code with isStalemate so it can judge every engine.
+ */
+bool verifyStalemate(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &placement) {
+    char board[8][8] = {};
+    bool attacked[8][8] = {};
+    if (!onBoard(kingLoc.row, kingLoc.col)) {
+        return false;
+    }
+    board[kingLoc.row][kingLoc.col] = 'k';
+
+    Map<char, int> expected;
+    for (char piece : pieces) {
+        expected[piece]++;
+    }
+    int placed = 0;
+    for (char piece : placement) {
+        if (placement[piece].size() != expected[piece]) {
+            return false;
+        }
+        for (GridLocation loc : placement[piece]) {
+            if (!onBoard(loc.row, loc.col) || board[loc.row][loc.col] != 0) {
+                return false;
+            }
+            if (piece == 'K' && abs(loc.row - kingLoc.row) <= 1 && abs(loc.col - kingLoc.col) <= 1) {
+                return false;
+            }
+            board[loc.row][loc.col] = piece;
+            placed++;
+        }
+    }
+    if (placed != pieces.size()) {
+        return false;
+    }
+
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (board[row][col] != 0 && board[row][col] != 'k'
+                    && !markAttacks(board, attacked, board[row][col], row, col)) {
+                return false;
+            }
+        }
+    }
+    if (attacked[kingLoc.row][kingLoc.col]) {
+        return false;
+    }
+    for (int row = kingLoc.row - 1; row <= kingLoc.row + 1; row++) {
+        for (int col = kingLoc.col - 1; col <= kingLoc.col + 1; col++) {
+            if (onBoard(row, col) && !attacked[row][col] && board[row][col] != 'k') {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+/* This function takes in a seed, number of problems and maximum number of pieces and returns a corpus built with
+ * initializeBoard and generatePieces, so the same seed always gives the same problems.
+ */
+Vector<Problem> generateCorpus(int seed, int count, int maxPieces) {
+    setRandomSeed(seed);
+    Vector<Problem> corpus;
+    for (int i = 0; i < count; i++) {
+        Problem problem;
+        problem.kingLoc = initializeBoard();
+        problem.pieces = generatePieces(maxPieces);
+        corpus.add(problem);
+    }
+    clearBoard();
+    return corpus;
+}
+
+/* This guard resets the current thread's search control when it goes out of scope, so a node budget or a
+ * cancellation flag owned by the caller of runEngine never outlives the run.
+ */
+struct SearchReset {
+    ~SearchReset() {
+        resetSearch();
+    }
+};
+
+/* This function takes in an engine, opponent king location, pieces, number of repetitions, an optional cancellation
+ * flag and a node budget. Each repetition starts from a board holding only the opponent king, as initializeBoard leaves
+ * it. It keeps the fastest time, treats an error raised by the engine as a failed run and verifies the result with
+ * verifyStalemate. A run slower than the slow-solve log's threshold is captured there. The run is a profiler phase
+ * named after the engine, with the verification a phase of its own inside it. The thread's search control is reset when
+ * it returns.
+ */
+EngineRun runEngine(const Engine &engine, GridLocation kingLoc, Vector<char> pieces, int repetitions,
+                    atomic<bool> *cancel, long nodeBudget) {
+    ProfilePhase phase(profileName(engine.name));
+    SearchReset searchReset;
+    EngineRun run;
+    for (int i = 0; i < repetitions && !run.threw; i++) {
+        clearBoard();
+        _board[kingLoc] = 'K';
+        resetSearch(nodeBudget, cancel);
+        auto start = chrono::steady_clock::now();
+        try {
+            run.result = engine.solve(kingLoc, pieces);
+        } catch (ErrorException &) {
+            run.threw = true;
+            run.result.clear();
+        }
+        double micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        if (i == 0 || micros < run.micros) {
+            run.micros = micros;
+        }
+        run.nodes = _search.nodes;
+        run.stopped = _search.stopped;
+    }
+    {
+        ProfilePhase verifying("verify");
+        run.verified = !run.threw && verifyStalemate(kingLoc, pieces, run.result);
+    }
+    captureSlowSolve(engine.name, kingLoc, pieces, nodeBudget, repetitions, run);
+    return run;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("verifyStalemate") {
+    Map<char, Vector<GridLocation>> placement = {{'Q', {GridLocation(3, 0)}}, {'K', {GridLocation(1, 3)}},
+                                                 {'B', {GridLocation(3, 4)}}};
+    EXPECT(verifyStalemate(GridLocation(1, 1), {'K', 'Q', 'B'}, placement));
+
+    // wrong multiset
+    EXPECT(!verifyStalemate(GridLocation(1, 1), {'K', 'Q', 'B', 'H'}, placement));
+    EXPECT(!verifyStalemate(GridLocation(1, 1), {'K', 'Q', 'R'}, placement));
+
+    // queen on the king's row gives check
+    placement = {{'Q', {GridLocation(1, 5)}}, {'K', {GridLocation(3, 1)}}};
+    EXPECT(!verifyStalemate(GridLocation(1, 1), {'K', 'Q'}, placement));
+
+    // two pieces on one square
+    placement = {{'Q', {GridLocation(3, 0), GridLocation(3, 0)}}};
+    EXPECT(!verifyStalemate(GridLocation(1, 1), {'Q', 'Q'}, placement));
+}
+
+PROVIDED_TEST("generateCorpus is reproducible") {
+    Vector<Problem> first = generateCorpus(106, 20, 10);
+    Vector<Problem> second = generateCorpus(106, 20, 10);
+    EXPECT_EQUAL(first.size(), 20);
+    for (int i = 0; i < first.size(); i++) {
+        EXPECT_EQUAL(first[i].kingLoc, second[i].kingLoc);
+        EXPECT(first[i].pieces.equals(second[i].pieces));
+    }
+}
+
+PROVIDED_TEST("runEngine stops when cancelled") {
+    atomic<bool> cancel(true);
+    EngineRun run = runEngine(findEngine("greedy"), GridLocation(2, 1), {'K', 'Q', 'Q', 'R', 'R'}, 1, &cancel);
+    EXPECT(run.stopped);
+    EXPECT(!run.verified);
+    EXPECT_EQUAL(run.nodes, 1);
+    EXPECT(!_search.stopped);
+    EXPECT(_search.cancel == nullptr);
+    EXPECT_EQUAL(_search.nodeBudget, -1);
+    clearBoard();
+}
+
+PROVIDED_TEST("runEngine agrees with isStalemate on provided problems") {
+    for (const Engine &engine : registeredEngines()) {
+        EngineRun run = runEngine(engine, GridLocation(2, 1), {'K', 'Q', 'Q', 'Q', 'Q', 'Q', 'R', 'R', 'R', 'R', 'R'});
+        EXPECT(run.verified);
+        EXPECT(isStalemate(GridLocation(2, 1), run.result));
+    }
+    clearBoard();
+}
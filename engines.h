@@ -0,0 +1,86 @@
+/*
+ * This file contains the declarations for the registry of stalemate engines, seeded problem corpora and an
+ * independent checker used to verify engine results
+ */
+#pragma once
+
+#include <string>
+#include "grid.h"
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/** Signature shared by every engine: opponent king location and pieces to map of pieces to their locations
+ */
+typedef Map<char, Vector<GridLocation>> (*StalemateEngine)(GridLocation kingLoc, Vector<char> pieces);
+
+/** A named stalemate engine
+ */
+struct Engine {
+    std::string name;
+    StalemateEngine solve;
+};
+
+/** A stalemate problem: opponent king location and set of pieces with the king at the front
+ */
+struct Problem {
+    GridLocation kingLoc;
+    Vector<char> pieces;
+};
+
+/** Result of running one engine on one problem
+ */
+struct EngineRun {
+    Map<char, Vector<GridLocation>> result;
+    bool verified = false;  // result passed verifyStalemate
+    bool threw = false;     // engine raised an error instead of returning
+    double micros = 0;      // wall time of the fastest repetition
+    long nodes = 0;         // search nodes visited by the last repetition
+    bool stopped = false;   // search was cancelled or ran out of budget
+};
+
+/**
+ * Get every registered engine, with the default engine first
+ * @return vector of engines
+ *
+ * This function runs in O(1)
+ */
+Vector<Engine> registeredEngines();
+
+/**
+ * Look up a registered engine by name
+ * @param engine name
+ * @return engine, raising an error if there is none with that name
+ *
+ * This function runs in O(n) for n registered engines
+ */
+Engine findEngine(std::string name);
+
+/**
+ * Checks a placement against the rules without using the global board or pieceAttackingLocs
+ * @param opponent king location, pieces that had to be placed, and map of pieces to their locations
+ * @return true if every piece is placed on its own square and the opponent king is stalemated
+ *
+ * This function runs in O(n) for n pieces
+ */
+bool verifyStalemate(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &placement);
+
+/**
+ * Generate a reproducible corpus of problems with initializeBoard and generatePieces
+ * @param random seed, number of problems, and maximum number of pieces passed to generatePieces
+ * @return vector of problems
+ *
+ * This function runs in O(nk) for n problems of k pieces
+ */
+Vector<Problem> generateCorpus(int seed, int count, int maxPieces);
+
+/**
+ * Run an engine on a problem starting from a board holding only the opponent king
+ * @param engine, opponent king location, pieces, number of timed repetitions, a flag that cancels the search, and
+ *        the number of search nodes the engine may visit (-1 for no limit)
+ * @return result of the run, timed as the fastest repetition
+ *
+ * This function runs in the time of the engine times the number of repetitions
+ */
+EngineRun runEngine(const Engine &engine, GridLocation kingLoc, Vector<char> pieces, int repetitions = 1,
+                    std::atomic<bool> *cancel = nullptr, long nodeBudget = -1);
@@ -0,0 +1,407 @@
+/*
+ * This file contains the implementation of the breadth-first frontier engine, which places the pieces one level at a
+ * time over a frontier of partial placements stored as parallel arrays
+ */
+#include <cstdint>
+#include <vector>
+#include "frontier.h"
+#include "coverage.h"
+#include "engines.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kMaxFrontier = 1 << 16;    // states a level may hold before the search turns depth first
+static const int kTableSize = 1 << 18;      // slots of the table merging a level's states, a power of two
+
+/** One level of the frontier, a field per array so the expansion loop reads contiguous memory. Every state of a level
+ * has decided the same pieces, so the pieces remaining are the level's suffix of the sorted pieces and are not stored
+ */
+struct Frontier {
+    vector<uint64_t> occupied;      // squares holding a placed piece
+    vector<vector<uint64_t>> typed; // the same squares split by piece type, one array per distinct piece of the
+                                    // problem in sorted order
+    vector<uint16_t> coverage;      // neighbourhood squares the placed pieces attack with nothing in the way
+    vector<int> parent;             // index of the state in the previous level
+    vector<int8_t> square;          // square the level's piece went to, or -1 if it was left out
+
+    int size() const {
+        return int(occupied.size());
+    }
+};
+
+/** A piece type's candidate squares as parallel arrays
+ */
+struct CandidateArrays {
+    vector<uint64_t> bits;
+    vector<uint16_t> masks;
+    vector<int8_t> squares;
+};
+
+/** State of the depth-first search that takes over from a level that grew too large
+ */
+struct DepthFirst {
+    GridLocation kingLoc;
+    Vector<char> pieces;
+    Vector<char> sorted;
+    vector<CandidateArrays> candidates;     // candidates of each sorted piece
+    vector<int> reach;                      // neighbourhood squares the pieces from each level on can attack
+    int full;
+    int start;                              // level the depth-first search started from
+    Vector<char> placedPieces;
+    Vector<GridLocation> placedLocs;
+    Map<char, Vector<GridLocation>> result;
+};
+
+/* This function takes in a piece and the opponent king location and returns the piece's candidates as arrays.
+ */
+static CandidateArrays candidateArrays(char piece, GridLocation kingLoc) {
+    CandidateArrays arrays;
+    for (const Candidate &candidate : pieceCandidates(piece, kingLoc)) {
+        int square = candidate.loc.row * 8 + candidate.loc.col;
+        arrays.bits.push_back(uint64_t(1) << square);
+        arrays.masks.push_back(candidate.mask);
+        arrays.squares.push_back(square);
+    }
+    return arrays;
+}
+
+/* This function takes in one state's occupied squares and coverage and a piece type's candidates, writes the coverage
+ * each candidate would give and whether it is worth keeping: free, and attacking a square the state does not yet
+ * cover. The loop has no branches so the compiler can vectorise it across the candidates. It returns the number kept.
+ */
+static int expandCandidates(uint64_t occupied, uint16_t coverage, const CandidateArrays &candidates,
+                            uint16_t *childCoverage, uint8_t *keep) {
+    int count = int(candidates.bits.size());
+    const uint64_t *bits = candidates.bits.data();
+    const uint16_t *masks = candidates.masks.data();
+    int kept = 0;
+    for (int i = 0; i < count; i++) {
+        uint16_t covered = coverage | masks[i];
+        uint8_t fresh = ((occupied & bits[i]) == 0) & (covered != coverage);
+        childCoverage[i] = covered;
+        keep[i] = fresh;
+        kept += fresh;
+    }
+    return kept;
+}
+
+/* This function takes in the next level, its table of slots, the current level, a state in it, the type index of the
+ * level's piece, the square the piece goes to or -1 and the child's coverage. It adds the child to the next level
+ * unless a state with the same squares for each piece type is already there, which happens when equal pieces are
+ * placed in another order or a different one of them is left out, and returns whether it was added. The next level
+ * has as many type arrays as the current one.
+ */
+static bool addState(Frontier &next, vector<int> &slots, const Frontier &current, int parent, int type, int square,
+                     uint16_t coverage) {
+    int types = int(current.typed.size());
+    uint64_t added = square >= 0 ? uint64_t(1) << square : 0;
+    auto typed = [&](int t) {
+        return current.typed[t][parent] | (t == type ? added : 0);
+    };
+    uint64_t hash = 0;
+    for (int t = 0; t < types; t++) {
+        hash = (hash ^ typed(t)) * 0x9E3779B97F4A7C15ULL;
+    }
+    size_t mask = slots.size() - 1;
+    for (size_t slot = (hash >> 32) & mask; ; slot = (slot + 1) & mask) {
+        int other = slots[slot];
+        if (other < 0) {
+            slots[slot] = next.size();
+            break;
+        }
+        bool same = true;
+        for (int t = 0; t < types && same; t++) {
+            same = next.typed[t][other] == typed(t);
+        }
+        if (same) {
+            return false;
+        }
+    }
+    uint64_t occupied = 0;
+    for (int t = 0; t < types; t++) {
+        next.typed[t].push_back(typed(t));
+        occupied |= typed(t);
+    }
+    next.occupied.push_back(occupied);
+    next.coverage.push_back(coverage);
+    next.parent.push_back(parent);
+    next.square.push_back(square);
+    return true;
+}
+
+/* This function takes in the levels, a level and a state in it and the sorted pieces, and adds the pieces the state
+ * placed and their locations by walking back through the parents.
+ */
+static void statePlacement(const vector<Frontier> &levels, int level, int index, const Vector<char> &sorted,
+                           Vector<char> &placedPieces, Vector<GridLocation> &placedLocs) {
+    for (; level > 0; level--) {
+        int square = levels[level].square[index];
+        if (square >= 0) {
+            placedPieces.add(sorted[level - 1]);
+            placedLocs.add(GridLocation(square / 8, square % 8));
+        }
+        index = levels[level].parent[index];
+    }
+}
+
+/* This function takes in the depth-first state, a level, the occupied squares and coverage so far, and the candidate
+ * index of the last piece placed by this search if it had the level's type, or whether one of that type was left out.
+ * Equal pieces take increasing candidates and once one is left out the rest of that type are too, so each set of
+ * squares is tried once. Placing is tried before leaving out, and a branch is cut when the remaining pieces cannot
+ * attack the squares still uncovered. It counts a search node per call and returns whether a placement was completed.
+ */
+static bool searchDepthFirst(DepthFirst &search, int level, uint64_t occupied, int coverage, int lastIndex,
+                             bool closed) {
+    if (searchShouldStop() || level == search.sorted.size()) {
+        return false;
+    }
+    bool sameType = level > search.start && search.sorted[level] == search.sorted[level - 1];
+    const CandidateArrays &candidates = search.candidates[level];
+    if (!(sameType && closed)) {
+        for (int i = sameType ? lastIndex + 1 : 0; i < int(candidates.bits.size()); i++) {
+            int covered = coverage | candidates.masks[i];
+            if ((occupied & candidates.bits[i]) || covered == coverage
+                    || (covered | search.reach[level + 1]) != search.full) {
+                continue;
+            }
+            int square = candidates.squares[i];
+            search.placedPieces.add(search.sorted[level]);
+            search.placedLocs.add(GridLocation(square / 8, square % 8));
+            if (covered == search.full) {
+                if (completePlacement(search.kingLoc, search.pieces, search.placedPieces, search.placedLocs,
+                                      search.result)) {
+                    return true;
+                }
+            } else if (searchDepthFirst(search, level + 1, occupied | candidates.bits[i], covered, i, false)) {
+                return true;
+            }
+            search.placedPieces.removeBack();
+            search.placedLocs.removeBack();
+            if (_search.stopped) {
+                return false;
+            }
+        }
+    }
+    return (coverage | search.reach[level + 1]) == search.full
+           && searchDepthFirst(search, level + 1, occupied, coverage, sameType ? lastIndex : -1, true);
+}
+
+/* This function takes in the opponent king location, pieces, the most states a level may hold and the result map, and
+ * runs the search: levels are expanded breadth first, counting a search node per state expanded, and a child whose
+ * coverage reaches the whole neighbourhood is completed with completePlacement on the spot rather than stored. If the
+ * next level passes maxFrontier it is dropped and every state of the current level is searched depth first instead.
+ * It returns whether a placement was found, and leaves result empty if the search was stopped.
+ */
+static bool searchFrontier(GridLocation kingLoc, Vector<char> pieces, int maxFrontier,
+                           Map<char, Vector<GridLocation>> &result) {
+    DepthFirst search;
+    search.kingLoc = kingLoc;
+    search.pieces = pieces;
+    search.sorted = pieces;
+    search.sorted.sort();
+    search.full = coverageMask(getAdjacentLocs(kingLoc), kingLoc) & ~kCentreBit;
+    int n = search.sorted.size();
+    Map<char, CandidateArrays> byType;
+    vector<int> levelTypes;             // index of each level's piece among the problem's distinct pieces
+    for (char piece : search.sorted) {
+        if (!byType.containsKey(piece)) {
+            byType[piece] = candidateArrays(piece, kingLoc);
+        }
+        search.candidates.push_back(byType[piece]);
+        levelTypes.push_back(byType.size() - 1);
+    }
+    search.reach.assign(n + 1, 0);
+    for (int level = n - 1; level >= 0; level--) {
+        search.reach[level] = search.reach[level + 1];
+        for (uint16_t mask : search.candidates[level].masks) {
+            search.reach[level] |= mask;
+        }
+    }
+    if ((search.reach[0] & search.full) != search.full) {
+        return false;
+    }
+
+    vector<Frontier> levels(1);
+    levels[0].typed.assign(byType.size(), vector<uint64_t>(1, 0));
+    levels[0].occupied.push_back(0);
+    levels[0].coverage.push_back(0);
+    levels[0].parent.push_back(-1);
+    levels[0].square.push_back(-1);
+    vector<int> slots(kTableSize);
+    uint16_t childCoverage[64];
+    uint8_t keep[64];
+    bool depthFirst = false;
+    for (int level = 0; level < n && !depthFirst; level++) {
+        Frontier next;
+        next.typed.resize(byType.size());
+        fill(slots.begin(), slots.end(), -1);
+        int type = levelTypes[level];
+        const CandidateArrays &candidates = search.candidates[level];
+        const Frontier &current = levels[level];
+        for (int state = 0; state < current.size(); state++) {
+            if (searchShouldStop()) {
+                return false;
+            }
+            uint16_t coverage = current.coverage[state];
+            if ((coverage | search.reach[level + 1]) == search.full) {
+                addState(next, slots, current, state, type, -1, coverage);
+            }
+            if (expandCandidates(current.occupied[state], coverage, candidates, childCoverage, keep) == 0) {
+                continue;
+            }
+            for (int i = 0; i < int(candidates.bits.size()); i++) {
+                if (!keep[i]) {
+                    continue;
+                }
+                if (childCoverage[i] == search.full) {
+                    Vector<char> placedPieces = {search.sorted[level]};
+                    Vector<GridLocation> placedLocs = {GridLocation(candidates.squares[i] / 8,
+                                                                    candidates.squares[i] % 8)};
+                    statePlacement(levels, level, state, search.sorted, placedPieces, placedLocs);
+                    if (completePlacement(kingLoc, pieces, placedPieces, placedLocs, result)) {
+                        return true;
+                    }
+                } else if ((childCoverage[i] | search.reach[level + 1]) == search.full) {
+                    addState(next, slots, current, state, type, candidates.squares[i], childCoverage[i]);
+                }
+            }
+            if (next.size() > maxFrontier) {
+                depthFirst = true;
+                break;
+            }
+        }
+        if (!depthFirst) {
+            levels.push_back(move(next));
+        }
+    }
+    if (!depthFirst) {
+        return false;
+    }
+
+    int level = int(levels.size()) - 1;
+    search.start = level;
+    const Frontier &current = levels[level];
+    for (int state = 0; state < current.size(); state++) {
+        search.placedPieces.clear();
+        search.placedLocs.clear();
+        statePlacement(levels, level, state, search.sorted, search.placedPieces, search.placedLocs);
+        if (searchDepthFirst(search, level, current.occupied[state], current.coverage[state], -1, false)) {
+            result = search.result;
+            return true;
+        }
+        if (_search.stopped) {
+            return false;
+        }
+    }
+    return false;
+}
+
+/* This function takes in the opponent king location and pieces and returns a map of pieces to locations, found by
+ * searchFrontier with kMaxFrontier states per level, or the pieces placed by placeUselessPieces if there is none.
+ * Since searchFrontier only tries squares that add coverage, finding none does not prove the problem unsolvable.
+ */
+Map<char, Vector<GridLocation>> calculateStalemateFrontier(GridLocation kingLoc, Vector<char> pieces) {
+    Map<char, Vector<GridLocation>> result;
+    if (!searchFrontier(kingLoc, pieces, kMaxFrontier, result) && !_search.stopped) {
+        placeUselessPieces(pieces, getAdjacentLocs(kingLoc), kingLoc, result);
+    }
+    return result;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+// not registered, since the search is not exact, so the tests run it as an engine of their own
+static const Engine kFrontier = {"frontier", calculateStalemateFrontier};
+
+PROVIDED_TEST("Frontier on the large-piece problems") {
+    GridLocation kingLoc = GridLocation(2, 1);
+    for (Vector<char> pieces : Vector<Vector<char>>({{'K', 'H', 'B', 'Q', 'R', 'Q', 'Q', 'Q', 'H', 'H', 'H'},
+                                                     {'K', 'R', 'Q', 'Q', 'Q', 'Q', 'B', 'H', 'H', 'H', 'H'},
+                                                     {'K', 'Q', 'Q', 'Q', 'Q', 'Q', 'R', 'R', 'R', 'R', 'R'}})) {
+        EngineRun run = runEngine(kFrontier, kingLoc, pieces);
+        EXPECT(run.verified);
+        EXPECT(isStalemate(kingLoc, run.result));
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Frontier with fairy pieces") {
+    EngineRun run = runEngine(kFrontier, GridLocation(0, 0), {'K', 'C', 'C'});
+    EXPECT(run.verified);
+    for (const Problem &problem : generateCorpus(970, 20, 8)) {
+        Vector<char> pieces = problem.pieces;
+        for (int i = 1; i < pieces.size(); i += 2) {
+            pieces[i] = string("ACM")[i % 3];
+        }
+        run = runEngine(kFrontier, problem.kingLoc, pieces);
+        EXPECT(!run.threw);
+    }
+    EXPECT_ERROR(calculateStalemateFrontier(GridLocation(0, 0), {'K', 'X'}));
+    clearBoard();
+}
+
+PROVIDED_TEST("Frontier merges equal pieces placed in another order") {
+    Frontier current;
+    int queen = 0;
+    int rook = 1;
+    current.typed.resize(2);
+    for (int square : {10, 20}) {
+        for (int t = 0; t < 2; t++) {
+            current.typed[t].push_back(t == rook ? uint64_t(1) << square : 0);
+        }
+        current.occupied.push_back(uint64_t(1) << square);
+        current.coverage.push_back(0);
+        current.parent.push_back(0);
+        current.square.push_back(square);
+    }
+    Frontier next;
+    next.typed.resize(2);
+    vector<int> slots(64, -1);
+    EXPECT(addState(next, slots, current, 0, rook, 20, 3));
+    EXPECT(!addState(next, slots, current, 1, rook, 10, 3));
+    EXPECT(addState(next, slots, current, 1, queen, 10, 3));
+    EXPECT(addState(next, slots, current, 0, rook, -1, 0));
+    EXPECT(!addState(next, slots, current, 0, rook, -1, 0));
+    EXPECT_EQUAL(next.size(), 3);
+    EXPECT_EQUAL(next.occupied[0], (uint64_t(1) << 10) | (uint64_t(1) << 20));
+}
+
+PROVIDED_TEST("Frontier solves the same problems when it turns depth first") {
+    Vector<Problem> problems = generateCorpus(870, 40, 8);
+    for (const Problem &problem : problems) {
+        bool solved[2];
+        int caps[2] = {kMaxFrontier, 8};
+        for (int i = 0; i < 2; i++) {
+            clearBoard();
+            _board[problem.kingLoc] = 'K';
+            resetSearch();
+            Map<char, Vector<GridLocation>> result;
+            solved[i] = searchFrontier(problem.kingLoc, problem.pieces, caps[i], result);
+            if (solved[i]) {
+                EXPECT(verifyStalemate(problem.kingLoc, problem.pieces, result));
+            }
+        }
+        EXPECT_EQUAL(solved[0], solved[1]);
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Frontier against calculateStalemateAlternative on large inputs") {
+    Vector<Problem> problems = generateCorpus(840, 30, 10);
+    Vector<Engine> engines = {findEngine("sorted-greedy"), findEngine("meet-in-middle"), kFrontier};
+    for (const Engine &engine : engines) {
+        int solved = 0;
+        double micros = 0;
+        long nodes = 0;
+        for (const Problem &problem : problems) {
+            EngineRun run = runEngine(engine, problem.kingLoc, problem.pieces, 1, nullptr, 100000);
+            solved += run.verified;
+            micros += run.micros;
+            nodes += run.nodes;
+        }
+        cout << engine.name << ": solved " << solved << "/" << problems.size() << ", " << micros / 1000 << " ms, "
+             << nodes << " nodes" << endl;
+    }
+    clearBoard();
+}
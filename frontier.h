@@ -0,0 +1,26 @@
+/*
+ * This file contains the declarations for the breadth-first frontier engine, which places the pieces one level at a
+ * time over a frontier of partial placements stored as parallel arrays
+ */
+#pragma once
+
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/**
+ * Calculates a stalemate position breadth first: level i decides the i-th of the sorted pieces, leaving it out or
+ * putting it on a free square that attacks a new neighbourhood square, and placements reaching the same squares with
+ * the same piece types are merged. Placements covering the whole neighbourhood are checked with isStalemate. If a
+ * level grows past a fixed number of states the rest of the search continues depth first from the last full level.
+ * This is a heuristic, not an exact engine: a piece is only placed where it attacks a new neighbourhood square and the
+ * other pieces are left to placeUselessPieces, so a stalemate that needs a piece placed for another reason, such as
+ * blocking a ray or defending a piece next to the king, is missed and the pieces are returned unsolved. For that
+ * reason it is not in registeredEngines, so the harness, router and database builders never pick it
+ * @param opponent king location and random set of pieces
+ * @return map of pieces to their locations to achieve a stalemate
+ *
+ * This function runs in O(k^n) for k candidate squares per piece and n pieces in the worst case, holding at most a
+ * fixed number of states per level
+ */
+Map<char, Vector<GridLocation>> calculateStalemateFrontier(GridLocation kingLoc, Vector<char> pieces);
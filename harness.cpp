@@ -0,0 +1,166 @@
+/*
+ * This file contains the implementation of the A/B harness that runs every registered engine on the same seeded
+ * corpus and compares their speed and solvability
+ */
+#include <cmath>
+#include <iomanip>
+#include "harness.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/* This function takes in a corpus seed, number of problems, maximum number of pieces, number of repetitions and the
+ * engines to compare. It runs every engine on every problem, records problems that some engines solved and others
+ * did not, and counts how often each engine beat each other engine. An engine beats another on a problem when its
+ * result is verified and the other's is not, or both are verified and it was faster.
+ */
+HarnessReport runHarness(int seed, int numProblems, int maxPieces, int repetitions, Vector<Engine> engines) {
+    HarnessReport report;
+    report.engines = engines;
+    report.problems = generateCorpus(seed, numProblems, maxPieces);
+    report.runs = Grid<EngineRun>(numProblems, engines.size());
+    report.wins = Grid<int>(engines.size(), engines.size(), 0);
+
+    for (int p = 0; p < numProblems; p++) {
+        int solved = 0;
+        for (int e = 0; e < engines.size(); e++) {
+            report.runs[p][e] = runEngine(engines[e], report.problems[p].kingLoc, report.problems[p].pieces,
+                                          repetitions);
+            solved += report.runs[p][e].verified;
+        }
+        if (solved != 0 && solved != engines.size()) {
+            report.disagreements.add(p);
+        }
+        for (int i = 0; i < engines.size(); i++) {
+            for (int j = 0; j < engines.size(); j++) {
+                const EngineRun &a = report.runs[p][i];
+                const EngineRun &b = report.runs[p][j];
+                if (a.verified && (!b.verified || a.micros < b.micros)) {
+                    report.wins[i][j]++;
+                }
+            }
+        }
+    }
+    clearBoard();
+    return report;
+}
+
+/* This function takes in a report, an engine index and a baseline index and returns the baseline time divided by the
+ * engine time for every problem both engines solved, so values above 1 mean the engine was faster.
+ */
+Vector<double> speedups(const HarnessReport &report, int engine, int baseline) {
+    Vector<double> result;
+    for (int p = 0; p < report.problems.size(); p++) {
+        const EngineRun &run = report.runs.get(p, engine);
+        const EngineRun &base = report.runs.get(p, baseline);
+        if (run.verified && base.verified && run.micros > 0) {
+            result.add(base.micros / run.micros);
+        }
+    }
+    return result;
+}
+
+/* This function takes in a Vector of speedups and returns its minimum, 10th percentile, median, 90th percentile,
+ * maximum and geometric mean using nearest-rank percentiles.
+ */
+SpeedupSummary summarizeSpeedups(Vector<double> speedups) {
+    SpeedupSummary summary;
+    summary.samples = speedups.size();
+    if (speedups.isEmpty()) {
+        return summary;
+    }
+    speedups.sort();
+    int n = speedups.size();
+    double logSum = 0;
+    for (double s : speedups) {
+        logSum += log(s);
+    }
+    summary.min = speedups[0];
+    summary.p10 = speedups[(n - 1) / 10];
+    summary.median = speedups[(n - 1) / 2];
+    summary.p90 = speedups[(n - 1) * 9 / 10];
+    summary.max = speedups[n - 1];
+    summary.geometricMean = exp(logSum / n);
+    return summary;
+}
+
+/* This function takes in an output stream, a report and a baseline engine index and prints a solve-rate line per
+ * engine, the distribution of its per-input speedups over the baseline, the problems the engines disagree on and the
+ * win/loss matrix.
+ */
+void printHarnessReport(ostream &out, const HarnessReport &report, int baseline) {
+    int numEngines = report.engines.size();
+    ios::fmtflags flags = out.flags();
+    streamsize precision = out.precision();
+    out << fixed << setprecision(2);
+    out << "Engines on " << report.problems.size() << " problems, baseline " << report.engines[baseline].name << endl;
+    for (int e = 0; e < numEngines; e++) {
+        int verified = 0;
+        int threw = 0;
+        double total = 0;
+        for (int p = 0; p < report.problems.size(); p++) {
+            verified += report.runs.get(p, e).verified;
+            threw += report.runs.get(p, e).threw;
+            total += report.runs.get(p, e).micros;
+        }
+        SpeedupSummary s = summarizeSpeedups(speedups(report, e, baseline));
+        out << setw(16) << report.engines[e].name << "  solved " << verified << "/" << report.problems.size()
+            << "  errors " << threw << "  total " << total / 1000 << " ms"
+            << "  speedup min " << s.min << " p10 " << s.p10 << " median " << s.median << " p90 " << s.p90
+            << " max " << s.max << " geomean " << s.geometricMean << " (" << s.samples << " inputs)" << endl;
+    }
+
+    out << "Disagreements in solvability: " << report.disagreements.size() << endl;
+    for (int p : report.disagreements) {
+        out << "  problem " << p << " king " << report.problems[p].kingLoc << " pieces " << report.problems[p].pieces
+            << " solved by";
+        for (int e = 0; e < numEngines; e++) {
+            if (report.runs.get(p, e).verified) {
+                out << " " << report.engines[e].name;
+            }
+        }
+        out << endl;
+    }
+
+    out << "Win/loss matrix (row beat column):" << endl << setw(16) << "";
+    for (int j = 0; j < numEngines; j++) {
+        out << setw(16) << report.engines[j].name;
+    }
+    out << endl;
+    for (int i = 0; i < numEngines; i++) {
+        out << setw(16) << report.engines[i].name;
+        for (int j = 0; j < numEngines; j++) {
+            out << setw(16) << report.wins.get(i, j);
+        }
+        out << endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("summarizeSpeedups") {
+    SpeedupSummary s = summarizeSpeedups({4, 1, 2, 0.5, 8});
+    EXPECT_EQUAL(s.samples, 5);
+    EXPECT_EQUAL(s.min, 0.5);
+    EXPECT_EQUAL(s.median, 2);
+    EXPECT_EQUAL(s.max, 8);
+    EXPECT(abs(s.geometricMean - 2) < 1e-9);
+}
+
+PROVIDED_TEST("runHarness on a seeded corpus") {
+    HarnessReport report = runHarness(76, 25, 6, 1);
+    EXPECT_EQUAL(report.problems.size(), 25);
+    EXPECT_EQUAL(report.runs.numCols(), report.engines.size());
+    for (int i = 0; i < report.engines.size(); i++) {
+        EXPECT_EQUAL(report.wins[i][i], 0);
+        for (int j = 0; j < report.engines.size(); j++) {
+            EXPECT(report.wins[i][j] + report.wins[j][i] <= report.problems.size());
+        }
+    }
+    streamsize precision = cout.precision();
+    printHarnessReport(cout, report);
+    EXPECT_EQUAL(cout.precision(), precision);
+    EXPECT_EQUAL(cout.flags() & ios::floatfield, 0);
+}
@@ -0,0 +1,68 @@
+/*
+ * This file contains the declarations for the A/B harness that runs every registered engine on the same seeded
+ * corpus and compares their speed and solvability
+ */
+#pragma once
+
+#include <iostream>
+#include "grid.h"
+#include "vector.h"
+#include "engines.h"
+
+/** Results of running a set of engines on a corpus
+ */
+struct HarnessReport {
+    Vector<Engine> engines;
+    Vector<Problem> problems;
+    Grid<EngineRun> runs;         // runs[problem][engine]
+    Vector<int> disagreements;    // problems that some engines solved and others did not
+    Grid<int> wins;               // wins[i][j] is the number of problems engine i beat engine j on
+};
+
+/** Summary of an engine's per-input speedups over the baseline
+ */
+struct SpeedupSummary {
+    int samples = 0;              // problems both engines solved
+    double min = 0;
+    double p10 = 0;
+    double median = 0;
+    double p90 = 0;
+    double max = 0;
+    double geometricMean = 0;
+};
+
+/**
+ * Run engines on the same seeded corpus, verify every result and compare them
+ * @param corpus seed, number of problems, maximum pieces per problem, timed repetitions per run, and engines
+ * @return report with every run, solvability disagreements and the win/loss matrix
+ *
+ * This function runs in O(pe) engine runs for p problems and e engines
+ */
+HarnessReport runHarness(int seed, int numProblems, int maxPieces, int repetitions = 3,
+                         Vector<Engine> engines = registeredEngines());
+
+/**
+ * Per-input speedups of one engine over another, on the problems both solved
+ * @param report, engine index and baseline engine index
+ * @return vector of baseline time divided by engine time, one per problem
+ *
+ * This function runs in O(p) for p problems
+ */
+Vector<double> speedups(const HarnessReport &report, int engine, int baseline);
+
+/**
+ * Summarize a speedup distribution
+ * @param speedups
+ * @return min, percentiles, max and geometric mean
+ *
+ * This function runs in O(n log n) for n speedups
+ */
+SpeedupSummary summarizeSpeedups(Vector<double> speedups);
+
+/**
+ * Print solve rates, speedup distributions against the baseline, disagreements and the win/loss matrix
+ * @param output stream, report, and index of the baseline engine
+ *
+ * This function runs in O(pe + e^2) for p problems and e engines
+ */
+void printHarnessReport(std::ostream &out, const HarnessReport &report, int baseline = 0);
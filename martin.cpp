@@ -2,11 +2,37 @@
  * This file contains the implementation of calculating a stalemate based off a randomly generated
  * opponent king location and set of pieces
  */
-#include "stalemate.h"
+#include "martin.h"
+#include "bitboard.h"
+#include "profiler.h"
 #include "testing/SimpleTest.h"
 
 using namespace std;
 
+thread_local Grid<char> _board;
+thread_local SearchControl _search;
+static thread_local AttackBoard _attackBoard;
+
+/* This function takes in a node budget and cancellation flag and resets the current thread's search control.
+ */
+void resetSearch(long nodeBudget, atomic<bool> *cancel) {
+    _search = SearchControl();
+    _search.nodeBudget = nodeBudget;
+    _search.cancel = cancel;
+}
+
+/* This function counts a search node and returns whether the search has to give up, either because the node
+ * budget is spent or another thread set the cancellation flag. Once a search gives up it stays stopped.
+ */
+bool searchShouldStop() {
+    _search.nodes++;
+    if (!_search.stopped) {
+        _search.stopped = (_search.nodeBudget >= 0 && _search.nodes > _search.nodeBudget)
+                          || (_search.cancel != nullptr && _search.cancel->load(memory_order_relaxed));
+    }
+    return _search.stopped;
+}
+
 /* This function takes in a GridLocation and Vector of characters and returns a map of pieces to a
  * location that achieves stalemate. It greedily gets possible locations and recursively tests
  * combinations.
@@ -17,11 +43,17 @@ Map<char, Vector<GridLocation>> calculateStalemate(GridLocation kingLoc, Vector<
     Map<char, Vector<GridLocation>> result;
     Map<char, Vector<GridLocation>> pieceBestLocs;
 
-    for (char i : pieces) {
-        pieceBestLocs[i] = greedyHelper(i, adjacentLocs);
+    {
+        ProfilePhase candidates("candidates");
+        for (char i : pieces) {
+            pieceBestLocs[i] = greedyHelper(i, adjacentLocs);
+        }
     }
 
-    placePieceGreedy(pieces, 0, pieceBestLocs, exclusion, result, kingLoc);
+    {
+        ProfilePhase searching("search");
+        placePieceGreedy(pieces, 0, pieceBestLocs, exclusion, result, kingLoc);
+    }
 
     calculateExclusion(exclusion, kingLoc, result);
     removeUsedPieces(pieces, result);
@@ -41,12 +73,18 @@ Map<char, Vector<GridLocation>> calculateStalemateAlternative(GridLocation kingL
 
     sort(pieces);
 
-    for (char i : pieces) {
-        pieceBestLocs[i] = greedyHelper(i, adjacentLocs);
+    {
+        ProfilePhase candidates("candidates");
+        for (char i : pieces) {
+            pieceBestLocs[i] = greedyHelper(i, adjacentLocs);
+        }
     }
 
     Set<GridLocation> takenLocs;
-    placePieceGreedy(pieces, 0, pieceBestLocs, exclusion, result, kingLoc);
+    {
+        ProfilePhase searching("search");
+        placePieceGreedy(pieces, 0, pieceBestLocs, exclusion, result, kingLoc);
+    }
 
     calculateExclusion(exclusion, kingLoc, result);
     removeUsedPieces(pieces, result);
@@ -59,14 +97,16 @@ Map<char, Vector<GridLocation>> calculateStalemateAlternative(GridLocation kingL
  */
 void sort(Vector<char> &pieces) {
     char king = pieces.remove(0);
-    pieces.sort();
-    pieces.reverse();
-
-    int index = pieces.indexOf('Q');
-    for (int i = 0; i < index && index != -1; i++) {
-        pieces[index + i] = 'R';
-        pieces[i] = 'Q';
+    string order = "QRHB";
+    Vector<char> sorted;
+    for (char piece : order) {
+        for (char i : pieces) {
+            if (i == piece) {
+                sorted.add(i);
+            }
+        }
     }
+    pieces = sorted;
     pieces.insert(0, king);
 }
 
@@ -130,24 +170,34 @@ void calculateExclusion(Set<GridLocation> &exclusionLocs, GridLocation kingLoc,
 /* This function takes in a Vector of characters by reference, integer index, optimal move Map of characters to Vector of GridLocations,
  * Set of excluded GridLocations by reference, result Map of characters to Vector of GridLocations by reference, and opponent king location.
  * It recursively tests combinations of pieces and their locations by incrementing the index to move to the next piece, considering each
- * optimal move for each piece. It returns true when a stalemate is achieved or false when all combinations are exhuasted.
+ * optimal move for each piece. It returns true when a stalemate is achieved or false when all combinations are exhuasted
+ * or the search was stopped through _search. The stalemate check reads _attackBoard, which the first call builds from the board
+ * and every placement and removal updates, so a move recomputes only the pieces whose attacks it changes.
  */
 bool placePieceGreedy(Vector<char> &pieces, int pieceIndex, Map<char, Vector<GridLocation>> &moves,
                       Set<GridLocation> &exclusionLocs, Map<char, Vector<GridLocation>> &result,
                       GridLocation kingLoc) {
-    if (isStalemate(kingLoc, result)) return true;
+    if (searchShouldStop()) return false;
+    profileDepth(pieceIndex);
+
+    if (pieceIndex == 0) _attackBoard.reset(kingLoc, result);
+
+    if (_attackBoard.isStalemate()) return true;
 
     if (pieceIndex > pieces.size() - 1) return false;
 
     for (GridLocation loc : moves[pieces[pieceIndex]]) {
         if (!exclusionLocs.contains(loc)) {
             _board[loc] = pieces[pieceIndex];
+            _attackBoard.place(pieces[pieceIndex], loc);
             result[pieces[pieceIndex]].add(loc);
             exclusionLocs.add(loc);
 
             if (placePieceGreedy(pieces, pieceIndex + 1, moves, exclusionLocs, result, kingLoc)) return true;
+            profileDepth(pieceIndex);
 
             _board[loc] = 'E';
+            _attackBoard.remove(loc);
             result[pieces[pieceIndex]].remove(result[pieces[pieceIndex]].size() - 1);
         }
     }
@@ -207,82 +257,28 @@ void removeAttackedLocs(Set<GridLocation> &kingAdjacentLocs, char piece, GridLoc
     kingAdjacentLocs = kingAdjacentLocs - attackedLocs;
 }
 
-/* This function takes in a Set of GridLocations by reference and the GridLocation of a piece. It adds the horizontal and vertical
- * locations from the piece's GridLocation to the Set, given that there is no piece obstructing the horizontal or vertical direction
- * from the piece's GridLocations.
- */
-void rowAttackingLocs(Set<GridLocation> &locs, GridLocation pieceLoc) {
-    GridLocation loc;
-    Vector<Vector<int>> dirs = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}};
-    for (Vector<int> dir : dirs) {
-        loc = GridLocation(pieceLoc.row + dir[0], pieceLoc.col + dir[1]);
-        while (_board.inBounds(loc) && _board[loc] == 'E') {
-            locs.add(loc);
-            loc = GridLocation(loc.row + dir[0], loc.col + dir[1]);
-        }
-    }
-}
-
-/* This function takes in a Set of GridLocations by reference and the GridLocation of a piece. It adds the diagonal
- * locations from the piece's GridLocation to the Set, given that there is no piece obstructing the diagonal direction from
- * the piece's GridLocation.
- */
-void diagonalAttackingLocs(Set<GridLocation> &locs, GridLocation pieceLoc) {
-    GridLocation loc;
-    Vector<Vector<int>> dirs = {{1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
-    for (Vector<int> j : dirs) {
-        loc = GridLocation(pieceLoc.row + j[0], pieceLoc.col + j[1]);
-        while (_board.inBounds(loc) && _board[loc] == 'E') {
-            locs.add(loc);
-            loc = GridLocation(loc.row + j[0], loc.col + j[1]);
-        }
-    }
-}
-
 /* This function takes in a character piece and the GridLocation for that piece and returns a Set of GridLocations that
- * are attacked by the piece.
+ * are attacked by the piece. The squares the piece could reach on an empty board are read off the current board to
+ * find the ones occupied, and attackMask, which covers every piece with a descriptor, does the rest.
  */
 Set<GridLocation> pieceAttackingLocs(char piece, GridLocation pieceLoc) {
     Set<GridLocation> locs;
-    GridLocation loc;
-    switch (piece) {
-        case 'K': {
-            for (int i = -1; i <= 1; i++) {
-                for (int j = -1; j <= 1; j++) {
-                    loc = GridLocation(pieceLoc.row + i, pieceLoc.col + j);
-                    if (_board.inBounds(loc) && _board[loc] == 'E' && loc != pieceLoc) {
-                        locs.add(loc);
-                    }
-                }
-            }
-            break;
-        }
-        case 'Q': {
-            rowAttackingLocs(locs, pieceLoc);
-            diagonalAttackingLocs(locs, pieceLoc);
-            break;
-        }
-        case 'R': {
-            rowAttackingLocs(locs, pieceLoc);
-            break;
-        }
-        case 'H': {
-            Vector<Vector<int>> dirs = {{1, 2}, {2, 1}, {1, -2}, {2, -1}, {-1, 2}, {-2, 1}, {-1, -2}, {-2, -1}};
-            for (Vector<int> j : dirs) {
-                if (_board.inBounds(GridLocation(pieceLoc.row + j[0], pieceLoc.col + j[1]))) {
-                    locs.add(GridLocation(pieceLoc.row + j[0], pieceLoc.col + j[1]));
-                }
-            }
-            break;
-        }
-        case 'B': {
-            diagonalAttackingLocs(locs, pieceLoc);
-            break;
-        }
-        default: {
-            error("Invalid character representation of a piece");
+    if (!_board.inBounds(pieceLoc)) {
+        return locs;
+    }
+    int square = pieceLoc.row * 8 + pieceLoc.col;
+    uint64_t reach = attackMask(piece, square, 0);
+    uint64_t occupied = 0;
+    for (uint64_t bits = reach; bits; bits &= bits - 1) {
+        int target = lowestSquare(bits);
+        if (_board[target / 8][target % 8] != 'E') {
+            occupied |= uint64_t(1) << target;
         }
     }
+    for (uint64_t bits = attackMask(piece, square, occupied); bits; bits &= bits - 1) {
+        int target = lowestSquare(bits);
+        locs.add(GridLocation(target / 8, target % 8));
+    }
     return locs;
 }
 
@@ -601,6 +597,10 @@ PROVIDED_TEST("Sort") {
     pieces = {'K', 'B'};
     EXPECT(pieces.equals({'K', 'B'}));
     sort(pieces);
+
+    pieces = {'K', 'R', 'R', 'R', 'Q', 'H'};
+    sort(pieces);
+    EXPECT(pieces.equals({'K', 'Q', 'R', 'R', 'R', 'H'}));
 }
 
 PROVIDED_TEST("calculateStalemate with randomly generated opponent king and pieces") {
@@ -4,15 +4,45 @@
  */
 #pragma once
 
+#include <atomic>
 #include "grid.h"
 #include "map.h"
 #include "set.h"
 #include "gtypes.h"
 #include "gwindow.h"
 
-/** Global board variable
+/** Global board variable, one per thread so engines can run concurrently
  */
-Grid<char> _board;
+extern thread_local Grid<char> _board;
+
+/** Per-thread search statistics and limits checked by placePieceGreedy
+ */
+struct SearchControl {
+    long nodes = 0;                         // search nodes visited
+    long nodeBudget = -1;                   // give up after this many nodes, -1 for no limit
+    std::atomic<bool> *cancel = nullptr;    // set by another thread to stop this search
+    bool stopped = false;                   // the search gave up before finishing
+};
+
+/** Search control for the current thread
+ */
+extern thread_local SearchControl _search;
+
+/**
+ * Reset the current thread's search statistics and limits
+ * @param node budget (-1 for no limit) and cancellation flag owned by the caller
+ *
+ * This function runs in O(1)
+ */
+void resetSearch(long nodeBudget = -1, std::atomic<bool> *cancel = nullptr);
+
+/**
+ * Count a search node and check whether the search has to give up
+ * @return true if the node budget is spent or the search was cancelled
+ *
+ * This function runs in O(1)
+ */
+bool searchShouldStop();
 
 /**
  * Calculates a stalemate position
@@ -39,7 +69,7 @@ Map<char, Vector<GridLocation>> calculateStalemateAlternative(GridLocation kingL
  * Sort pieces from most to least efficient (Queen, Rook, Bishop, Knight) while keeping King at the front
  * @param pieces
  *
- * This function runs in O(n) with n being number of bishops
+ * This function runs in O(n) for n pieces
  */
 void sort(Vector<char> &pieces);
 
@@ -106,11 +136,12 @@ Set<GridLocation> pieceAttackingLocs(char piece, GridLocation pieceLoc);
 
 /**
  * Generate random set of pieces where stalemate is always possible
+ * @param maximum number of pieces, not including the king
  * @return vector of random pieces
  *
- * This function runs in O(1)
+ * This function runs in O(n) for n pieces
  */
-Vector<char> generatePieces();
+Vector<char> generatePieces(int max);
 
 /**
  * Checks if stalemate is achieved
@@ -0,0 +1,198 @@
+/*
+ * This file contains the implementation of the meet-in-the-middle stalemate engine, which splits the pieces in two
+ * halves and joins the halves' coverage of the opponent king's neighbourhood
+ */
+#include <cstdint>
+#include "mitm.h"
+#include "coverage.h"
+#include "engines.h"
+#include "hashmap.h"
+#include "profiler.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kNumMasks = 1 << 9;
+static const int kPlacementsPerMask = 4;
+
+/** Some of a half's pieces on squares, the rest left for placeUselessPieces
+ */
+struct HalfPlacement {
+    Vector<char> pieces;
+    Vector<GridLocation> locs;
+    uint64_t occupied = 0;
+    int coverage = 0;
+    char lastPiece = 0;     // type of the last piece considered
+    int lastIndex = -1;     // its candidate index, so equal pieces take increasing squares
+    bool closed = false;    // a piece of lastPiece's type was left out, so the rest of that type are too
+};
+
+/* This function takes in a half of the pieces, with equal pieces next to each other, and the candidates of every piece
+ * type. It places the pieces one at a time, each either left out or put on a free candidate square, keeping the
+ * placements in a table indexed by the neighbourhood squares they cover, and returns the non-empty entries as a hash
+ * map for the join. At most kPlacementsPerMask placements are kept for a
+ * mask, and since leaving a piece out is tried first, those kept use the fewest pieces.
+ */
+static HashMap<int, Vector<HalfPlacement>> enumerateHalf(const Vector<char> &pieces,
+                                                         Map<char, Vector<Candidate>> &candidates) {
+    Vector<Vector<HalfPlacement>> states(kNumMasks);
+    states[0].add(HalfPlacement());
+    for (char piece : pieces) {
+        Vector<Vector<HalfPlacement>> next(kNumMasks);
+        const Vector<Candidate> &squares = candidates[piece];
+        for (int mask = 0; mask < kNumMasks; mask++) {
+            for (const HalfPlacement &state : states[mask]) {
+                bool sameType = state.lastPiece == piece;
+                if (next[mask].size() < kPlacementsPerMask) {
+                    HalfPlacement idle = state;
+                    idle.lastPiece = piece;
+                    idle.lastIndex = sameType ? state.lastIndex : -1;
+                    idle.closed = true;
+                    next[mask].add(idle);
+                }
+                if (sameType && state.closed) {
+                    continue;
+                }
+                for (int i = sameType ? state.lastIndex + 1 : 0; i < squares.size(); i++) {
+                    uint64_t bit = uint64_t(1) << (squares[i].loc.row * 8 + squares[i].loc.col);
+                    int coverage = state.coverage | squares[i].mask;
+                    if ((state.occupied & bit) || next[coverage].size() >= kPlacementsPerMask) {
+                        continue;
+                    }
+                    HalfPlacement placed = state;
+                    placed.pieces.add(piece);
+                    placed.locs.add(squares[i].loc);
+                    placed.occupied |= bit;
+                    placed.coverage = coverage;
+                    placed.lastPiece = piece;
+                    placed.lastIndex = i;
+                    placed.closed = false;
+                    next[coverage].add(placed);
+                }
+            }
+        }
+        states = next;
+    }
+    HashMap<int, Vector<HalfPlacement>> byMask;
+    for (int mask = 0; mask < kNumMasks; mask++) {
+        if (!states[mask].isEmpty()) {
+            byMask[mask] = states[mask];
+        }
+    }
+    return byMask;
+}
+
+/* This function takes in the opponent king location and pieces and returns a map of pieces to locations. The pieces
+ * are sorted and dealt alternately into two halves, each half is enumerated into coverage masks, and for every left
+ * mask the right masks that cover the rest of the neighbourhood are found by walking the supersets of the missing
+ * squares in the right half's hash map. Each joined pair that uses disjoint squares is put on the board and checked
+ * with isStalemate, counting a search node per check, and the first that still passes with the unused pieces placed
+ * is returned.
+ */
+Map<char, Vector<GridLocation>> calculateStalemateMeetInMiddle(GridLocation kingLoc, Vector<char> pieces) {
+    Set<GridLocation> adjacentLocs = getAdjacentLocs(kingLoc);
+    int full = coverageMask(adjacentLocs, kingLoc) & ~kCentreBit;
+
+    Vector<char> sorted = pieces;
+    sort(sorted);
+    Vector<char> halves[2];
+    Map<char, Vector<Candidate>> candidates;
+    for (int i = 0; i < sorted.size(); i++) {
+        halves[i % 2].add(sorted[i]);
+        if (!candidates.containsKey(sorted[i])) {
+            candidates[sorted[i]] = pieceCandidates(sorted[i], kingLoc);
+        }
+    }
+    for (Vector<char> &half : halves) {
+        half.sort();
+    }
+    HashMap<int, Vector<HalfPlacement>> left;
+    HashMap<int, Vector<HalfPlacement>> right;
+    {
+        ProfilePhase enumerating("enumerate");
+        left = enumerateHalf(halves[0], candidates);
+        right = enumerateHalf(halves[1], candidates);
+    }
+
+    ProfilePhase joining("join");
+    Map<char, Vector<GridLocation>> result;
+    bool found = false;
+    for (int leftMask : left) {
+        int need = full & ~leftMask;
+        int spare = full & ~need;
+        for (int extra = spare; !found; extra = (extra - 1) & spare) {
+            int rightMask = need | extra;
+            if (right.containsKey(rightMask)) {
+                for (const HalfPlacement &a : left[leftMask]) {
+                    for (const HalfPlacement &b : right[rightMask]) {
+                        if (found || (a.occupied & b.occupied)) {
+                            continue;
+                        }
+                        if (searchShouldStop()) {
+                            return result;
+                        }
+                        Vector<char> placedPieces = a.pieces;
+                        Vector<GridLocation> placedLocs = a.locs;
+                        for (int i = 0; i < b.pieces.size(); i++) {
+                            placedPieces.add(b.pieces[i]);
+                            placedLocs.add(b.locs[i]);
+                        }
+                        found = completePlacement(kingLoc, pieces, placedPieces, placedLocs, result);
+                    }
+                }
+            }
+            if (extra == 0) {
+                break;
+            }
+        }
+        if (found) {
+            break;
+        }
+    }
+    if (!found) {
+        placeUselessPieces(pieces, adjacentLocs, kingLoc, result);
+    }
+    return result;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Meet in the middle on the large-piece problems") {
+    GridLocation kingLoc = GridLocation(2, 1);
+    for (Vector<char> pieces : Vector<Vector<char>>({{'K', 'H', 'B', 'Q', 'R', 'Q', 'Q', 'Q', 'H', 'H', 'H'},
+                                                     {'K', 'R', 'Q', 'Q', 'Q', 'Q', 'B', 'H', 'H', 'H', 'H'},
+                                                     {'K', 'Q', 'Q', 'Q', 'Q', 'Q', 'R', 'R', 'R', 'R', 'R'}})) {
+        EngineRun run = runEngine(findEngine("meet-in-middle"), kingLoc, pieces);
+        EXPECT(run.verified);
+        EXPECT(isStalemate(kingLoc, run.result));
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Meet in the middle joins complementary masks") {
+    clearBoard();
+    GridLocation kingLoc = GridLocation(0, 0);
+    _board[kingLoc] = 'K';
+    Map<char, Vector<GridLocation>> result = calculateStalemateMeetInMiddle(kingLoc, {'K', 'Q', 'B'});
+    EXPECT(verifyStalemate(kingLoc, {'K', 'Q', 'B'}, result));
+    clearBoard();
+}
+
+PROVIDED_TEST("Meet in the middle against calculateStalemateAlternative on large inputs") {
+    Vector<Problem> problems = generateCorpus(840, 30, 10);
+    Vector<Engine> engines = {findEngine("sorted-greedy"), findEngine("meet-in-middle")};
+    for (const Engine &engine : engines) {
+        int solved = 0;
+        double micros = 0;
+        long nodes = 0;
+        for (const Problem &problem : problems) {
+            EngineRun run = runEngine(engine, problem.kingLoc, problem.pieces, 1, nullptr, 100000);
+            solved += run.verified;
+            micros += run.micros;
+            nodes += run.nodes;
+        }
+        cout << engine.name << ": solved " << solved << "/" << problems.size() << ", " << micros / 1000 << " ms, "
+             << nodes << " nodes" << endl;
+    }
+    clearBoard();
+}
@@ -0,0 +1,21 @@
+/*
+ * This file contains the declarations for the meet-in-the-middle stalemate engine, which splits the pieces in two
+ * halves and joins the halves' coverage of the opponent king's neighbourhood
+ */
+#pragma once
+
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/**
+ * Calculates a stalemate position by meet in the middle: each half of the pieces is enumerated into the 9-bit masks of
+ * neighbourhood squares it can attack, and masks that together cover every square around the king are joined and
+ * checked with isStalemate, which accounts for pieces blocking each other
+ * @param opponent king location and random set of pieces
+ * @return map of pieces to their locations to achieve a stalemate
+ *
+ * This function runs in O(k^(n/2)) for k candidate squares per piece and n pieces, and in O(2^8 c k n) with c
+ * placements kept per coverage mask
+ */
+Map<char, Vector<GridLocation>> calculateStalemateMeetInMiddle(GridLocation kingLoc, Vector<char> pieces);
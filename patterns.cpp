@@ -0,0 +1,257 @@
+/*
+ * This file contains the implementation of the pattern library: small stalemate motifs for every king square, matched
+ * against a problem's pieces before any search
+ */
+#include <thread>
+#include "patterns.h"
+#include "engines.h"
+#include "error.h"
+#include "hashset.h"
+#include "sat.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const string kPieceTypes = "KQRBH";
+static const int kFieldBits = 5;
+static const int kMaxMotifPieces = 3;   // pieces in a motif besides the white king
+
+/* This function takes in pieces and whether a piece without a field is an error, and returns the counts of the
+ * pieces with a field packed five bits per type in the order of kPieceTypes.
+ */
+static int packCounts(const Vector<char> &pieces, bool strict) {
+    int counts[5] = {};
+    for (char piece : pieces) {
+        size_t type = kPieceTypes.find(piece);
+        if (type == string::npos) {
+            if (strict) {
+                error(string("No packed count for piece ") + piece);
+            }
+        } else if (counts[type] < 15) {
+            counts[type]++;
+        }
+    }
+    int packed = 0;
+    for (int type = 0; type < 5; type++) {
+        packed |= counts[type] << (type * kFieldBits);
+    }
+    return packed;
+}
+
+int packPieceCounts(const Vector<char> &pieces) {
+    return packCounts(pieces, true);
+}
+
+int packAvailableCounts(const Vector<char> &pieces) {
+    return packCounts(pieces, false);
+}
+
+bool hasPackedCounts(const Vector<char> &pieces) {
+    for (char piece : pieces) {
+        if (kPieceTypes.find(piece) == string::npos) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* This function takes in required and available packed counts. Setting the top bit of every available field makes each
+ * field's subtraction borrow from that bit and no further, so a field whose top bit is clear afterwards needed more
+ * pieces than there are.
+ */
+bool piecesAvailable(int required, int available) {
+    int guard = 0;
+    for (int type = 0; type < 5; type++) {
+        guard |= 1 << (type * kFieldBits + kFieldBits - 1);
+    }
+    return (((available | guard) - required) & guard) == guard;
+}
+
+/* This function takes in the pieces besides the white king that a motif may use and adds every multiset of up to
+ * kMaxMotifPieces of them, with and without the white king, to motifs, starting from the given type index.
+ */
+static void listMotifs(Vector<char> &motif, int firstType, Vector<Vector<char>> &motifs) {
+    if (!motif.isEmpty()) {
+        motifs.add(motif);
+        Vector<char> withKing = motif;
+        withKing.insert(0, 'K');
+        motifs.add(withKing);
+    }
+    if (motif.size() == kMaxMotifPieces) {
+        return;
+    }
+    for (int type = firstType; type < int(kPieceTypes.size()); type++) {
+        motif.add(kPieceTypes[type]);
+        listMotifs(motif, type, motifs);
+        motif.removeBack();
+    }
+}
+
+/* This function builds the library. Every motif is solved with the SAT engine, which places every piece it is given,
+ * on each canonical king square, and each verified solution is added to all the squares its symmetries reach, skipping
+ * duplicates. It runs on its own thread so the caller's board and search budget are untouched, and sorts each square's
+ * templates by size so matching prefers the smallest motif.
+ */
+static Vector<Vector<PatternTemplate>> buildLibrary() {
+    Vector<Vector<PatternTemplate>> library(64);
+    thread builder([&]() {
+        Vector<Vector<char>> motifs;
+        Vector<char> motif;
+        listMotifs(motif, 1, motifs);
+        HashSet<string> seen;
+        for (int square = 0; square < 64; square++) {
+            GridLocation kingLoc(square / 8, square % 8);
+            if (transformLoc(kingLoc, canonicalSymmetry(kingLoc)) != kingLoc) {
+                continue;
+            }
+            for (const Vector<char> &pieces : motifs) {
+                clearBoard();
+                _board[kingLoc] = 'K';
+                resetSearch();
+                Map<char, Vector<GridLocation>> solution = calculateStalemateSat(kingLoc, pieces);
+                if (!verifyStalemate(kingLoc, pieces, solution)) {
+                    continue;
+                }
+                for (int symmetry = 0; symmetry < kNumSymmetries; symmetry++) {
+                    GridLocation king = transformLoc(kingLoc, symmetry);
+                    PatternTemplate pattern;
+                    pattern.required = packPieceCounts(pieces);
+                    string key(1, char(king.row * 8 + king.col));
+                    for (char piece : solution) {
+                        for (GridLocation loc : solution[piece]) {
+                            GridLocation moved = transformLoc(loc, symmetry);
+                            pattern.pieces.add(piece);
+                            pattern.locs.add(moved);
+                            key += piece;
+                            key += char(moved.row * 8 + moved.col);
+                        }
+                    }
+                    if (!seen.contains(key)) {
+                        seen.add(key);
+                        library[king.row * 8 + king.col].add(pattern);
+                    }
+                }
+            }
+        }
+        clearBoard();
+    });
+    builder.join();
+    for (Vector<PatternTemplate> &templates : library) {
+        Vector<PatternTemplate> sorted;
+        for (int size = 1; size <= kMaxMotifPieces + 1; size++) {
+            for (const PatternTemplate &pattern : templates) {
+                if (pattern.pieces.size() == size) {
+                    sorted.add(pattern);
+                }
+            }
+        }
+        templates = sorted;
+    }
+    return library;
+}
+
+const Vector<PatternTemplate> &patternsFor(GridLocation kingLoc) {
+    static const Vector<Vector<PatternTemplate>> library = buildLibrary();
+    return library[kingLoc.row * 8 + kingLoc.col];
+}
+
+/* This function takes in a problem and a map for the placement. It packs the problem's piece counts once, leaving out
+ * pieces no template uses, and walks the king square's templates; a template whose counts fit is put on the board, the
+ * pieces it does not use are placed by placeUselessPieces, and the placement is returned if verifyStalemate accepts it.
+ * Otherwise the board is reset to the king alone and the next template is tried.
+ */
+bool matchPattern(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &result) {
+    int available = packAvailableCounts(pieces);
+    for (const PatternTemplate &pattern : patternsFor(kingLoc)) {
+        if (!piecesAvailable(pattern.required, available)) {
+            continue;
+        }
+        result.clear();
+        for (int i = 0; i < pattern.pieces.size(); i++) {
+            result[pattern.pieces[i]].add(pattern.locs[i]);
+            _board[pattern.locs[i]] = pattern.pieces[i];
+        }
+        Vector<char> remaining = pieces;
+        Set<GridLocation> exclusion;
+        calculateExclusion(exclusion, kingLoc, result);
+        removeUsedPieces(remaining, result);
+        placeUselessPieces(remaining, exclusion, kingLoc, result);
+        if (verifyStalemate(kingLoc, pieces, result)) {
+            return true;
+        }
+        for (char piece : result) {
+            for (GridLocation loc : result[piece]) {
+                _board[loc] = 'E';
+            }
+        }
+    }
+    result.clear();
+    return false;
+}
+
+/* This function takes in the opponent king location and pieces and returns a placement from the pattern library, or
+ * from the SAT engine if no template matches.
+ */
+Map<char, Vector<GridLocation>> calculateStalematePatterns(GridLocation kingLoc, Vector<char> pieces) {
+    Map<char, Vector<GridLocation>> result;
+    if (matchPattern(kingLoc, pieces, result)) {
+        return result;
+    }
+    return calculateStalemateSat(kingLoc, pieces);
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Packed piece counts") {
+    int available = packPieceCounts({'K', 'Q', 'R', 'R', 'H'});
+    EXPECT(piecesAvailable(packPieceCounts({'R', 'R'}), available));
+    EXPECT(piecesAvailable(packPieceCounts({'K', 'Q', 'H'}), available));
+    EXPECT(piecesAvailable(0, available));
+    EXPECT(!piecesAvailable(packPieceCounts({'R', 'R', 'R'}), available));
+    EXPECT(!piecesAvailable(packPieceCounts({'B'}), available));
+    EXPECT(!piecesAvailable(packPieceCounts({'Q', 'Q'}), available));
+    EXPECT(piecesAvailable(packPieceCounts({'H', 'H', 'H'}), packPieceCounts(Vector<char>(20, 'H'))));
+
+    // fairy pieces have no field: they never collide with no piece in a key, but may be left over in a query
+    EXPECT_ERROR(packPieceCounts({'K', 'A'}));
+    EXPECT(!hasPackedCounts({'K', 'Q', 'M'}));
+    EXPECT(hasPackedCounts({'K', 'Q', 'R', 'B', 'H'}));
+    EXPECT_EQUAL(packAvailableCounts({'K', 'A', 'C', 'M', 'R'}), packPieceCounts({'K', 'R'}));
+}
+
+PROVIDED_TEST("Pattern templates are stalemates on every king square") {
+    for (int square = 0; square < 64; square++) {
+        GridLocation kingLoc(square / 8, square % 8);
+        const Vector<PatternTemplate> &templates = patternsFor(kingLoc);
+        EXPECT(!templates.isEmpty());
+        for (const PatternTemplate &pattern : templates) {
+            Map<char, Vector<GridLocation>> placement;
+            for (int i = 0; i < pattern.pieces.size(); i++) {
+                placement[pattern.pieces[i]].add(pattern.locs[i]);
+            }
+            EXPECT(verifyStalemate(kingLoc, pattern.pieces, placement));
+        }
+    }
+}
+
+PROVIDED_TEST("Most problems are answered from the pattern library") {
+    patternsFor(GridLocation(0, 0));
+    Vector<Problem> problems = generateCorpus(860, 100, 10);
+    int matched = 0;
+    int verified = 0;
+    double micros = 0;
+    for (const Problem &problem : problems) {
+        EngineRun run = runEngine(findEngine("patterns"), problem.kingLoc, problem.pieces);
+        clearBoard();
+        _board[problem.kingLoc] = 'K';
+        Map<char, Vector<GridLocation>> result;
+        matched += matchPattern(problem.kingLoc, problem.pieces, result);
+        verified += run.verified;
+        micros += run.micros;
+    }
+    cout << "Pattern library answered " << matched << "/" << problems.size() << " without searching, "
+         << verified << " verified in total, mean " << micros / problems.size() << " us" << endl;
+    EXPECT(matched * 2 > problems.size());
+    clearBoard();
+}
@@ -0,0 +1,86 @@
+/*
+ * This file contains the declarations for the pattern library: small stalemate motifs for every king square, matched
+ * against a problem's pieces before any search
+ */
+#pragma once
+
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/** A motif placed around one king square: the pieces it needs, packed for matching, and where they stand
+ */
+struct PatternTemplate {
+    int required;               // piece counts packed by packPieceCounts
+    Vector<char> pieces;
+    Vector<GridLocation> locs;  // location of each piece, in the order of pieces
+};
+
+/**
+ * Pack piece counts into one integer, five bits per piece type K, Q, R, B and H with the top bit of each field kept
+ * clear, so one subtraction tells whether a template's pieces are all available. Other pieces, such as the fairy
+ * pieces, have no field and raise an error, so packed counts always name their multiset
+ * @param pieces
+ * @return packed counts, each capped at 15
+ *
+ * This function runs in O(n) for n pieces
+ */
+int packPieceCounts(const Vector<char> &pieces);
+
+/**
+ * Pack the counts of the pieces that have a field in packPieceCounts, leaving the others out. For asking which stored
+ * multisets a problem contains: a piece without a field is never in a stored multiset, so it can only be left over
+ * @param pieces
+ * @return packed counts of the pieces with a field
+ *
+ * This function runs in O(n) for n pieces
+ */
+int packAvailableCounts(const Vector<char> &pieces);
+
+/**
+ * Whether every piece has a field in packPieceCounts
+ * @param pieces
+ * @return true if every piece is a K, Q, R, B or H
+ *
+ * This function runs in O(n) for n pieces
+ */
+bool hasPackedCounts(const Vector<char> &pieces);
+
+/**
+ * Whether packed counts cover the counts a template requires
+ * @param required and available packed counts
+ * @return true if every required count is at most the available one
+ *
+ * This function runs in O(1)
+ */
+bool piecesAvailable(int required, int available);
+
+/**
+ * The templates for a king square, built once on first use: every motif of up to three pieces besides the white king
+ * is solved on the ten canonical king squares and mapped to the other squares by the board's symmetries
+ * @param opponent king location
+ * @return templates ordered from fewest pieces
+ *
+ * This function runs in O(1) after the library is built
+ */
+const Vector<PatternTemplate> &patternsFor(GridLocation kingLoc);
+
+/**
+ * Try the pattern library on a problem: the first template whose pieces are available is completed with the unused
+ * pieces and checked with verifyStalemate
+ * @param opponent king location, pieces and map to fill with the placement
+ * @return whether a template produced a verified stalemate
+ *
+ * This function runs in O(t n) for t templates for the king square and n pieces
+ */
+bool matchPattern(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &result);
+
+/**
+ * Calculates a stalemate position from the pattern library, searching with the SAT engine only when no template
+ * matches
+ * @param opponent king location and random set of pieces
+ * @return map of pieces to their locations to achieve a stalemate
+ *
+ * This function runs in O(t n) when a template matches, and as calculateStalemateSat otherwise
+ */
+Map<char, Vector<GridLocation>> calculateStalematePatterns(GridLocation kingLoc, Vector<char> pieces);
@@ -0,0 +1,110 @@
+/*
+ * This file contains the implementation of the piece descriptors: every piece the solver knows, described as data by
+ * the jumps it makes and the lines it rides, from which the attack tables are generated
+ */
+#include "pieces.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/* This function takes in a piece's symbol, name, declared jumps, whether its jumps land on occupied squares and the
+ * lines it rides, and returns its descriptor with each jump turned and reflected into all eight symmetries, keeping
+ * every distinct offset once.
+ */
+static PieceDescriptor describePiece(char symbol, string name, Vector<pair<int, int>> jumps, bool leapsOntoPieces,
+                                     bool ridesStraight, bool ridesDiagonal) {
+    PieceDescriptor piece = {symbol, name, {}, leapsOntoPieces, ridesStraight, ridesDiagonal};
+    for (pair<int, int> jump : jumps) {
+        for (int rowSign : {1, -1}) {
+            for (int colSign : {1, -1}) {
+                for (bool swapped : {false, true}) {
+                    pair<int, int> offset(jump.first * rowSign, jump.second * colSign);
+                    if (swapped) {
+                        offset = make_pair(offset.second, offset.first);
+                    }
+                    if (!piece.leaps.contains(offset)) {
+                        piece.leaps.add(offset);
+                    }
+                }
+            }
+        }
+    }
+    return piece;
+}
+
+/* This function returns the table of pieces. Adding a piece is one more line here; the attack tables, the attack board
+ * and the independent checker all read it from this table.
+ */
+static Vector<PieceDescriptor> buildDescriptors() {
+    return {
+        describePiece('K', "king", {{0, 1}, {1, 1}}, false, false, false),
+        describePiece('Q', "queen", {}, false, true, true),
+        describePiece('R', "rook", {}, false, true, false),
+        describePiece('B', "bishop", {}, false, false, true),
+        describePiece('H', "knight", {{1, 2}}, true, false, false),
+        describePiece('A', "amazon", {{1, 2}}, true, true, true),
+        describePiece('C', "chancellor", {{1, 2}}, true, true, false),
+        describePiece('M', "camel", {{1, 3}}, true, false, false),
+    };
+}
+
+const Vector<PieceDescriptor> &pieceDescriptors() {
+    static const Vector<PieceDescriptor> descriptors = buildDescriptors();
+    return descriptors;
+}
+
+/* This function takes in a piece character and looks it up in a table indexed by character, built once from the
+ * descriptors.
+ */
+const PieceDescriptor *findPiece(char piece) {
+    static const Vector<const PieceDescriptor *> bySymbol = []() {
+        Vector<const PieceDescriptor *> table(128, nullptr);
+        for (const PieceDescriptor &descriptor : pieceDescriptors()) {
+            table[descriptor.symbol] = &descriptor;
+        }
+        return table;
+    }();
+    unsigned char index = piece;
+    return index < 128 ? bySymbol[index] : nullptr;
+}
+
+/* This function takes in a piece character and looks up its descriptor's position in a table indexed by character,
+ * built once from the descriptors like findPiece's.
+ */
+int pieceIndex(char piece) {
+    static const Vector<int> bySymbol = []() {
+        Vector<int> table(128, -1);
+        for (int i = 0; i < pieceDescriptors().size(); i++) {
+            table[pieceDescriptors()[i].symbol] = i;
+        }
+        return table;
+    }();
+    unsigned char index = piece;
+    return index < 128 ? bySymbol[index] : -1;
+}
+
+bool isRider(char piece) {
+    const PieceDescriptor *descriptor = findPiece(piece);
+    return descriptor != nullptr && (descriptor->ridesStraight || descriptor->ridesDiagonal);
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Piece descriptors expand their jumps") {
+    EXPECT_EQUAL(findPiece('K')->leaps.size(), 8);
+    EXPECT_EQUAL(findPiece('H')->leaps.size(), 8);
+    EXPECT_EQUAL(findPiece('M')->leaps.size(), 8);
+    EXPECT_EQUAL(findPiece('Q')->leaps.size(), 0);
+    EXPECT(findPiece('M')->leaps.contains(make_pair(-3, 1)));
+    EXPECT(findPiece('H')->leaps.contains(make_pair(2, -1)));
+    EXPECT(!findPiece('K')->leaps.contains(make_pair(0, 0)));
+    EXPECT(findPiece('E') == nullptr);
+    EXPECT(findPiece(char(200)) == nullptr);
+    EXPECT(isRider('A') && isRider('C') && isRider('B'));
+    EXPECT(!isRider('K') && !isRider('H') && !isRider('M') && !isRider('E'));
+    for (int i = 0; i < pieceDescriptors().size(); i++) {
+        EXPECT_EQUAL(pieceIndex(pieceDescriptors()[i].symbol), i);
+    }
+    EXPECT_EQUAL(pieceIndex('E'), -1);
+    EXPECT_EQUAL(pieceIndex(char(200)), -1);
+}
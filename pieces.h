@@ -0,0 +1,56 @@
+/*
+ * This file contains the declarations for the piece descriptors: every piece the solver knows, described as data by the
+ * jumps it makes and the lines it rides, from which the attack tables are generated
+ */
+#pragma once
+
+#include <string>
+#include <utility>
+#include "vector.h"
+
+/** How a piece attacks: the squares it jumps to at fixed offsets and the lines it rides until the first occupied square
+ */
+struct PieceDescriptor {
+    char symbol;
+    std::string name;
+    Vector<std::pair<int, int>> leaps;  // every jump as a row and column offset, the declared ones under all symmetries
+    bool leapsOntoPieces;               // whether a jump attacks an occupied square, as a knight's does and a king's not
+    bool ridesStraight;                 // rides ranks and files
+    bool ridesDiagonal;                 // rides diagonals
+};
+
+/**
+ * The descriptors of every piece, built once on first use: the king, queen, rook, bishop and knight (H), and the fairy
+ * amazon (A, queen and knight), chancellor (C, rook and knight) and camel (M, a (1, 3) leaper)
+ * @return descriptors in a fixed order
+ *
+ * This function runs in O(1) after the table is built
+ */
+const Vector<PieceDescriptor> &pieceDescriptors();
+
+/**
+ * Descriptor of a piece
+ * @param piece character
+ * @return pointer to its descriptor, nullptr if no piece has that character
+ *
+ * This function runs in O(1)
+ */
+const PieceDescriptor *findPiece(char piece);
+
+/**
+ * Position of a piece's descriptor in pieceDescriptors, for tables kept per piece type
+ * @param piece character
+ * @return index of its descriptor, -1 if no piece has that character
+ *
+ * This function runs in O(1)
+ */
+int pieceIndex(char piece);
+
+/**
+ * Whether a piece rides any line, so a piece put between it and a square can block its attack
+ * @param piece character
+ * @return true for a rider, false for a pure leaper or a character that is not a piece
+ *
+ * This function runs in O(1)
+ */
+bool isRider(char piece);
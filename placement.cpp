@@ -0,0 +1,326 @@
+/*
+ * This file contains the implementation of memory placement of large tables: huge-page backed blocks, NUMA node
+ * discovery, pinning threads to nodes and a random-read benchmark that reports TLB misses
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <thread>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+#include "placement.h"
+#include "error.h"
+#include "strlib.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const size_t kHugePageBytes = 2 * 1024 * 1024;
+
+static thread_local int _pinnedNode = -1;
+static volatile uint64_t _readSink;    // keeps the benchmark's reads from being optimised away
+
+/* This function takes in a size and whether to use huge pages and returns a block. On Linux every block is an anonymous
+ * mapping, so it starts zeroed and pages are only placed when first touched. Explicit huge pages need a reserved pool,
+ * so when MAP_HUGETLB fails the mapping is over-allocated by a huge page, trimmed to a 2 MB boundary and offered to
+ * transparent huge pages with madvise. Elsewhere the block comes from new.
+ */
+LargeBlock allocateLarge(size_t bytes, bool hugePages) {
+    LargeBlock block;
+#ifdef __linux__
+    if (hugePages) {
+        size_t size = (bytes + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+        void *data = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (data != MAP_FAILED) {
+            block.data = (unsigned char *) data;
+            block.size = size;
+            block.mapped = true;
+            block.hugePages = true;
+            return block;
+        }
+        data = mmap(nullptr, size + kHugePageBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (data != MAP_FAILED) {
+            uintptr_t start = uintptr_t(data);
+            uintptr_t aligned = (start + kHugePageBytes - 1) / kHugePageBytes * kHugePageBytes;
+            if (aligned > start) {
+                munmap(data, aligned - start);
+            }
+            if (kHugePageBytes > aligned - start) {
+                munmap((void *) (aligned + size), kHugePageBytes - (aligned - start));
+            }
+            block.data = (unsigned char *) aligned;
+            block.size = size;
+            block.mapped = true;
+            block.hugePages = madvise(block.data, size, MADV_HUGEPAGE) == 0;
+            return block;
+        }
+    }
+    void *data = mmap(nullptr, max(bytes, size_t(1)), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (data == MAP_FAILED) {
+        error("Cannot allocate " + longToString(long(bytes)) + " bytes");
+    }
+    block.data = (unsigned char *) data;
+    block.size = bytes;
+    block.mapped = true;
+#else
+    block.data = new unsigned char[max(bytes, size_t(1))]();
+    block.size = bytes;
+#endif
+    return block;
+}
+
+void freeLarge(LargeBlock &block) {
+#ifdef __linux__
+    if (block.mapped) {
+        munmap(block.data, max(block.size, size_t(1)));
+    }
+#endif
+    if (!block.mapped) {
+        delete[] block.data;
+    }
+    block = LargeBlock();
+}
+
+/* This function takes in a cpulist such as "0-3,8-11" and returns the cpus it names.
+ */
+static Vector<int> parseCpuList(string list) {
+    Vector<int> cpus;
+    for (string range : stringSplit(trim(list), ",")) {
+        Vector<string> ends = stringSplit(range, "-");
+        if (ends.isEmpty()) {
+            continue;
+        }
+        int first = stringToInteger(ends[0]);
+        int last = ends.size() > 1 ? stringToInteger(ends[1]) : first;
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.add(cpu);
+        }
+    }
+    return cpus;
+}
+
+/* This function returns the cpus of every node, read once from sysfs. Nodes are numbered consecutively from 0, which
+ * stops at the first missing node; a machine without the directory has one node with unknown cpus.
+ */
+static const Vector<Vector<int>> &nodeCpus() {
+    static const Vector<Vector<int>> nodes = []() {
+        Vector<Vector<int>> found;
+        while (true) {
+            ifstream in("/sys/devices/system/node/node" + integerToString(found.size()) + "/cpulist");
+            string list;
+            if (!in || !getline(in, list)) {
+                break;
+            }
+            found.add(parseCpuList(list));
+        }
+        if (found.isEmpty()) {
+            found.add(Vector<int>());
+        }
+        return found;
+    }();
+    return nodes;
+}
+
+int numaNodeCount() {
+    return nodeCpus().size();
+}
+
+Vector<int> numaNodeCpus(int node) {
+    if (node < 0 || node >= numaNodeCount()) {
+        error("No NUMA node " + integerToString(node));
+    }
+    return nodeCpus()[node];
+}
+
+/* This function takes in a node and pins the calling thread to the node's cpus that its current affinity mask allows,
+ * so a container limited to some cpus still pins where it can.
+ */
+bool pinThreadToNode(int node) {
+    Vector<int> cpus = numaNodeCpus(node);
+#ifdef __linux__
+    cpu_set_t allowed;
+    cpu_set_t wanted;
+    CPU_ZERO(&wanted);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+        return false;
+    }
+    int count = 0;
+    for (int cpu : cpus) {
+        if (cpu < CPU_SETSIZE && CPU_ISSET(cpu, &allowed)) {
+            CPU_SET(cpu, &wanted);
+            count++;
+        }
+    }
+    if (count == 0 || pthread_setaffinity_np(pthread_self(), sizeof(wanted), &wanted) != 0) {
+        return false;
+    }
+    _pinnedNode = node;
+    return true;
+#else
+    return false;
+#endif
+}
+
+int currentNumaNode() {
+    if (_pinnedNode >= 0) {
+        return _pinnedNode;
+    }
+#ifdef __linux__
+    int cpu = sched_getcpu();
+    for (int node = 0; node < numaNodeCount(); node++) {
+        if (nodeCpus()[node].contains(cpu)) {
+            return node;
+        }
+    }
+#endif
+    return 0;
+}
+
+/* This function takes in bytes, a node and whether to use huge pages and copies the bytes into a new block from a
+ * thread pinned to the node. Linux places a page on the node of the thread that first touches it, so the copy lands on
+ * that node without needing libnuma.
+ */
+LargeBlock replicateOnNode(const unsigned char *source, size_t bytes, int node, bool hugePages) {
+    LargeBlock block = allocateLarge(bytes, hugePages);
+    thread toucher([&]() {
+        pinThreadToNode(node);
+        memcpy(block.data, source, bytes);
+    });
+    toucher.join();
+    return block;
+}
+
+#ifdef __linux__
+/* This function opens a counter of data TLB read misses for the calling thread, returning -1 if the kernel does not
+ * allow it.
+ */
+static int openTlbCounter() {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HW_CACHE;
+    attr.config = PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                  (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+#endif
+
+/* This function takes in a block size, whether to use huge pages and a read count. It fills the block so every page is
+ * placed, then times reads at random 8-byte offsets from a xorshift generator, with the TLB counter running around the
+ * reads only.
+ */
+PlacementBenchmark benchmarkRandomReads(size_t bytes, bool hugePages, long reads) {
+    PlacementBenchmark result;
+    LargeBlock block = allocateLarge(bytes, hugePages);
+    result.bytes = bytes;
+    result.hugePages = block.hugePages;
+    uint64_t *words = (uint64_t *) block.data;
+    size_t numWords = bytes / sizeof(uint64_t);
+    for (size_t i = 0; i < numWords; i++) {
+        words[i] = i;
+    }
+
+#ifdef __linux__
+    int counter = openTlbCounter();
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_RESET, 0);
+        ioctl(counter, PERF_EVENT_IOC_ENABLE, 0);
+    }
+#endif
+    auto start = chrono::steady_clock::now();
+    uint64_t state = 88172645463325252ULL;
+    uint64_t sum = 0;
+    for (long i = 0; i < reads; i++) {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        sum += words[state % numWords];
+    }
+    double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+#ifdef __linux__
+    if (counter >= 0) {
+        ioctl(counter, PERF_EVENT_IOC_DISABLE, 0);
+        long long misses;
+        if (read(counter, &misses, sizeof(misses)) == sizeof(misses)) {
+            result.tlbMisses = misses;
+        }
+        close(counter);
+    }
+#endif
+    result.nanosPerRead = reads > 0 ? nanos / reads : 0;
+    _readSink = sum;
+    freeLarge(block);
+    return result;
+}
+
+/* This function takes in an output stream and two benchmarks and prints each one with the candidate's throughput and
+ * TLB misses relative to the baseline.
+ */
+void printPlacementBenchmark(ostream &out, const PlacementBenchmark &baseline, const PlacementBenchmark &candidate) {
+    for (const PlacementBenchmark &run : {baseline, candidate}) {
+        out << (run.bytes >> 20) << " MB, " << (run.hugePages ? "huge pages" : "4 KB pages") << ": "
+            << run.nanosPerRead << " ns/read, " << (run.nanosPerRead > 0 ? 1000 / run.nanosPerRead : 0)
+            << " M reads/s, dTLB misses " << (run.tlbMisses < 0 ? string("unavailable") : longToString(run.tlbMisses))
+            << endl;
+    }
+    if (candidate.nanosPerRead > 0) {
+        out << "Throughput ratio " << baseline.nanosPerRead / candidate.nanosPerRead;
+        if (baseline.tlbMisses >= 0 && candidate.tlbMisses >= 0) {
+            out << ", dTLB misses ratio " << double(baseline.tlbMisses) / max(candidate.tlbMisses, 1L);
+        }
+        out << endl;
+    }
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Large blocks and NUMA nodes") {
+    for (bool hugePages : {false, true}) {
+        LargeBlock block = allocateLarge(3 * kHugePageBytes + 5, hugePages);
+        EXPECT(block.size >= 3 * kHugePageBytes + 5);
+        EXPECT_EQUAL(block.data[block.size - 1], 0);
+        block.data[0] = 1;
+        block.data[block.size - 1] = 2;
+        freeLarge(block);
+        EXPECT(block.data == nullptr);
+    }
+
+    EXPECT(numaNodeCount() >= 1);
+    EXPECT_EQUAL(parseCpuList("0-3,8,10-11\n"), Vector<int>({0, 1, 2, 3, 8, 10, 11}));
+    int node = numaNodeCount() - 1;
+    thread pinned([&]() {
+        if (pinThreadToNode(node)) {
+            EXPECT_EQUAL(currentNumaNode(), node);
+        }
+    });
+    pinned.join();
+    EXPECT(currentNumaNode() >= 0 && currentNumaNode() < numaNodeCount());
+
+    unsigned char source[1000];
+    for (int i = 0; i < 1000; i++) {
+        source[i] = i % 251;
+    }
+    LargeBlock replica = replicateOnNode(source, sizeof(source), node, true);
+    EXPECT_EQUAL(memcmp(replica.data, source, sizeof(source)), 0);
+    freeLarge(replica);
+}
+
+PROVIDED_TEST("Random reads with and without huge pages") {
+    size_t bytes = 256 * 1024 * 1024;
+    PlacementBenchmark small = benchmarkRandomReads(bytes, false, 5000000);
+    PlacementBenchmark huge = benchmarkRandomReads(bytes, true, 5000000);
+    EXPECT(small.nanosPerRead > 0);
+    EXPECT(huge.nanosPerRead > 0);
+    printPlacementBenchmark(cout, small, huge);
+}
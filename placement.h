@@ -0,0 +1,107 @@
+/*
+ * This file contains the declarations for memory placement of large tables: huge-page backed blocks, NUMA node
+ * discovery, pinning threads to nodes and a random-read benchmark that reports TLB misses
+ */
+#pragma once
+
+#include <cstddef>
+#include <iostream>
+#include "vector.h"
+
+/** A large block of memory for a randomly accessed table
+ */
+struct LargeBlock {
+    unsigned char *data = nullptr;
+    size_t size = 0;            // usable bytes, possibly rounded up to whole pages
+    bool mapped = false;        // allocated with mmap rather than new
+    bool hugePages = false;     // backed by explicit huge pages, or transparent huge pages were granted by madvise
+};
+
+/** Result of timing random reads from a large block
+ */
+struct PlacementBenchmark {
+    size_t bytes = 0;
+    bool hugePages = false;
+    double nanosPerRead = 0;
+    long tlbMisses = -1;        // data TLB read misses over the run, -1 where the counter is unavailable
+};
+
+/**
+ * Allocate a large zeroed block, backed by huge pages when asked and the system allows: MAP_HUGETLB first, then a
+ * 2 MB aligned mapping with madvise(MADV_HUGEPAGE), then ordinary pages
+ * @param size in bytes and whether to use huge pages
+ * @return block, raising an error if no memory could be allocated
+ *
+ * This function runs in O(1), plus the cost of faulting in pages as they are first touched
+ */
+LargeBlock allocateLarge(size_t bytes, bool hugePages);
+
+/**
+ * Free a block from allocateLarge and reset it to empty
+ * @param block
+ *
+ * This function runs in O(1)
+ */
+void freeLarge(LargeBlock &block);
+
+/**
+ * Number of NUMA nodes, read from /sys/devices/system/node; 1 where that is not available
+ * @return node count
+ *
+ * This function runs in O(c) for c cpus on the first call and O(1) afterwards
+ */
+int numaNodeCount();
+
+/**
+ * Cpus on a NUMA node
+ * @param node from 0 to numaNodeCount() - 1
+ * @return cpu numbers, empty where that is not known
+ *
+ * This function runs in O(1)
+ */
+Vector<int> numaNodeCpus(int node);
+
+/**
+ * Pin the calling thread to the cpus of a node it is allowed to run on and remember the node for currentNumaNode
+ * @param node
+ * @return whether the thread was pinned
+ *
+ * This function runs in O(c) for c cpus
+ */
+bool pinThreadToNode(int node);
+
+/**
+ * The node the calling thread was pinned to, or otherwise the node of the cpu it is running on
+ * @return node from 0 to numaNodeCount() - 1
+ *
+ * This function runs in O(1)
+ */
+int currentNumaNode();
+
+/**
+ * Copy bytes into a new block whose pages are first touched by a thread pinned to the given node, so they are
+ * allocated on that node
+ * @param source bytes, size, node and whether to use huge pages
+ * @return block holding the copy
+ *
+ * This function runs in O(n) for n bytes
+ */
+LargeBlock replicateOnNode(const unsigned char *source, size_t bytes, int node, bool hugePages);
+
+/**
+ * Time random 8-byte reads from a block, counting data TLB misses with perf_event_open where the kernel allows it
+ * @param block size in bytes, whether to use huge pages and number of reads
+ * @return timing and miss count
+ *
+ * This function runs in O(n + r) for n bytes and r reads
+ */
+PlacementBenchmark benchmarkRandomReads(size_t bytes, bool hugePages, long reads);
+
+/**
+ * Print a comparison of two benchmarks, normally ordinary pages against huge pages
+ * @param output stream, baseline and candidate
+ *
+ * This function runs in O(1)
+ */
+void printPlacementBenchmark(std::ostream &out, const PlacementBenchmark &baseline,
+                             const PlacementBenchmark &candidate);
@@ -0,0 +1,104 @@
+/*
+ * This file contains the implementation of portfolio solving, which races several engines on the same problem and
+ * keeps the first verified result
+ */
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "portfolio.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static mutex winCountsLock;
+static Map<string, int> winCounts;
+
+/* This function takes in the opponent king location, pieces and engines to race. Each engine runs on its own thread
+ * with its own board. The first engine whose result passes verifyStalemate claims the win and sets the shared
+ * cancellation flag, which the other engines notice at their next search node and give up. Results that are not
+ * verified never cancel the race, so a fast wrong answer cannot beat a slower correct one.
+ */
+PortfolioResult solvePortfolio(GridLocation kingLoc, Vector<char> pieces, Vector<Engine> engines) {
+    PortfolioResult portfolio;
+    if (engines.isEmpty()) {
+        return portfolio;
+    }
+    atomic<bool> cancel(false);
+    atomic<int> winner(-1);
+    Vector<EngineRun> runs(engines.size());
+    vector<thread> workers;
+
+    auto start = chrono::steady_clock::now();
+    for (int e = 0; e < engines.size(); e++) {
+        workers.emplace_back([&, e]() {
+            EngineRun run = runEngine(engines[e], kingLoc, pieces, 1, &cancel);
+            int none = -1;
+            if (run.verified && winner.compare_exchange_strong(none, e)) {
+                cancel = true;
+            }
+            runs[e] = run;
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    portfolio.micros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+    int index = winner.load();
+    if (index == -1) {
+        portfolio.result = runs[0].result;
+        return portfolio;
+    }
+    portfolio.result = runs[index].result;
+    portfolio.solved = true;
+    portfolio.winner = engines[index].name;
+    lock_guard<mutex> lock(winCountsLock);
+    winCounts[portfolio.winner]++;
+    return portfolio;
+}
+
+/* This function returns a copy of the number of races each engine has won.
+ */
+Map<string, int> portfolioWinCounts() {
+    lock_guard<mutex> lock(winCountsLock);
+    return winCounts;
+}
+
+/* This function resets the number of races each engine has won.
+ */
+void resetPortfolioWinCounts() {
+    lock_guard<mutex> lock(winCountsLock);
+    winCounts.clear();
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("solvePortfolio returns a verified result and counts the win") {
+    resetPortfolioWinCounts();
+    GridLocation kingLoc = GridLocation(2, 1);
+    Vector<char> pieces = {'K', 'H', 'B', 'Q', 'R', 'Q', 'Q', 'Q', 'H', 'H', 'H'};
+    PortfolioResult portfolio = solvePortfolio(kingLoc, pieces);
+    EXPECT(portfolio.solved);
+    EXPECT(verifyStalemate(kingLoc, pieces, portfolio.result));
+    EXPECT_NO_ERROR(findEngine(portfolio.winner));
+
+    Map<string, int> wins = portfolioWinCounts();
+    EXPECT_EQUAL(wins.size(), 1);
+    EXPECT_EQUAL(wins[portfolio.winner], 1);
+}
+
+PROVIDED_TEST("solvePortfolio over a corpus") {
+    resetPortfolioWinCounts();
+    int solved = 0;
+    for (const Problem &problem : generateCorpus(77, 20, 8)) {
+        solved += solvePortfolio(problem.kingLoc, problem.pieces).solved;
+    }
+    Map<string, int> winCounts = portfolioWinCounts();
+    int wins = 0;
+    for (const string &name : winCounts) {
+        wins += winCounts[name];
+    }
+    EXPECT_EQUAL(wins, solved);
+    cout << "Portfolio wins " << winCounts << endl;
+}
@@ -0,0 +1,43 @@
+/*
+ * This file contains the declarations for portfolio solving, which races several engines on the same problem and
+ * keeps the first verified result
+ */
+#pragma once
+
+#include <string>
+#include "map.h"
+#include "vector.h"
+#include "engines.h"
+
+/** Outcome of a portfolio race
+ */
+struct PortfolioResult {
+    Map<char, Vector<GridLocation>> result;
+    bool solved = false;    // some engine returned a verified stalemate
+    std::string winner;     // name of the engine whose result was used, empty if none was verified
+    double micros = 0;      // wall time of the whole race including cancelled engines winding down
+};
+
+/**
+ * Race engines on a problem, one thread per engine; the first verified result cancels the others
+ * @param opponent king location, pieces, and engines to race
+ * @return the winning result, or the first engine's result if no engine was verified
+ *
+ * This function runs in the time of the fastest engine plus the time for the others to notice cancellation
+ */
+PortfolioResult solvePortfolio(GridLocation kingLoc, Vector<char> pieces, Vector<Engine> engines = registeredEngines());
+
+/**
+ * Number of races each engine has won since the counts were last reset
+ * @return map of engine names to wins
+ *
+ * This function runs in O(n) for n engines
+ */
+Map<std::string, int> portfolioWinCounts();
+
+/**
+ * Reset the portfolio win counts
+ *
+ * This function runs in O(1)
+ */
+void resetPortfolioWinCounts();
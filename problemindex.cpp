@@ -0,0 +1,265 @@
+/*
+ * This file contains the implementation of the problem index, a dense numbering of every problem up to symmetry: a
+ * canonical king square and the counts of queens, rooks, bishops and knights next to the white king
+ */
+#include <algorithm>
+#include <chrono>
+#include "problemindex.h"
+#include "error.h"
+#include "strlib.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kTableRows = kMaxIndexPieces + 5;
+
+/** Binomial coefficients C(n, k) for k up to 4, a row per k so each row is increasing in n
+ */
+struct BinomialTable {
+    long values[5][kTableRows];
+};
+
+/* This function builds the binomial table with Pascal's rule.
+ */
+static BinomialTable buildBinomials() {
+    BinomialTable table = {};
+    for (int n = 0; n < kTableRows; n++) {
+        table.values[0][n] = 1;
+        for (int k = 1; k <= 4; k++) {
+            table.values[k][n] = n == 0 ? 0 : table.values[k][n - 1] + table.values[k - 1][n - 1];
+        }
+    }
+    return table;
+}
+
+static const BinomialTable kBinomials = buildBinomials();
+
+/* This function takes in a key and fills in its combination, the positions of the three bars and the end marker when
+ * the counts are written as stars and bars.
+ */
+static void keyCombination(const ProblemKey &key, int combination[4]) {
+    combination[0] = key.queens;
+    combination[1] = combination[0] + key.rooks + 1;
+    combination[2] = combination[1] + key.bishops + 1;
+    combination[3] = combination[2] + key.knights + 1;
+}
+
+/* This function takes in a combination and sets the counts of a key from it.
+ */
+static void combinationKey(const int combination[4], ProblemKey &key) {
+    key.queens = combination[0];
+    key.rooks = combination[1] - combination[0] - 1;
+    key.bishops = combination[2] - combination[1] - 1;
+    key.knights = combination[3] - combination[2] - 1;
+}
+
+ProblemIndex::ProblemIndex(int maxPieces) {
+    if (maxPieces < 0 || maxPieces > kMaxIndexPieces) {
+        error("ProblemIndex supports 0 to " + integerToString(kMaxIndexPieces) + " pieces");
+    }
+    _maxPieces = maxPieces;
+    _perKing = kBinomials.values[4][maxPieces + 4];
+}
+
+long ProblemIndex::size() const {
+    return kNumCanonicalKings * _perKing;
+}
+
+/* This function takes in a key and returns the king's block start plus the combination's rank, the sum of C(c_i, i).
+ */
+long ProblemIndex::rank(const ProblemKey &key) const {
+    if (key.king < 0 || key.king >= kNumCanonicalKings || key.queens < 0 || key.rooks < 0 || key.bishops < 0
+            || key.knights < 0 || key.queens + key.rooks + key.bishops + key.knights > _maxPieces) {
+        error("Problem key outside the index");
+    }
+    int combination[4];
+    keyCombination(key, combination);
+    long rank = key.king * _perKing;
+    for (int i = 0; i < 4; i++) {
+        rank += kBinomials.values[i + 1][combination[i]];
+    }
+    return rank;
+}
+
+/* This function takes in the opponent king location and pieces and counts the pieces by type to rank the problem.
+ */
+long ProblemIndex::rank(GridLocation kingLoc, const Vector<char> &pieces) const {
+    ProblemKey key;
+    key.king = canonicalKingIndex(transformLoc(kingLoc, canonicalSymmetry(kingLoc)));
+    int kings = 0;
+    for (char piece : pieces) {
+        switch (piece) {
+            case 'K': kings++; break;
+            case 'Q': key.queens++; break;
+            case 'R': key.rooks++; break;
+            case 'B': key.bishops++; break;
+            case 'H': key.knights++; break;
+            default: return -1;
+        }
+    }
+    if (kings != 1 || pieces.size() - 1 > _maxPieces) {
+        return -1;
+    }
+    return rank(key);
+}
+
+/* This function takes in a rank, splits off the king's block and recovers the combination from the largest position
+ * down: each position is the largest c below the next one with C(c, i) at most what is left of the rank, found by
+ * binary search in the table's increasing row.
+ */
+ProblemKey ProblemIndex::unrank(long rank) const {
+    if (rank < 0 || rank >= size()) {
+        error("Rank outside the index");
+    }
+    ProblemKey key;
+    key.king = rank / _perKing;
+    rank %= _perKing;
+    int combination[4];
+    int limit = _maxPieces + 4;
+    for (int i = 3; i >= 0; i--) {
+        const long *row = kBinomials.values[i + 1];
+        int position = int(upper_bound(row, row + limit, rank) - row) - 1;
+        combination[i] = position;
+        rank -= row[position];
+        limit = position;
+    }
+    combinationKey(combination, key);
+    return key;
+}
+
+/* This function takes in a rank and builds its problem, with the white king first and then the other pieces by type.
+ */
+Problem ProblemIndex::problem(long rank) const {
+    ProblemKey key = unrank(rank);
+    Problem problem;
+    problem.kingLoc = canonicalKingSquare(key.king);
+    problem.pieces.add('K');
+    for (int i = 0; i < key.queens; i++) {
+        problem.pieces.add('Q');
+    }
+    for (int i = 0; i < key.rooks; i++) {
+        problem.pieces.add('R');
+    }
+    for (int i = 0; i < key.bishops; i++) {
+        problem.pieces.add('B');
+    }
+    for (int i = 0; i < key.knights; i++) {
+        problem.pieces.add('H');
+    }
+    return problem;
+}
+
+RankRange ProblemIndex::shard(int index, int count) const {
+    return {size() * index / count, size() * (index + 1) / count};
+}
+
+/* This function takes in a key and moves it to the next rank. The next combination in colexicographic order raises the
+ * lowest position that has room below the next one and resets the positions under it to 0, 1, 2; after the last
+ * combination of a king comes the first of the next king.
+ */
+bool ProblemIndex::next(ProblemKey &key) const {
+    int combination[4];
+    keyCombination(key, combination);
+    for (int i = 0; i < 4; i++) {
+        int bound = i < 3 ? combination[i + 1] : _maxPieces + 4;
+        if (combination[i] + 1 < bound) {
+            combination[i]++;
+            for (int j = 0; j < i; j++) {
+                combination[j] = j;
+            }
+            combinationKey(combination, key);
+            return true;
+        }
+    }
+    if (key.king + 1 >= kNumCanonicalKings) {
+        return false;
+    }
+    int king = key.king + 1;
+    key = ProblemKey();
+    key.king = king;
+    return true;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Ranking and unranking are inverse") {
+    ProblemIndex index(6);
+    EXPECT_EQUAL(index.size(), 10L * 210);
+    ProblemKey key;
+    for (long rank = 0; rank < index.size(); rank++) {
+        ProblemKey unranked = index.unrank(rank);
+        EXPECT_EQUAL(index.rank(unranked), rank);
+        EXPECT_EQUAL(unranked.king, key.king);
+        EXPECT_EQUAL(unranked.queens, key.queens);
+        EXPECT_EQUAL(unranked.rooks, key.rooks);
+        EXPECT_EQUAL(unranked.bishops, key.bishops);
+        EXPECT_EQUAL(unranked.knights, key.knights);
+        Problem problem = index.problem(rank);
+        EXPECT_EQUAL(index.rank(problem.kingLoc, problem.pieces), rank);
+        EXPECT_EQUAL(index.next(key), rank + 1 < index.size());
+    }
+    EXPECT_ERROR(index.unrank(index.size()));
+    EXPECT_ERROR(index.unrank(-1));
+    ProblemKey tooMany;
+    tooMany.knights = 7;
+    EXPECT_ERROR(index.rank(tooMany));
+    EXPECT_EQUAL(ProblemIndex(10).size(), 10L * 1001);
+    EXPECT_EQUAL(ProblemIndex(0).size(), 10L);
+}
+
+PROVIDED_TEST("Problems equal up to symmetry and order share a rank") {
+    ProblemIndex index(10);
+    for (const Problem &problem : generateCorpus(900, 50, 10)) {
+        long rank = index.rank(problem.kingLoc, problem.pieces);
+        EXPECT(rank >= 0 && rank < index.size());
+        Vector<char> reversed = problem.pieces;
+        reversed.reverse();
+        for (int symmetry = 0; symmetry < kNumSymmetries; symmetry++) {
+            EXPECT_EQUAL(index.rank(transformLoc(problem.kingLoc, symmetry), reversed), rank);
+        }
+        EXPECT_EQUAL(canonicalKey(index.problem(rank).kingLoc, index.problem(rank).pieces),
+                     canonicalKey(problem.kingLoc, problem.pieces));
+    }
+    EXPECT_EQUAL(index.rank(GridLocation(2, 2), {'K', 'K', 'Q'}), -1);
+    EXPECT_EQUAL(index.rank(GridLocation(2, 2), {'Q', 'R'}), -1);
+    EXPECT_EQUAL(index.rank(GridLocation(2, 2), Vector<char>(12, 'K')), -1);
+    EXPECT_EQUAL(ProblemIndex(3).rank(GridLocation(2, 2), {'K', 'Q', 'Q', 'Q', 'Q'}), -1);
+}
+
+PROVIDED_TEST("Shards cover the index and rank in constant time") {
+    ProblemIndex index(20);
+    long covered = 0;
+    for (int shard = 0; shard < 7; shard++) {
+        RankRange range = index.shard(shard, 7);
+        EXPECT_EQUAL(range.begin, covered);
+        ProblemKey key = index.unrank(range.begin);
+        for (long rank = range.begin + 1; rank < range.end; rank++) {
+            EXPECT(index.next(key));
+            EXPECT_EQUAL(index.rank(key), rank);
+        }
+        covered = range.end;
+    }
+    EXPECT_EQUAL(covered, index.size());
+
+    Vector<char> seen(index.size(), 0);
+    Vector<Problem> problems = generateCorpus(901, 1000, 20);
+    auto start = chrono::steady_clock::now();
+    long total = 0;
+    for (int round = 0; round < 100; round++) {
+        for (long rank = 0; rank < 1000; rank++) {
+            total += index.rank(index.unrank(rank * 97 % index.size()));
+        }
+    }
+    double nanos = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / 100000;
+    for (const Problem &problem : problems) {
+        seen[index.rank(problem.kingLoc, problem.pieces)] = 1;
+    }
+    int distinct = 0;
+    for (char flag : seen) {
+        distinct += flag;
+    }
+    cout << index.size() << " problems up to 20 pieces; unrank and rank " << nanos << " ns; " << distinct
+         << " distinct problems among " << problems.size() << endl;
+    EXPECT(total > 0);
+}
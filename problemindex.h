@@ -0,0 +1,111 @@
+/*
+ * This file contains the declarations for the problem index, a dense numbering of every problem up to symmetry: a
+ * canonical king square and the counts of queens, rooks, bishops and knights next to the white king
+ */
+#pragma once
+
+#include "vector.h"
+#include "engines.h"
+#include "martin.h"
+
+/** Largest number of pieces besides the white king a ProblemIndex accepts
+ */
+const int kMaxIndexPieces = 59;
+
+/** A problem in the index's terms: canonical king square and the count of each piece type besides the white king
+ */
+struct ProblemKey {
+    int king = 0;       // canonical king index, see canonicalKingIndex
+    int queens = 0;
+    int rooks = 0;
+    int bishops = 0;
+    int knights = 0;
+};
+
+/** Half-open range of ranks [begin, end)
+ */
+struct RankRange {
+    long begin;
+    long end;
+};
+
+/** Ranks every problem with one white king and at most maxPieces other pieces to a number from 0 to size() - 1. The
+ * counts (q, r, b, h) are the 4-combination q < q + r + 1 < q + r + b + 2 < q + r + b + h + 3 of 0 .. maxPieces + 3,
+ * ranked in the combinatorial number system, and the king index selects a block of C(maxPieces + 4, 4) ranks
+ */
+class ProblemIndex {
+public:
+    /**
+     * Index the problems with up to a number of pieces besides the white king
+     * @param maximum number of queens, rooks, bishops and knights together, from 0 to kMaxIndexPieces
+     *
+     * This function runs in O(1)
+     */
+    ProblemIndex(int maxPieces);
+
+    /**
+     * Number of problems indexed
+     * @return 10 * C(maxPieces + 4, 4)
+     *
+     * This function runs in O(1)
+     */
+    long size() const;
+
+    /**
+     * Rank of a key
+     * @param key, raising an error if it is outside the index
+     * @return rank
+     *
+     * This function runs in O(1)
+     */
+    long rank(const ProblemKey &key) const;
+
+    /**
+     * Rank of a problem after putting it in canonical form
+     * @param opponent king location and pieces
+     * @return rank, or -1 if the problem does not have exactly one white king or has too many pieces
+     *
+     * This function runs in O(n) for n pieces
+     */
+    long rank(GridLocation kingLoc, const Vector<char> &pieces) const;
+
+    /**
+     * Key with a given rank
+     * @param rank, raising an error if it is outside the index
+     * @return key
+     *
+     * This function runs in O(log m) for m the maximum number of pieces
+     */
+    ProblemKey unrank(long rank) const;
+
+    /**
+     * Problem with a given rank, the king on its canonical square and the pieces with the white king at the front
+     * @param rank
+     * @return problem
+     *
+     * This function runs in O(m log m) for m the maximum number of pieces
+     */
+    Problem problem(long rank) const;
+
+    /**
+     * Split the ranks into contiguous shards of nearly equal size
+     * @param shard number and number of shards
+     * @return the shard's ranks
+     *
+     * This function runs in O(1)
+     */
+    RankRange shard(int index, int count) const;
+
+    /**
+     * Move a key to the next rank without unranking
+     * @param key, moved in place
+     * @return false if the key had the last rank
+     *
+     * This function runs in O(1)
+     */
+    bool next(ProblemKey &key) const;
+
+private:
+    int _maxPieces;
+    long _perKing;
+};
@@ -0,0 +1,278 @@
+/*
+ * This file contains the implementation of the built-in sampling profiler: the annotation stack the solvers keep of
+ * their current phase and search depth, and a CPU-time timer that samples it and writes folded stacks
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <csignal>
+#include <ctime>
+#endif
+#include "profiler.h"
+#include "engines.h"
+#include "strlib.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/** The phases of one thread, written only by that thread and read by the signal handler when it interrupts the thread
+ */
+struct AnnotationStack {
+    const char *names[kMaxProfileFrames];
+    int depths[kMaxProfileFrames];
+    int size = 0;       // phases pushed, which may pass kMaxProfileFrames
+};
+
+/** A copy of the interrupted thread's annotation stack
+ */
+struct ProfileSample {
+    int size = 0;
+    const char *names[kMaxProfileFrames];
+    int depths[kMaxProfileFrames];
+};
+
+static thread_local AnnotationStack annotations;
+static vector<ProfileSample> samples;          // allocated before a session so the handler never allocates
+static atomic<long> samplesClaimed(0);         // slots handed out, which may pass samples.size()
+static atomic<int> handlersRunning(0);         // handlers between their first check of sampling and their return
+static atomic<bool> sampling(false);
+static mutex sessionLock;
+static bool sessionRunning = false;
+static chrono::steady_clock::time_point sessionStart;
+#ifdef __linux__
+static timer_t sessionTimer;
+static struct sigaction previousAction;
+#endif
+
+/* This function pushes a phase. The name and depth are stored before the size grows, with a signal fence between so
+ * the compiler cannot reorder them, since the handler that may interrupt the thread reads only below the size.
+ */
+ProfilePhase::ProfilePhase(const char *name) {
+    int size = annotations.size;
+    if (size < kMaxProfileFrames) {
+        annotations.names[size] = name;
+        annotations.depths[size] = -1;
+    }
+    atomic_signal_fence(memory_order_release);
+    annotations.size = size + 1;
+}
+
+ProfilePhase::~ProfilePhase() {
+    atomic_signal_fence(memory_order_release);
+    annotations.size--;
+}
+
+void profileDepth(int depth) {
+    int top = annotations.size - 1;
+    if (top >= 0 && top < kMaxProfileFrames) {
+        annotations.depths[top] = depth;
+    }
+}
+
+/* This function takes in a name and returns its copy in a set that is never cleared, so the pointer stays valid.
+ */
+const char *profileName(const string &name) {
+    static mutex namesLock;
+    static set<string> names;
+    lock_guard<mutex> lock(namesLock);
+    return names.insert(name).first->c_str();
+}
+
+/* This function is the SIGPROF handler. It runs on the thread that was using the CPU, claims a slot with one atomic
+ * add and copies that thread's annotation stack into it, so it takes no locks and allocates nothing. It counts itself
+ * running before it checks sampling, so once stopProfiler has cleared sampling and seen no handler running, no
+ * handler can still touch the slots.
+ */
+static void takeSample(int) {
+    handlersRunning.fetch_add(1);
+    if (sampling.load()) {
+        long slot = samplesClaimed.fetch_add(1, memory_order_relaxed);
+        if (slot < long(samples.size())) {
+            ProfileSample &sample = samples[slot];
+            int size = min(annotations.size, kMaxProfileFrames);
+            atomic_signal_fence(memory_order_acquire);
+            for (int i = 0; i < size; i++) {
+                sample.names[i] = annotations.names[i];
+                sample.depths[i] = annotations.depths[i];
+            }
+            sample.size = size;
+        }
+    }
+    handlersRunning.fetch_sub(1, memory_order_release);
+}
+
+/* This function takes in the options and starts a session: the sample slots are allocated, the handler installed and
+ * a timer on the process's CPU clock armed to send SIGPROF every 1 / hertz seconds of CPU time. The kernel checks CPU
+ * timers on its scheduler tick, so the rate reached is at most the tick rate.
+ */
+bool startProfiler(ProfileOptions options) {
+#ifdef __linux__
+    lock_guard<mutex> lock(sessionLock);
+    if (sessionRunning || options.hertz <= 0) {
+        return false;
+    }
+    samples.assign(max(options.maxSamples, 1), ProfileSample());
+    samplesClaimed.store(0);
+    struct sigaction action = {};
+    action.sa_handler = takeSample;
+    action.sa_flags = SA_RESTART;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGPROF, &action, &previousAction) != 0) {
+        return false;
+    }
+    struct sigevent event = {};
+    event.sigev_notify = SIGEV_SIGNAL;
+    event.sigev_signo = SIGPROF;
+    if (timer_create(CLOCK_PROCESS_CPUTIME_ID, &event, &sessionTimer) != 0) {
+        sigaction(SIGPROF, &previousAction, nullptr);
+        return false;
+    }
+    long interval = 1000000000L / options.hertz;
+    struct itimerspec spec = {};
+    spec.it_interval.tv_sec = interval / 1000000000L;
+    spec.it_interval.tv_nsec = interval % 1000000000L;
+    spec.it_value = spec.it_interval;
+    sampling.store(true);
+    sessionStart = chrono::steady_clock::now();
+    timer_settime(sessionTimer, 0, &spec, nullptr);
+    sessionRunning = true;
+    return true;
+#else
+    (void) options;
+    return false;
+#endif
+}
+
+/* This function takes in a sample and returns its stack as folded frames: each phase's name followed by its depth
+ * when one was set, outermost first.
+ */
+static string foldSample(const ProfileSample &sample) {
+    if (sample.size == 0) {
+        return "(unannotated)";
+    }
+    ostringstream frames;
+    for (int i = 0; i < sample.size; i++) {
+        frames << (i ? ";" : "") << sample.names[i];
+        if (sample.depths[i] >= 0) {
+            frames << ";depth=" << sample.depths[i];
+        }
+    }
+    return frames.str();
+}
+
+/* This function stops the session. The timer is deleted and the handler disabled before SIGPROF is ignored and the
+ * previous handler put back, so a signal still pending is harmless. It then waits until no handler is running on any
+ * thread, after which none can claim a slot, and only then reads and frees the samples.
+ */
+ProfileReport stopProfiler() {
+    ProfileReport report;
+#ifdef __linux__
+    lock_guard<mutex> lock(sessionLock);
+    if (!sessionRunning) {
+        return report;
+    }
+    timer_delete(sessionTimer);
+    sampling.store(false);
+    struct sigaction ignore = {};
+    ignore.sa_handler = SIG_IGN;
+    sigemptyset(&ignore.sa_mask);
+    sigaction(SIGPROF, &ignore, nullptr);
+    sigaction(SIGPROF, &previousAction, nullptr);
+    sessionRunning = false;
+    report.seconds = chrono::duration<double>(chrono::steady_clock::now() - sessionStart).count();
+
+    while (handlersRunning.load(memory_order_acquire) > 0) {
+        this_thread::yield();
+    }
+    long taken = min(samplesClaimed.load(), long(samples.size()));
+    report.samples = taken;
+    report.dropped = samplesClaimed.load() - taken;
+    for (long i = 0; i < taken; i++) {
+        report.stacks[foldSample(samples[i])]++;
+    }
+    samples = vector<ProfileSample>();
+#endif
+    return report;
+}
+
+void writeFoldedStacks(const ProfileReport &report, ostream &out) {
+    for (const string &stack : report.stacks) {
+        out << stack << " " << report.stacks.get(stack) << "\n";
+    }
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Annotation stack nests phases and depths") {
+    EXPECT(profileName("sat") == profileName(string("s") + "at"));
+    EXPECT(startProfiler(ProfileOptions()));
+    EXPECT(!startProfiler(ProfileOptions()));
+    {
+        ProfilePhase outer("outer");
+        volatile long sink = 0;
+        for (int depth = 0; depth < 3; depth++) {
+            ProfilePhase inner("inner");
+            profileDepth(depth);
+            auto start = chrono::steady_clock::now();
+            while (chrono::steady_clock::now() - start < chrono::milliseconds(60)) {
+                sink = sink + 1;
+            }
+        }
+    }
+    ProfileReport report = stopProfiler();
+    ostringstream folded;
+    writeFoldedStacks(report, folded);
+    cout << folded.str();
+    // how many samples land in each phase depends on the kernel's tick rate, so only their stacks are checked
+    EXPECT(report.samples > 0);
+    EXPECT_EQUAL(report.dropped, 0);
+    for (const string &stack : report.stacks) {
+        EXPECT(stack == "(unannotated)" || stack == "outer" || stack == "outer;inner"
+               || startsWith(stack, "outer;inner;depth="));
+    }
+    EXPECT_EQUAL(stopProfiler().samples, 0);
+}
+
+PROVIDED_TEST("Profiler overhead at 1 kHz") {
+    Vector<Problem> problems = generateCorpus(990, 60, 10);
+    auto solveAll = [&]() {
+        auto start = chrono::steady_clock::now();
+        for (const Problem &problem : problems) {
+            runEngine(findEngine("sat"), problem.kingLoc, problem.pieces, 1, nullptr, 20000);
+        }
+        return chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+    };
+    solveAll();
+    double plain = 0;
+    double profiled = 0;
+    ProfileReport report;
+    for (int round = 0; round < 3; round++) {
+        double micros = solveAll();
+        plain = round == 0 ? micros : min(plain, micros);
+        startProfiler(ProfileOptions());
+        micros = solveAll();
+        ProfileReport session = stopProfiler();
+        if (round == 0 || micros < profiled) {
+            profiled = micros;
+            report = session;
+        }
+    }
+    double overhead = profiled / plain - 1;
+    long sat = 0;
+    for (const string &stack : report.stacks) {
+        if (stack == "sat" || startsWith(stack, "sat;")) {
+            sat += report.stacks.get(stack);
+        }
+    }
+    cout << "Unprofiled " << plain / 1000 << " ms, profiled " << profiled / 1000 << " ms (" << overhead * 100
+         << "% overhead), " << report.samples << " samples in " << report.stacks.size() << " stacks, " << sat
+         << " in the sat engine" << endl;
+    EXPECT(report.samples > 0);
+    clearBoard();
+}
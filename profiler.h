@@ -0,0 +1,97 @@
+/*
+ * This file contains the declarations for the built-in sampling profiler: the annotation stack the solvers keep of
+ * their current phase and search depth, and a CPU-time timer that samples it and writes folded stacks
+ */
+#pragma once
+
+#include <iostream>
+#include <string>
+#include "map.h"
+
+/** Deepest annotation stack a sample records; deeper phases are counted but not recorded
+ */
+const int kMaxProfileFrames = 16;
+
+/** Settings of a profiling session
+ */
+struct ProfileOptions {
+    int hertz = 1000;               // samples per second of process CPU time
+    int maxSamples = 1 << 18;       // samples kept; later ones are counted as dropped
+};
+
+/** What a profiling session saw: each distinct annotation stack with the number of samples that found it
+ */
+struct ProfileReport {
+    long samples = 0;
+    long dropped = 0;
+    double seconds = 0;             // wall time the session ran for
+    Map<std::string, long> stacks;  // frames joined by ';', outermost first
+};
+
+/** A phase of the current thread's work, pushed on its annotation stack for as long as the object lives. Pushing and
+ * popping are a few stores with no locks or atomics, so a phase costs almost nothing when the profiler is off
+ */
+class ProfilePhase {
+public:
+    /**
+     * Push a phase
+     * @param name, which has to stay valid for the rest of the program, such as a literal or a profileName result
+     *
+     * This function runs in O(1)
+     */
+    ProfilePhase(const char *name);
+
+    /**
+     * Pop the phase
+     *
+     * This function runs in O(1)
+     */
+    ~ProfilePhase();
+
+    ProfilePhase(const ProfilePhase &) = delete;
+    ProfilePhase &operator=(const ProfilePhase &) = delete;
+};
+
+/**
+ * Set the search depth of the current thread's innermost phase, recorded with it in every sample
+ * @param depth, or -1 for none
+ *
+ * This function runs in O(1)
+ */
+void profileDepth(int depth);
+
+/**
+ * A name that stays valid for the rest of the program, for phases named at run time such as engines
+ * @param name
+ * @return the same pointer for every call with equal names
+ *
+ * This function runs in O(log n) for n names
+ */
+const char *profileName(const std::string &name);
+
+/**
+ * Start sampling every thread's annotation stack on a timer of process CPU time, with SIGPROF delivered to the thread
+ * that was running. The rate is capped by the kernel's scheduler tick, commonly 250 or 1000 Hz. Only one session runs
+ * at a time
+ * @param options
+ * @return false if a session is already running or the platform has no CPU-time timers
+ *
+ * This function runs in O(s) for s samples to allocate
+ */
+bool startProfiler(ProfileOptions options = ProfileOptions());
+
+/**
+ * Stop the session and count the samples by annotation stack
+ * @return the report, empty if no session was running
+ *
+ * This function runs in O(s f log k) for s samples of f frames and k distinct stacks
+ */
+ProfileReport stopProfiler();
+
+/**
+ * Write a report as folded stacks, one line per stack with its sample count, as flame graph tools read them
+ * @param report and output stream
+ *
+ * This function runs in O(k f) for k stacks of f frames
+ */
+void writeFoldedStacks(const ProfileReport &report, std::ostream &out);
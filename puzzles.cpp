@@ -0,0 +1,436 @@
+/*
+ * This file contains the implementation of the puzzle generator, which proposes problems with some pieces already on
+ * the board and keeps those whose remaining pieces can be placed in exactly one way
+ */
+#include <chrono>
+#include <random>
+#include <thread>
+#include "puzzles.h"
+#include "engines.h"
+#include "error.h"
+#include "pieces.h"
+#include "sampler.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const string kBuildPieces = "QRBH";  // pieces a random stalemate is built from
+static const int kBuildTries = 400;     // random squares tried while building a stalemate
+
+/* This function takes in the opponent king location, clears the board and works out, for every piece descriptor and
+ * square, which neighbourhood squares the piece would attack on an empty board. Blocking only takes attacks away, so
+ * these masks bound what a piece can still add.
+ */
+PuzzleCounter::PuzzleCounter(GridLocation kingLoc) {
+    _kingLoc = kingLoc;
+    int kingSquare = kingLoc.row * 8 + kingLoc.col;
+    _kingBit = uint64_t(1) << kingSquare;
+    _neighbourhood = attackMask('K', kingSquare, 0) | _kingBit;
+    const Vector<PieceDescriptor> &descriptors = pieceDescriptors();
+    _reach.assign(descriptors.size() * 64, 0);
+    for (int type = 0; type < descriptors.size(); type++) {
+        for (int square = 0; square < 64; square++) {
+            _reach[type * 64 + square] = attackMask(descriptors[type].symbol, square, 0) & _neighbourhood & ~_kingBit;
+        }
+    }
+    clearBoard();
+    _board[kingLoc] = 'K';
+    _attacks.reset(kingLoc, _given);
+}
+
+void PuzzleCounter::give(char piece, GridLocation loc) {
+    _board[loc] = piece;
+    _attacks.place(piece, loc);
+    _given[piece].add(loc);
+}
+
+void PuzzleCounter::take(GridLocation loc) {
+    char piece = _board[loc];
+    _board[loc] = 'E';
+    _attacks.remove(loc);
+    Vector<GridLocation> &locs = _given[piece];
+    locs.remove(locs.indexOf(loc));
+    if (locs.isEmpty()) {
+        _given.remove(piece);
+    }
+}
+
+bool PuzzleCounter::isStalemate() const {
+    return _attacks.isStalemate();
+}
+
+/* This function takes in a piece and a location and checks the square is on the board, empty, outside the
+ * neighbourhood, and that the piece would not attack the king from it.
+ */
+bool PuzzleCounter::allowed(char piece, GridLocation loc) const {
+    if (loc.row < 0 || loc.row >= 8 || loc.col < 0 || loc.col >= 8) {
+        return false;
+    }
+    int square = loc.row * 8 + loc.col;
+    uint64_t bit = uint64_t(1) << square;
+    if ((_attacks.occupied() & bit) || (_neighbourhood & bit)) {
+        return false;
+    }
+    return !(attackMask(piece, square, _attacks.occupied() & ~_kingBit) & _kingBit);
+}
+
+/* This function takes in a square holding a piece and returns whether another piece on the board, the white king
+ * included, defends it: a leaper from its pattern, and a rider along a ray with nothing in between.
+ */
+bool PuzzleCounter::defended(int square) const {
+    uint64_t bit = uint64_t(1) << square;
+    uint64_t occupied = _attacks.occupied() & ~bit;
+    for (uint64_t pieces = occupied & ~_kingBit; pieces; pieces &= pieces - 1) {
+        int from = lowestSquare(pieces);
+        if (attackMask(_board[from / 8][from % 8], from, occupied) & bit) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* This function returns whether a rider on the board, such as a queen, rook or bishop, attacks the king through the
+ * pieces now on it.
+ */
+bool PuzzleCounter::inCheck() const {
+    uint64_t occupied = _attacks.occupied() & ~_kingBit;
+    for (uint64_t pieces = occupied; pieces; pieces &= pieces - 1) {
+        int square = lowestSquare(pieces);
+        char piece = _board[square / 8][square % 8];
+        if (isRider(piece) && (attackMask(piece, square, occupied) & _kingBit)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+const Map<char, Vector<GridLocation>> &PuzzleCounter::given() const {
+    return _given;
+}
+
+uint64_t PuzzleCounter::attacked() const {
+    return _attacks.attacked();
+}
+
+long PuzzleCounter::nodes() const {
+    return _nodes;
+}
+
+/* This function takes in pieces, checks each is a piece, sorts them so equal pieces are next to each other and counts
+ * the placements up to the limit, filling first with the first one found.
+ */
+int PuzzleCounter::count(Vector<char> pieces, int limit, Map<char, Vector<GridLocation>> &first) {
+    for (char piece : pieces) {
+        if (pieceIndex(piece) < 0) {
+            error("Invalid character representation of a piece");
+        }
+    }
+    pieces.sort();
+    _limit = limit;
+    _found = 0;
+    _first.clear();
+    Map<char, Vector<GridLocation>> placed;
+    if (limit > 0) {
+        countFrom(pieces, 0, 0, placed);
+    }
+    first = _first;
+    return _found;
+}
+
+/* This function takes in the pieces, the next one to place, the first square it may take so equal pieces take
+ * increasing squares, and the placement so far. Each free square, next to the king or not, is tried on the attack
+ * board and undone after the rest are counted; a leaper checking the king is skipped at once, while a rider's check is
+ * only ruled out when the board is full, since a later piece may block it. A full board counts when every empty square
+ * around the king is attacked and every piece next to the king is defended, as verifyStalemate judges it. Occupied
+ * squares are left out of the uncovered squares the last piece must attack, since another piece may defend them, and
+ * the search stops as soon as the limit is reached.
+ */
+void PuzzleCounter::countFrom(const Vector<char> &pieces, int next, int first,
+                              Map<char, Vector<GridLocation>> &placed) {
+    _nodes++;
+    uint64_t uncovered = _neighbourhood & ~_attacks.occupied() & ~_attacks.attacked();
+    if (next == pieces.size()) {
+        if (uncovered != 0 || inCheck()) {
+            return;
+        }
+        for (uint64_t near = _neighbourhood & _attacks.occupied() & ~_kingBit; near; near &= near - 1) {
+            if (!defended(lowestSquare(near))) {
+                return;
+            }
+        }
+        if (_found++ == 0) {
+            _first = placed;
+        }
+        return;
+    }
+    char piece = pieces[next];
+    const uint64_t *reach = &_reach[pieceIndex(piece) * 64];
+    bool last = next + 1 == pieces.size();
+    bool sameNext = !last && pieces[next + 1] == piece;
+    for (int square = first; square < 64 && _found < _limit; square++) {
+        if (last && (reach[square] & uncovered) != uncovered) {
+            continue;
+        }
+        GridLocation loc(square / 8, square % 8);
+        uint64_t bit = uint64_t(1) << square;
+        if ((_attacks.occupied() & bit) || (!isRider(piece) && (attackMask(piece, square, 0) & _kingBit))) {
+            continue;
+        }
+        _board[loc] = piece;
+        _attacks.place(piece, loc);
+        placed[piece].add(loc);
+        countFrom(pieces, next + 1, sameNext ? square + 1 : 0, placed);
+        placed[piece].removeBack();
+        if (placed[piece].isEmpty()) {
+            placed.remove(piece);
+        }
+        _attacks.remove(loc);
+        _board[loc] = 'E';
+    }
+}
+
+/* This function takes in a seed and a puzzle. It puts a random queen, rook, bishop or knight on a random allowed square
+ * whenever that covers a new square around a random king, until the king is stalemated, then adds the white king
+ * where the stalemate survives it. The pieces are then visited in random order: each is lifted off the counter's board
+ * and stays off if the lifted pieces still have exactly one placement, the count stopping at two, and is put back
+ * otherwise. Each edit moves one piece on the same counter, so no count rebuilds the board.
+ */
+bool generatePuzzle(uint64_t seed, Puzzle &puzzle) {
+    mt19937_64 random(seed);
+    int kingRow = random() % 8;
+    GridLocation kingLoc(kingRow, random() % 8);
+    PuzzleCounter counter(kingLoc);
+    Vector<char> pieces;
+    Vector<GridLocation> locs;
+    uint64_t around = attackMask('K', kingLoc.row * 8 + kingLoc.col, 0);
+    for (int tries = 0; tries < kBuildTries && !counter.isStalemate(); tries++) {
+        char piece = kBuildPieces[random() % 4];
+        int square = random() % 64;
+        GridLocation loc(square / 8, square % 8);
+        if (!counter.allowed(piece, loc)) {
+            continue;
+        }
+        uint64_t before = counter.attacked() & around;
+        counter.give(piece, loc);
+        if ((counter.attacked() & around) == before) {
+            counter.take(loc);
+            continue;
+        }
+        pieces.add(piece);
+        locs.add(loc);
+    }
+    if (!counter.isStalemate()) {
+        return false;
+    }
+    for (int tries = 0; tries < kBuildTries && !pieces.contains('K'); tries++) {
+        int square = random() % 64;
+        GridLocation loc(square / 8, square % 8);
+        if (!counter.allowed('K', loc)) {
+            continue;
+        }
+        counter.give('K', loc);
+        if (!counter.isStalemate()) {
+            counter.take(loc);
+            continue;
+        }
+        pieces.add('K');
+        locs.add(loc);
+    }
+    if (!pieces.contains('K')) {
+        return false;
+    }
+
+    Vector<int> order;
+    for (int i = 0; i < pieces.size(); i++) {
+        order.add(i);
+        swap(order[i], order[random() % (i + 1)]);
+    }
+    Vector<char> lifted;
+    Map<char, Vector<GridLocation>> solution;
+    for (int i : order) {
+        if (lifted.size() == kMaxPuzzlePieces) {
+            break;
+        }
+        counter.take(locs[i]);
+        lifted.add(pieces[i]);
+        Map<char, Vector<GridLocation>> first;
+        if (counter.count(lifted, 2, first) == 1) {
+            solution = first;
+        } else {
+            lifted.removeBack();
+            counter.give(pieces[i], locs[i]);
+        }
+    }
+    if (lifted.isEmpty()) {
+        return false;
+    }
+    puzzle.kingLoc = kingLoc;
+    puzzle.given = counter.given();
+    lifted.sort();
+    puzzle.pieces = lifted;
+    puzzle.solution = solution;
+    return true;
+}
+
+/* This function takes in a number of attempts, a seed and a number of threads. Each thread takes every p-th attempt on
+ * its own board and stores what it finds by attempt, and the puzzles are collected in attempt order afterwards.
+ */
+Vector<Puzzle> generatePuzzles(int attempts, uint64_t seed, int threads) {
+    Vector<Puzzle> found(attempts);
+    Vector<int> made(attempts, 0);
+    threads = max(1, min(threads, attempts));
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (int i = t; i < attempts; i += threads) {
+                made[i] = generatePuzzle(streamSeed(seed, i), found[i]);
+            }
+            clearBoard();
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    Vector<Puzzle> puzzles;
+    for (int i = 0; i < attempts; i++) {
+        if (made[i]) {
+            puzzles.add(found[i]);
+        }
+    }
+    return puzzles;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/* This function takes in a puzzle and returns its given pieces and solution together as one placement.
+ */
+static Map<char, Vector<GridLocation>> puzzleAnswer(const Puzzle &puzzle, Vector<char> &allPieces) {
+    Map<char, Vector<GridLocation>> answer = puzzle.given;
+    for (char piece : puzzle.solution) {
+        for (GridLocation loc : puzzle.solution.get(piece)) {
+            answer[piece].add(loc);
+        }
+    }
+    allPieces.clear();
+    for (char piece : answer) {
+        for (int i = 0; i < answer[piece].size(); i++) {
+            allPieces.add(piece);
+        }
+    }
+    return answer;
+}
+
+/* This function takes in the opponent king location, the given pieces, the sorted pieces to place, the next one to
+ * place, the first square it may take and the placement so far, and counts every placement verifyStalemate accepts
+ * by trying each square for each piece.
+ */
+static int countByRules(GridLocation kingLoc, const Map<char, Vector<GridLocation>> &given, const Vector<char> &pieces,
+                        int next, int first, Map<char, Vector<GridLocation>> &placed) {
+    if (next == pieces.size()) {
+        Map<char, Vector<GridLocation>> answer = given;
+        Vector<char> allPieces;
+        for (char piece : placed) {
+            for (GridLocation loc : placed[piece]) {
+                answer[piece].add(loc);
+            }
+        }
+        for (char piece : answer) {
+            for (int i = 0; i < answer[piece].size(); i++) {
+                allPieces.add(piece);
+            }
+        }
+        return verifyStalemate(kingLoc, allPieces, answer);
+    }
+    int count = 0;
+    bool sameNext = next + 1 < pieces.size() && pieces[next + 1] == pieces[next];
+    for (int square = first; square < 64; square++) {
+        placed[pieces[next]].add(GridLocation(square / 8, square % 8));
+        count += countByRules(kingLoc, given, pieces, next + 1, sameNext ? square + 1 : 0, placed);
+        placed[pieces[next]].removeBack();
+        if (placed[pieces[next]].isEmpty()) {
+            placed.remove(pieces[next]);
+        }
+    }
+    return count;
+}
+
+PROVIDED_TEST("Puzzle counter agrees with verifyStalemate") {
+    for (GridLocation kingLoc : {GridLocation(0, 0), GridLocation(2, 1)}) {
+        for (Vector<char> pieces : Vector<Vector<char>>({{'R', 'R'}, {'B', 'Q'}, {'H', 'R'}, {'K', 'R', 'R'}})) {
+            Map<char, Vector<GridLocation>> placed;
+            int expected = countByRules(kingLoc, {}, pieces, 0, 0, placed);
+            PuzzleCounter counter(kingLoc);
+            Map<char, Vector<GridLocation>> first;
+            EXPECT_EQUAL(counter.count(pieces, 1 << 30, first), expected);
+            EXPECT_EQUAL(counter.count(pieces, 2, first), min(expected, 2));
+            EXPECT(uint64_t(expected) >= SolutionSampler(kingLoc, pieces).count());
+        }
+    }
+    PuzzleCounter counter(GridLocation(0, 0));
+    counter.give('R', GridLocation(1, 7));
+    Map<char, Vector<GridLocation>> placed;
+    int expected = countByRules(GridLocation(0, 0), counter.given(), {'B', 'R'}, 0, 0, placed);
+    Map<char, Vector<GridLocation>> first;
+    EXPECT_EQUAL(counter.count({'B', 'R'}, 1 << 30, first), expected);
+    clearBoard();
+}
+
+PROVIDED_TEST("Puzzle counter with fairy pieces") {
+    PuzzleCounter counter(GridLocation(0, 0));
+    Map<char, Vector<GridLocation>> first;
+    EXPECT(counter.count({'C', 'C'}, 1 << 30, first) > 0);
+    EXPECT(verifyStalemate(GridLocation(0, 0), {'C', 'C'}, first));
+    EXPECT(counter.count({'M', 'A'}, 2, first) <= 2);
+    EXPECT_ERROR(counter.count({'X'}, 2, first));
+    clearBoard();
+}
+
+PROVIDED_TEST("Generated puzzles have one solution") {
+    Vector<Puzzle> puzzles = generatePuzzles(200, 93, 4);
+    EXPECT(puzzles.size() > 10);
+    for (const Puzzle &puzzle : puzzles) {
+        PuzzleCounter counter(puzzle.kingLoc);
+        for (char piece : puzzle.given) {
+            for (GridLocation loc : puzzle.given.get(piece)) {
+                counter.give(piece, loc);
+            }
+        }
+        Map<char, Vector<GridLocation>> first;
+        EXPECT_EQUAL(counter.count(puzzle.pieces, 3, first), 1);
+        Vector<char> allPieces;
+        Map<char, Vector<GridLocation>> answer = puzzleAnswer(puzzle, allPieces);
+        clearBoard();
+        _board[puzzle.kingLoc] = 'K';
+        EXPECT(verifyStalemate(puzzle.kingLoc, allPieces, answer));
+        EXPECT(allPieces.contains('K'));
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Puzzles do not depend on the number of threads") {
+    Vector<Puzzle> serial = generatePuzzles(40, 5, 1);
+    Vector<Puzzle> parallel = generatePuzzles(40, 5, 3);
+    EXPECT_EQUAL(serial.size(), parallel.size());
+    for (int i = 0; i < serial.size(); i++) {
+        EXPECT_EQUAL(serial[i].kingLoc, parallel[i].kingLoc);
+        EXPECT_EQUAL(serial[i].pieces, parallel[i].pieces);
+        EXPECT_EQUAL(serial[i].given, parallel[i].given);
+        EXPECT_EQUAL(serial[i].solution, parallel[i].solution);
+    }
+}
+
+PROVIDED_TEST("Puzzles generated per second") {
+    int threads = max(1, int(thread::hardware_concurrency()));
+    int attempts = 2000;
+    auto start = chrono::steady_clock::now();
+    Vector<Puzzle> puzzles = generatePuzzles(attempts, 2024, threads);
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    Map<int, int> bySize;
+    for (const Puzzle &puzzle : puzzles) {
+        bySize[puzzle.pieces.size()]++;
+    }
+    cout << puzzles.size() << " puzzles from " << attempts << " attempts on "
+         << threads << " threads: " << puzzles.size() / seconds << " puzzles per second, by pieces to place " << bySize
+         << endl;
+    EXPECT(!puzzles.isEmpty());
+}
@@ -0,0 +1,127 @@
+/*
+ * This file contains the declarations for the puzzle generator, which proposes problems with some pieces already on the
+ * board and keeps those whose remaining pieces can be placed in exactly one way
+ */
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include "map.h"
+#include "vector.h"
+#include "bitboard.h"
+#include "martin.h"
+
+/** Largest number of pieces a generated puzzle leaves for the solver to place
+ */
+const int kMaxPuzzlePieces = 3;
+
+/** A problem with a single answer: the opponent king, the pieces already placed, and the pieces to place. The answer
+ * is unique among every placement verifyStalemate accepts, including those with a defended piece next to the king
+ */
+struct Puzzle {
+    GridLocation kingLoc;
+    Map<char, Vector<GridLocation>> given;
+    Vector<char> pieces;
+    Map<char, Vector<GridLocation>> solution;   // the only placement of pieces that completes a stalemate
+};
+
+/** Counts the ways to finish a partly placed board. The pieces already placed live on an attack board that is updated
+ * piece by piece as the generator edits a candidate, so each count starts from the board the last edit left instead of
+ * rebuilding it. The given pieces stand outside the opponent king's neighbourhood, as the engines place them, while
+ * the counted pieces may also stand next to the king when another piece defends them. The counter uses the current
+ * thread's board
+ */
+class PuzzleCounter {
+public:
+    /**
+     * Clear the board and put the opponent king on it
+     * @param opponent king location
+     *
+     * This function runs in O(64)
+     */
+    PuzzleCounter(GridLocation kingLoc);
+
+    /**
+     * Place a piece before counting
+     * @param piece and an empty location outside the neighbourhood
+     *
+     * This function runs in O(s) for s sliders and kings on the board
+     */
+    void give(char piece, GridLocation loc);
+
+    /**
+     * Take a placed piece off the board
+     * @param location of a piece placed with give
+     *
+     * This function runs in O(s + n) for s sliders and kings and n placed pieces
+     */
+    void take(GridLocation loc);
+
+    /**
+     * Count the placements of pieces on the empty squares that complete a stalemate under the rules verifyStalemate
+     * checks, stopping at a limit
+     * @param pieces to place, limit, and map to fill with the first placement found
+     * @return number of placements, at most limit
+     *
+     * This function runs in O(64^n) for n pieces in the worst case
+     */
+    int count(Vector<char> pieces, int limit, Map<char, Vector<GridLocation>> &first);
+
+    /**
+     * Whether the placed pieces alone stalemate the king
+     * @return true if every square around the king is attacked and the king is not
+     *
+     * This function runs in O(1)
+     */
+    bool isStalemate() const;
+
+    /**
+     * Whether a piece could stand on a square: empty, outside the neighbourhood and not attacking the king
+     * @param piece and location
+     * @return true if the piece may be placed there
+     *
+     * This function runs in O(1)
+     */
+    bool allowed(char piece, GridLocation loc) const;
+
+    const Map<char, Vector<GridLocation>> &given() const;
+    uint64_t attacked() const;
+    long nodes() const;
+
+private:
+    bool defended(int square) const;
+    bool inCheck() const;
+    void countFrom(const Vector<char> &pieces, int next, int first, Map<char, Vector<GridLocation>> &placed);
+
+    GridLocation _kingLoc;
+    uint64_t _kingBit;
+    uint64_t _neighbourhood;            // the king's square and the squares around it
+    std::vector<uint64_t> _reach;       // neighbourhood squares each piece attacks from a square on an empty board,
+                                        // at pieceIndex(piece) * 64 + square
+    AttackBoard _attacks;
+    Map<char, Vector<GridLocation>> _given;
+    int _limit = 0;
+    int _found = 0;
+    Map<char, Vector<GridLocation>> _first;
+    long _nodes = 0;
+};
+
+/**
+ * Generate one puzzle: a random stalemate is built around a random king square, then its pieces are lifted off one at
+ * a time, each staying off only if the pieces lifted so far still have a single placement
+ * @param seed and puzzle to fill
+ * @return whether the attempt produced a puzzle
+ *
+ * This function runs in O(k 64^k) for k = kMaxPuzzlePieces
+ */
+bool generatePuzzle(uint64_t seed, Puzzle &puzzle);
+
+/**
+ * Run generation attempts on several threads; attempt i is seeded from the seed and i, so the puzzles do not depend
+ * on the number of threads
+ * @param number of attempts, seed and number of threads
+ * @return the puzzles in attempt order
+ *
+ * This function runs in O(a k 64^k / p) for a attempts on p threads
+ */
+Vector<Puzzle> generatePuzzles(int attempts, uint64_t seed, int threads);
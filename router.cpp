@@ -0,0 +1,364 @@
+/*
+ * This file contains the implementation of routing each problem to the engine a fitted cost model expects to be
+ * fastest, using features that are cheap to compute from the problem
+ */
+#include <cmath>
+#include <fstream>
+#include <mutex>
+#include "router.h"
+#include "error.h"
+#include "strlib.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kNumFeatures = 8;
+static const double kRidge = 1e-3;
+
+static mutex logLock;
+static string logFilename;
+static double logTolerance = 4;
+
+/* This function takes in the opponent king location and pieces and returns the problem's features. The square class
+ * is the king's distance from the nearest edge capped at 2, and the neighbourhood is counted directly so it does not
+ * depend on the current thread's board.
+ */
+ProblemFeatures extractFeatures(GridLocation kingLoc, Vector<char> pieces) {
+    ProblemFeatures features;
+    int edgeDistance = min(min(kingLoc.row, 7 - kingLoc.row), min(kingLoc.col, 7 - kingLoc.col));
+    features.squareClass = min(edgeDistance, 2);
+    for (char piece : pieces) {
+        features.queens += piece == 'Q';
+        features.rooks += piece == 'R';
+        features.bishops += piece == 'B';
+        features.knights += piece == 'H';
+    }
+    for (int i = -1; i <= 1; i++) {
+        for (int j = -1; j <= 1; j++) {
+            int row = kingLoc.row + i;
+            int col = kingLoc.col + j;
+            if ((i != 0 || j != 0) && row >= 0 && row < 8 && col >= 0 && col < 8) {
+                features.neighbourhood++;
+            }
+        }
+    }
+    return features;
+}
+
+/* This function takes in features and returns the vector the cost model is linear in. Centre squares are the
+ * reference class, so only edge and near-edge get an indicator.
+ */
+Vector<double> featureVector(const ProblemFeatures &features) {
+    return {1.0, double(features.squareClass == 0), double(features.squareClass == 1), double(features.queens),
+            double(features.rooks), double(features.bishops), double(features.knights), double(features.neighbourhood)};
+}
+
+/* This function takes in a harness report and returns a cost sample for every run in it. A failed run is charged
+ * its own time plus the time the baseline engine took on the same problem, since solveRouted falls back to the
+ * default engine when the routed one fails, so an engine that fails fast is not mistaken for a fast one.
+ */
+Vector<CostSample> costSamples(const HarnessReport &report) {
+    Vector<CostSample> samples;
+    for (int p = 0; p < report.problems.size(); p++) {
+        ProblemFeatures features = extractFeatures(report.problems[p].kingLoc, report.problems[p].pieces);
+        for (int e = 0; e < report.engines.size(); e++) {
+            const EngineRun &run = report.runs.get(p, e);
+            double micros = run.micros;
+            if (!run.verified && e != 0) {
+                micros += report.runs.get(p, 0).micros;
+            }
+            samples.add({features, e, micros});
+        }
+    }
+    return samples;
+}
+
+/* This function takes in engine names and cost samples and fits one ridge-regularised least squares model of log
+ * solve time per engine by solving the normal equations with Gaussian elimination. Fitting log time makes each
+ * feature scale the predicted time rather than add to it, which suits an exponential search.
+ */
+CostModel fitCostModel(Vector<string> engines, Vector<CostSample> samples) {
+    CostModel model;
+    model.engines = engines;
+    for (int e = 0; e < engines.size(); e++) {
+        double system[kNumFeatures][kNumFeatures + 1] = {};
+        for (int i = 0; i < kNumFeatures; i++) {
+            system[i][i] = kRidge;
+        }
+        for (const CostSample &sample : samples) {
+            if (sample.engine != e) {
+                continue;
+            }
+            Vector<double> x = featureVector(sample.features);
+            double y = log(sample.micros + 1);
+            for (int i = 0; i < kNumFeatures; i++) {
+                for (int j = 0; j < kNumFeatures; j++) {
+                    system[i][j] += x[i] * x[j];
+                }
+                system[i][kNumFeatures] += x[i] * y;
+            }
+        }
+
+        for (int col = 0; col < kNumFeatures; col++) {
+            int pivot = col;
+            for (int row = col + 1; row < kNumFeatures; row++) {
+                if (abs(system[row][col]) > abs(system[pivot][col])) {
+                    pivot = row;
+                }
+            }
+            for (int k = 0; k <= kNumFeatures; k++) {
+                swap(system[col][k], system[pivot][k]);
+            }
+            for (int row = 0; row < kNumFeatures; row++) {
+                if (row != col) {
+                    double factor = system[row][col] / system[col][col];
+                    for (int k = col; k <= kNumFeatures; k++) {
+                        system[row][k] -= factor * system[col][k];
+                    }
+                }
+            }
+        }
+        Vector<double> weights;
+        for (int i = 0; i < kNumFeatures; i++) {
+            weights.add(system[i][kNumFeatures] / system[i][i]);
+        }
+        model.weights.add(weights);
+    }
+    return model;
+}
+
+/* This function takes in a cost model, engine index and features and returns the engine's predicted solve time in
+ * microseconds.
+ */
+double predictMicros(const CostModel &model, int engine, const ProblemFeatures &features) {
+    Vector<double> x = featureVector(features);
+    double logMicros = 0;
+    for (int i = 0; i < kNumFeatures; i++) {
+        logMicros += model.weights[engine][i] * x[i];
+    }
+    return max(0.0, exp(logMicros) - 1);
+}
+
+/* This function takes in a cost model and features and returns the index of the engine with the lowest predicted
+ * solve time.
+ */
+int routeEngine(const CostModel &model, const ProblemFeatures &features) {
+    int best = 0;
+    for (int e = 1; e < model.engines.size(); e++) {
+        if (predictMicros(model, e, features) < predictMicros(model, best, features)) {
+            best = e;
+        }
+    }
+    return best;
+}
+
+/* This function takes in features, the engine used, predicted and actual time and whether the result was verified
+ * and appends one line to the misprediction log.
+ */
+static void logMisprediction(const ProblemFeatures &f, const string &engine, double predicted, double actual,
+                             bool verified) {
+    lock_guard<mutex> lock(logLock);
+    if (logFilename.empty()) {
+        return;
+    }
+    ofstream out(logFilename, ios::app);
+    out << f.squareClass << "," << f.queens << "," << f.rooks << "," << f.bishops << "," << f.knights << ","
+        << f.neighbourhood << "," << engine << "," << predicted << "," << actual << "," << verified << endl;
+}
+
+/* This function takes in a cost model, opponent king location and pieces. It runs the routed engine and treats the
+ * run as a misprediction when the result is not verified or the actual time is off from the prediction by more than
+ * the log tolerance in either direction. When the routed engine's result is not verified the problem is solved again
+ * with the default engine, and the reported time covers both runs.
+ */
+RoutedResult solveRouted(const CostModel &model, GridLocation kingLoc, Vector<char> pieces) {
+    RoutedResult routed;
+    ProblemFeatures features = extractFeatures(kingLoc, pieces);
+    int engine = routeEngine(model, features);
+    routed.engine = model.engines[engine];
+    routed.predictedMicros = predictMicros(model, engine, features);
+
+    EngineRun run = runEngine(findEngine(routed.engine), kingLoc, pieces);
+    routed.result = run.result;
+    routed.solved = run.verified;
+    routed.micros = run.micros;
+
+    double tolerance;
+    {
+        lock_guard<mutex> lock(logLock);
+        tolerance = logTolerance;
+    }
+    routed.mispredicted = !run.verified || run.micros > routed.predictedMicros * tolerance
+                          || run.micros * tolerance < routed.predictedMicros;
+    if (routed.mispredicted) {
+        logMisprediction(features, routed.engine, routed.predictedMicros, run.micros, run.verified);
+    }
+
+    Engine fallback = registeredEngines()[0];
+    if (!run.verified && fallback.name != routed.engine) {
+        EngineRun fallbackRun = runEngine(fallback, kingLoc, pieces);
+        routed.result = fallbackRun.result;
+        routed.solved = fallbackRun.verified;
+        routed.micros += fallbackRun.micros;
+        routed.fellBack = true;
+    }
+    return routed;
+}
+
+/* This function takes in a filename and tolerance and sets where solveRouted logs mispredictions.
+ */
+void setMispredictionLog(string filename, double tolerance) {
+    lock_guard<mutex> lock(logLock);
+    logFilename = filename;
+    logTolerance = tolerance;
+}
+
+/* This function takes in a misprediction log filename and engine names and returns the logged solves as cost
+ * samples, skipping engines that are not in the names.
+ */
+Vector<CostSample> readMispredictionLog(string filename, Vector<string> engines) {
+    Vector<CostSample> samples;
+    ifstream in(filename);
+    string line;
+    while (getline(in, line)) {
+        Vector<string> fields = stringSplit(line, ",");
+        if (fields.size() != 10 || !engines.contains(fields[6])) {
+            continue;
+        }
+        CostSample sample;
+        sample.features.squareClass = stringToInteger(fields[0]);
+        sample.features.queens = stringToInteger(fields[1]);
+        sample.features.rooks = stringToInteger(fields[2]);
+        sample.features.bishops = stringToInteger(fields[3]);
+        sample.features.knights = stringToInteger(fields[4]);
+        sample.features.neighbourhood = stringToInteger(fields[5]);
+        sample.engine = engines.indexOf(fields[6]);
+        sample.micros = stringToReal(fields[8]);
+        samples.add(sample);
+    }
+    return samples;
+}
+
+/* This function takes in a filename and cost model and writes the model as one line per engine: its name followed
+ * by its weights.
+ */
+void saveCostModel(string filename, const CostModel &model) {
+    ofstream out(filename);
+    out.precision(17);
+    for (int e = 0; e < model.engines.size(); e++) {
+        out << model.engines[e];
+        for (double weight : model.weights[e]) {
+            out << " " << weight;
+        }
+        out << endl;
+    }
+}
+
+/* This function takes in a filename and returns the cost model saved in it.
+ */
+CostModel loadCostModel(string filename) {
+    ifstream in(filename);
+    if (!in) {
+        error("Cannot open cost model " + filename);
+    }
+    CostModel model;
+    string name;
+    while (in >> name) {
+        Vector<double> weights;
+        for (int i = 0; i < kNumFeatures; i++) {
+            double weight;
+            if (!(in >> weight)) {
+                error("Truncated cost model " + filename);
+            }
+            weights.add(weight);
+        }
+        model.engines.add(name);
+        model.weights.add(weights);
+    }
+    return model;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("extractFeatures") {
+    ProblemFeatures corner = extractFeatures(GridLocation(0, 0), {'K', 'Q', 'B'});
+    EXPECT_EQUAL(corner.squareClass, 0);
+    EXPECT_EQUAL(corner.neighbourhood, 3);
+    EXPECT_EQUAL(corner.queens, 1);
+    EXPECT_EQUAL(corner.bishops, 1);
+
+    ProblemFeatures nearEdge = extractFeatures(GridLocation(1, 4), {'K', 'R', 'R', 'H'});
+    EXPECT_EQUAL(nearEdge.squareClass, 1);
+    EXPECT_EQUAL(nearEdge.neighbourhood, 8);
+    EXPECT_EQUAL(nearEdge.rooks, 2);
+    EXPECT_EQUAL(nearEdge.knights, 1);
+
+    EXPECT_EQUAL(extractFeatures(GridLocation(3, 4), {'K'}).squareClass, 2);
+}
+
+PROVIDED_TEST("fitCostModel recovers an exact model") {
+    Vector<CostSample> samples;
+    for (int q = 0; q < 4; q++) {
+        for (int h = 0; h < 4; h++) {
+            for (int squareClass = 0; squareClass < 3; squareClass++) {
+                ProblemFeatures f;
+                f.squareClass = squareClass;
+                f.queens = q;
+                f.knights = h;
+                f.rooks = (q + h) % 3;
+                f.bishops = q * h % 4;
+                f.neighbourhood = 3 + squareClass + q % 2;
+                samples.add({f, 0, exp(2 + 0.5 * q + 0.25 * h) - 1});
+            }
+        }
+    }
+    CostModel model = fitCostModel({"greedy"}, samples);
+    ProblemFeatures f;
+    f.squareClass = 2;
+    f.queens = 2;
+    f.knights = 2;
+    f.rooks = 1;
+    f.neighbourhood = 5;
+    EXPECT(abs(predictMicros(model, 0, f) - (exp(3.5) - 1)) < 0.05);
+}
+
+PROVIDED_TEST("Route with a model fit on a harness corpus") {
+    HarnessReport report = runHarness(78, 20, 6, 1);
+    Vector<string> names;
+    for (const Engine &engine : report.engines) {
+        names.add(engine.name);
+    }
+    Vector<CostSample> samples = costSamples(report);
+    EXPECT_EQUAL(samples.size(), report.problems.size() * names.size());
+    for (int i = 0; i < samples.size(); i++) {
+        const EngineRun &run = report.runs.get(i / names.size(), samples[i].engine);
+        double expected = run.micros + (run.verified ? 0 : report.runs.get(i / names.size(), 0).micros);
+        EXPECT_EQUAL(samples[i].micros, samples[i].engine == 0 ? run.micros : expected);
+    }
+    CostModel model = fitCostModel(names, samples);
+
+    string modelFile = "cost_model_test.txt";
+    saveCostModel(modelFile, model);
+    CostModel loaded = loadCostModel(modelFile);
+    remove(modelFile.c_str());
+    EXPECT(loaded.engines.equals(model.engines));
+    for (int e = 0; e < model.engines.size(); e++) {
+        for (int i = 0; i < kNumFeatures; i++) {
+            EXPECT(abs(loaded.weights[e][i] - model.weights[e][i]) < 1e-9);
+        }
+    }
+
+    string logFile = "mispredictions_test.csv";
+    remove(logFile.c_str());
+    setMispredictionLog(logFile, 1);
+    GridLocation kingLoc = GridLocation(2, 1);
+    Vector<char> pieces = {'K', 'Q', 'Q', 'Q', 'Q', 'Q', 'R', 'R', 'R', 'R', 'R'};
+    RoutedResult routed = solveRouted(model, kingLoc, pieces);
+    setMispredictionLog("");
+    EXPECT(routed.solved);
+    EXPECT(names.contains(routed.engine));
+    EXPECT(routed.mispredicted);
+    EXPECT_EQUAL(readMispredictionLog(logFile, names).size(), 1);
+    remove(logFile.c_str());
+    clearBoard();
+}
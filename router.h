@@ -0,0 +1,149 @@
+/*
+ * This file contains the declarations for routing each problem to the engine a fitted cost model expects to be
+ * fastest, using features that are cheap to compute from the problem
+ */
+#pragma once
+
+#include <string>
+#include "map.h"
+#include "vector.h"
+#include "engines.h"
+#include "harness.h"
+
+/** Cheap features of a problem
+ */
+struct ProblemFeatures {
+    int squareClass = 0;    // 0 for an edge king square, 1 for near-edge and 2 for centre
+    int queens = 0;
+    int rooks = 0;
+    int bishops = 0;
+    int knights = 0;
+    int neighbourhood = 0;  // number of squares the opponent king could move to
+};
+
+/** One measured solve used to fit a cost model
+ */
+struct CostSample {
+    ProblemFeatures features;
+    int engine;             // index into the model's engines
+    double micros;
+};
+
+/** Per-engine linear models of log solve time over the feature vector
+ */
+struct CostModel {
+    Vector<std::string> engines;
+    Vector<Vector<double>> weights;   // weights[engine][feature]
+};
+
+/** Outcome of solving a problem with the routed engine
+ */
+struct RoutedResult {
+    Map<char, Vector<GridLocation>> result;
+    bool solved = false;
+    std::string engine;
+    double predictedMicros = 0;
+    double micros = 0;
+    bool mispredicted = false;    // engine failed or took far longer or shorter than predicted
+    bool fellBack = false;        // engine failed and the default engine was run instead
+};
+
+/**
+ * Compute the cheap features of a problem
+ * @param opponent king location and pieces
+ * @return features
+ *
+ * This function runs in O(n) for n pieces
+ */
+ProblemFeatures extractFeatures(GridLocation kingLoc, Vector<char> pieces);
+
+/**
+ * Turn features into the vector the cost model is linear in: a constant, edge and near-edge indicators, the four
+ * piece counts and the neighbourhood size
+ * @param features
+ * @return feature vector
+ *
+ * This function runs in O(1)
+ */
+Vector<double> featureVector(const ProblemFeatures &features);
+
+/**
+ * Collect a cost sample for every run in a harness report, charging a failed run the baseline engine's time on top
+ * of its own
+ * @param report, whose first engine is the baseline
+ * @return vector of samples, with engine indices matching report.engines
+ *
+ * This function runs in O(pe) for p problems and e engines
+ */
+Vector<CostSample> costSamples(const HarnessReport &report);
+
+/**
+ * Fit a cost model by least squares on log solve time
+ * @param engine names and samples
+ * @return fitted cost model
+ *
+ * This function runs in O(n) for n samples
+ */
+CostModel fitCostModel(Vector<std::string> engines, Vector<CostSample> samples);
+
+/**
+ * Predict the solve time of an engine
+ * @param cost model, engine index and features
+ * @return predicted time in microseconds
+ *
+ * This function runs in O(1)
+ */
+double predictMicros(const CostModel &model, int engine, const ProblemFeatures &features);
+
+/**
+ * Pick the engine with the lowest predicted solve time
+ * @param cost model and features
+ * @return engine index into the model's engines
+ *
+ * This function runs in O(e) for e engines
+ */
+int routeEngine(const CostModel &model, const ProblemFeatures &features);
+
+/**
+ * Solve a problem with the routed engine, logging a misprediction if one is configured and falling back to the
+ * default engine if the routed engine's result is not verified
+ * @param cost model, opponent king location and pieces
+ * @return routed result
+ *
+ * This function runs in the time of the routed engine
+ */
+RoutedResult solveRouted(const CostModel &model, GridLocation kingLoc, Vector<char> pieces);
+
+/**
+ * Log mispredictions made by solveRouted to a file, or stop logging with an empty filename
+ * @param filename and factor the actual time may differ from the prediction by before it counts as a misprediction
+ *
+ * This function runs in O(1)
+ */
+void setMispredictionLog(std::string filename, double tolerance = 4);
+
+/**
+ * Read a misprediction log back as cost samples so the model can be refit with them
+ * @param filename and engine names of the model being refit
+ * @return vector of samples for engines that appear in the names
+ *
+ * This function runs in O(n) for n logged mispredictions
+ */
+Vector<CostSample> readMispredictionLog(std::string filename, Vector<std::string> engines);
+
+/**
+ * Save a cost model to a text file
+ * @param filename and model
+ *
+ * This function runs in O(e) for e engines
+ */
+void saveCostModel(std::string filename, const CostModel &model);
+
+/**
+ * Load a cost model saved by saveCostModel
+ * @param filename
+ * @return model, raising an error if the file cannot be read
+ *
+ * This function runs in O(e) for e engines
+ */
+CostModel loadCostModel(std::string filename);
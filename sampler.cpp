@@ -0,0 +1,475 @@
+/*
+ * This file contains the implementation of the uniform solution sampler, which counts the stalemate placements of a
+ * problem with a dynamic program over coverage states and draws placements by walking the counts
+ */
+#include <chrono>
+#include <thread>
+#include "sampler.h"
+#include "bitboard.h"
+#include "coverage.h"
+#include "engines.h"
+#include "error.h"
+#include "patterns.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const string kPieceTypes = "KQRBH";
+static const int kFieldBits = 5;
+static const int kDirs[8][2] = {{1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, -1}, {1, -1}, {-1, 1}};
+static const int kKnightDirs[8][2] = {{1, 2}, {2, 1}, {1, -2}, {2, -1}, {-1, 2}, {-2, 1}, {-1, -2}, {-2, -1}};
+
+/* This function takes in a seed and a stream number and returns a seed for the stream, mixing both with the
+ * SplitMix64 finaliser so neighbouring streams are unrelated.
+ */
+uint64_t streamSeed(uint64_t seed, uint64_t stream) {
+    uint64_t z = seed + (stream + 1) * 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+size_t SolutionSampler::StateHash::operator()(const pair<uint64_t, uint64_t> &key) const {
+    return streamSeed(key.first, key.second);
+}
+
+/* This function takes in the opponent king location and pieces and sets up the walk. The squares outside the
+ * neighbourhood are ordered by distance from the king. A line is a ray leaving the king's square, or leaving a
+ * neighbourhood square in a direction away from the king, and holds the squares outside the neighbourhood along it;
+ * every square on a line is nearer the king than the squares after it. The whole count is then computed once.
+ */
+SolutionSampler::SolutionSampler(GridLocation kingLoc, Vector<char> pieces) {
+    _kingLoc = kingLoc;
+    _full = 0;
+    for (int bit = 0; bit < 9; bit++) {
+        int row = kingLoc.row + bit / 3 - 1;
+        int col = kingLoc.col + bit % 3 - 1;
+        if (bit != 4 && row >= 0 && row < 8 && col >= 0 && col < 8) {
+            _full |= 1 << bit;
+        }
+    }
+    for (int distance = 2; distance < 8; distance++) {
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                if (max(abs(row - kingLoc.row), abs(col - kingLoc.col)) == distance) {
+                    _order.add(GridLocation(row, col));
+                }
+            }
+        }
+    }
+    int squares = _order.size();
+    Vector<int> position(64, -1);
+    for (int i = 0; i < squares; i++) {
+        position[_order[i].row * 8 + _order[i].col] = i;
+    }
+
+    _rays.assign(squares, 0);
+    int numRays = 0;
+    for (int bit = 0; bit < 9; bit++) {
+        GridLocation from(kingLoc.row + bit / 3 - 1, kingLoc.col + bit % 3 - 1);
+        if (bit != 4 && !(_full & (1 << bit))) {
+            continue;
+        }
+        for (const int *dir : kDirs) {
+            if (bit != 4 && from.row + dir[0] == kingLoc.row && from.col + dir[1] == kingLoc.col) {
+                continue;
+            }
+            uint64_t ray = uint64_t(1) << numRays;
+            bool used = false;
+            for (int row = from.row + dir[0], col = from.col + dir[1]; row >= 0 && row < 8 && col >= 0 && col < 8;
+                 row += dir[0], col += dir[1]) {
+                int index = position[row * 8 + col];
+                if (index >= 0) {
+                    _rays[index] |= ray;
+                    used = true;
+                }
+            }
+            if (!used) {
+                continue;
+            }
+            if (numRays == 64) {
+                error("Too many lines toward the king");
+            }
+            _rayKinds[dir[0] != 0 && dir[1] != 0] |= ray;
+            _rayTarget.push_back(bit == 4 ? 0 : 1 << bit);
+            if (bit == 4) {
+                _kingRays |= ray;
+            }
+            numRays++;
+        }
+    }
+    _openRays.assign(1 << 9, _kingRays);
+    for (int coverage = 0; coverage < (1 << 9); coverage++) {
+        for (int ray = 0; ray < numRays; ray++) {
+            if (_rayTarget[ray] & ~coverage) {
+                _openRays[coverage] |= uint64_t(1) << ray;
+            }
+        }
+    }
+
+    for (int type = 0; type < 2; type++) {
+        _leaping[type].assign(squares, 0);
+    }
+    for (int i = 0; i < squares; i++) {
+        for (int dr = -1; dr <= 1; dr++) {
+            for (int dc = -1; dc <= 1; dc++) {
+                int bit = neighbourhoodBit(GridLocation(_order[i].row + dr, _order[i].col + dc), kingLoc);
+                if ((dr != 0 || dc != 0) && bit >= 0) {
+                    _leaping[0][i] |= 1 << bit;
+                }
+            }
+        }
+        for (const int *dir : kKnightDirs) {
+            int bit = neighbourhoodBit(GridLocation(_order[i].row + dir[0], _order[i].col + dir[1]), kingLoc);
+            if (bit == 4) {
+                _leaping[1][i] = -1;
+                break;
+            }
+            if (bit >= 0) {
+                _leaping[1][i] |= 1 << bit;
+            }
+        }
+        _leaping[0][i] &= _full;
+        if (_leaping[1][i] > 0) {
+            _leaping[1][i] &= _full;
+        }
+    }
+    _live.assign(squares + 1, 0);
+    _reach.assign(squares + 1, 0);
+    for (int i = squares - 1; i >= 0; i--) {
+        _live[i] = _live[i + 1] | _rays[i];
+        _reach[i] = _reach[i + 1] | _leaping[0][i] | max(_leaping[1][i], 0);
+        for (uint64_t rays = _rays[i]; rays; rays &= rays - 1) {
+            _reach[i] |= _rayTarget[lowestSquare(rays)];
+        }
+    }
+
+    int numPieces[5] = {};
+    for (char piece : pieces) {
+        size_t type = kPieceTypes.find(piece);
+        if (type == string::npos) {
+            error("Invalid character representation of a piece");
+        }
+        if (++numPieces[type] > 15) {
+            error("Too many pieces of one type to count");
+        }
+    }
+    _rootCounts = packPieceCounts(pieces);
+    _total = countFrom({0, 0, 0, _rootCounts});
+}
+
+/* This function takes in a state and returns whether its count is known without the memo, setting value if so: once
+ * every piece is placed or the squares run out the placement counts if every piece is placed and the neighbourhood is
+ * covered, and a state with more
+ * pieces than squares left, or whose remaining squares cannot attack the uncovered squares, has none.
+ */
+bool SolutionSampler::settled(const State &state, uint64_t &value) const {
+    int left = 0;
+    for (int type = 0; type < 5; type++) {
+        left += (state.counts >> (type * kFieldBits)) & 31;
+    }
+    if (left == 0 || state.index == _order.size()) {
+        value = left == 0 && state.coverage == _full;
+        return true;
+    }
+    if (left > _order.size() - state.index || (state.coverage | _reach[state.index]) != _full) {
+        value = 0;
+        return true;
+    }
+    return false;
+}
+
+/* This function takes in a state and a piece type, -1 for leaving the square empty, and fills in the state after the
+ * square is decided. A slider attacks along each of its lines through the square that no nearer piece blocks, and may
+ * not do so along a line from the king's square; a knight may not stand a knight's move from the king. It returns
+ * false if the move is not allowed. Lines that can no longer matter are cleared so equal states meet in the memo: those
+ * with no square left, those toward covered squares, and those no remaining slider moves along.
+ */
+bool SolutionSampler::step(const State &state, int type, State &next) const {
+    next = state;
+    next.index++;
+    if (type >= 0) {
+        if (((state.counts >> (type * kFieldBits)) & 31) == 0) {
+            return false;
+        }
+        char piece = kPieceTypes[type];
+        int gain = 0;
+        if (piece == 'K' || piece == 'H') {
+            gain = _leaping[piece == 'H'][state.index];
+            if (gain < 0) {
+                return false;
+            }
+        } else {
+            uint64_t kinds = piece == 'Q' ? _rayKinds[0] | _rayKinds[1] : _rayKinds[piece == 'B'];
+            uint64_t open = _rays[state.index] & kinds & ~state.blocked;
+            if (open & _kingRays) {
+                return false;
+            }
+            for (; open; open &= open - 1) {
+                gain |= _rayTarget[lowestSquare(open)];
+            }
+        }
+        next.coverage |= gain;
+        next.blocked |= _rays[state.index];
+        next.counts -= 1 << (type * kFieldBits);
+    }
+    uint64_t tracked = _live[next.index] & _openRays[next.coverage];
+    int queens = (next.counts >> kFieldBits) & 31;
+    if (queens == 0 && ((next.counts >> (2 * kFieldBits)) & 31) == 0) {
+        tracked &= _rayKinds[1];
+    }
+    if (queens == 0 && ((next.counts >> (3 * kFieldBits)) & 31) == 0) {
+        tracked &= _rayKinds[0];
+    }
+    next.blocked &= tracked;
+    return true;
+}
+
+/* This function takes in a state and returns the number of ways to decide the remaining squares, summing the counts
+ * after each allowed move and storing the sum in the memo. It raises an error if a count overflows 64 bits.
+ */
+uint64_t SolutionSampler::countFrom(const State &state) {
+    uint64_t value;
+    if (settled(state, value)) {
+        return value;
+    }
+    pair<uint64_t, uint64_t> key(state.blocked, uint64_t(state.index) | uint64_t(state.coverage) << 8
+                                                | uint64_t(state.counts) << 17);
+    auto it = _memo.find(key);
+    if (it != _memo.end()) {
+        return it->second;
+    }
+    uint64_t total = 0;
+    State next;
+    for (int type = -1; type < 5; type++) {
+        if (step(state, type, next)) {
+            uint64_t ways = countFrom(next);
+            if (ways > UINT64_MAX - total) {
+                error("Too many placements to count in 64 bits");
+            }
+            total += ways;
+        }
+    }
+    _memo[key] = total;
+    return total;
+}
+
+/* This function takes in a state reached by the count and returns its count without changing the memo, so draws can
+ * run on several threads at once.
+ */
+uint64_t SolutionSampler::lookup(const State &state) const {
+    uint64_t value;
+    if (settled(state, value)) {
+        return value;
+    }
+    return _memo.at(pair<uint64_t, uint64_t>(state.blocked, uint64_t(state.index) | uint64_t(state.coverage) << 8
+                                                            | uint64_t(state.counts) << 17));
+}
+
+uint64_t SolutionSampler::count() const {
+    return _total;
+}
+
+/* This function takes in a generator and draws a number below the count, then walks the squares: at each square the
+ * moves are taken in a fixed order and the drawn number picks the move whose range of counts holds it, after which the
+ * number is reduced by the counts of the moves before. Every placement corresponds to exactly one number, so each is
+ * drawn with the same probability.
+ */
+Map<char, Vector<GridLocation>> SolutionSampler::sample(mt19937_64 &random) const {
+    if (_total == 0) {
+        error("The problem has no placement to sample");
+    }
+    uint64_t target = uniform_int_distribution<uint64_t>(0, _total - 1)(random);
+    Map<char, Vector<GridLocation>> placement;
+    State state = {0, 0, 0, _rootCounts};
+    while (state.index < _order.size()) {
+        State next;
+        for (int type = -1; type < 5; type++) {
+            if (!step(state, type, next)) {
+                continue;
+            }
+            uint64_t ways = lookup(next);
+            if (target < ways) {
+                if (type >= 0) {
+                    placement[kPieceTypes[type]].add(_order[state.index]);
+                }
+                break;
+            }
+            target -= ways;
+        }
+        state = next;
+    }
+    return placement;
+}
+
+/* This function takes in a number of draws, a seed and a number of threads. Each thread takes every p-th draw and
+ * seeds a generator per draw, so draw i is the same however the draws are shared out.
+ */
+Vector<Map<char, Vector<GridLocation>>> SolutionSampler::sampleMany(int draws, uint64_t seed, int threads) const {
+    if (_total == 0 && draws > 0) {
+        error("The problem has no placement to sample");
+    }
+    Vector<Map<char, Vector<GridLocation>>> placements(draws);
+    threads = max(1, min(threads, draws));
+    vector<thread> workers;
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&, t]() {
+            for (int i = t; i < draws; i += threads) {
+                mt19937_64 random(streamSeed(seed, i));
+                placements[i] = sample(random);
+            }
+        });
+    }
+    for (thread &worker : workers) {
+        worker.join();
+    }
+    return placements;
+}
+
+int SolutionSampler::states() const {
+    return _memo.size();
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/* This function takes in a placement and returns a key naming its pieces and squares in a fixed order.
+ */
+static string placementKey(const Map<char, Vector<GridLocation>> &placement) {
+    string key;
+    for (char piece : kPieceTypes) {
+        if (placement.containsKey(piece)) {
+            Vector<GridLocation> locs = placement.get(piece);
+            locs.sort();
+            for (GridLocation loc : locs) {
+                key += piece;
+                key += char(loc.row * 8 + loc.col);
+            }
+        }
+    }
+    return key;
+}
+
+/* This function takes in the opponent king location, pieces with equal ones next to each other, the next piece and
+ * the first square it may take, and counts the stalemates that put the rest of the pieces on free squares outside the
+ * neighbourhood, equal pieces on increasing squares. The attack board rules out most placements before
+ * verifyStalemate, which also checks the king is not attacked, and each stalemate's key is added to counts.
+ */
+static uint64_t countByEnumeration(GridLocation kingLoc, const Vector<char> &pieces, int next, int first,
+                                   AttackBoard &attacks, Map<char, Vector<GridLocation>> &placement,
+                                   Map<string, int> &counts) {
+    if (next == pieces.size()) {
+        if (!attacks.isStalemate() || !verifyStalemate(kingLoc, pieces, placement)) {
+            return 0;
+        }
+        counts[placementKey(placement)] = 0;
+        return 1;
+    }
+    uint64_t total = 0;
+    for (int square = first; square < 64; square++) {
+        GridLocation loc(square / 8, square % 8);
+        if (neighbourhoodBit(loc, kingLoc) >= 0 || _board[loc] != 'E') {
+            continue;
+        }
+        _board[loc] = pieces[next];
+        attacks.place(pieces[next], loc);
+        placement[pieces[next]].add(loc);
+        bool same = next + 1 < pieces.size() && pieces[next + 1] == pieces[next];
+        total += countByEnumeration(kingLoc, pieces, next + 1, same ? square + 1 : 0, attacks, placement, counts);
+        placement[pieces[next]].removeBack();
+        if (placement[pieces[next]].isEmpty()) {
+            placement.remove(pieces[next]);
+        }
+        attacks.remove(loc);
+        _board[loc] = 'E';
+    }
+    return total;
+}
+
+PROVIDED_TEST("Sampler counts match enumeration") {
+    Vector<GridLocation> kings = {GridLocation(0, 0), GridLocation(0, 3), GridLocation(2, 1)};
+    Vector<Vector<char>> problems = {{'R', 'R'}, {'K', 'R', 'R'}, {'Q', 'R', 'H'}, {'K', 'Q', 'B'}};
+    for (GridLocation kingLoc : kings) {
+        for (Vector<char> pieces : problems) {
+            pieces.sort();
+            clearBoard();
+            _board[kingLoc] = 'K';
+            AttackBoard attacks;
+            attacks.reset(kingLoc, Map<char, Vector<GridLocation>>());
+            Map<char, Vector<GridLocation>> placement;
+            Map<string, int> counts;
+            uint64_t expected = countByEnumeration(kingLoc, pieces, 0, 0, attacks, placement, counts);
+            SolutionSampler sampler(kingLoc, pieces);
+            EXPECT_EQUAL(sampler.count(), expected);
+        }
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Sampler draws placements uniformly") {
+    GridLocation kingLoc(0, 0);
+    Vector<char> pieces = {'K', 'R', 'R'};
+    clearBoard();
+    _board[kingLoc] = 'K';
+    AttackBoard attacks;
+    attacks.reset(kingLoc, Map<char, Vector<GridLocation>>());
+    Map<char, Vector<GridLocation>> placement;
+    Map<string, int> counts;
+    countByEnumeration(kingLoc, pieces, 0, 0, attacks, placement, counts);
+    clearBoard();
+
+    SolutionSampler sampler(kingLoc, pieces);
+    int draws = sampler.count() * 200;
+    for (const Map<char, Vector<GridLocation>> &placement : sampler.sampleMany(draws, 106, 4)) {
+        string drawn = placementKey(placement);
+        EXPECT(counts.containsKey(drawn));
+        counts[drawn]++;
+    }
+    int fewest = draws;
+    int most = 0;
+    for (const string &placement : counts) {
+        fewest = min(fewest, counts[placement]);
+        most = max(most, counts[placement]);
+    }
+    cout << sampler.count() << " placements drawn between " << fewest << " and " << most << " times each, expected 200"
+         << endl;
+    EXPECT(fewest > 120);
+    EXPECT(most < 280);
+}
+
+PROVIDED_TEST("Sampler draws do not depend on the number of threads") {
+    GridLocation kingLoc(3, 4);
+    Vector<char> pieces = {'K', 'Q', 'R', 'B', 'H', 'H'};
+    SolutionSampler sampler(kingLoc, pieces);
+    Vector<Map<char, Vector<GridLocation>>> serial = sampler.sampleMany(50, 7, 1);
+    Vector<Map<char, Vector<GridLocation>>> parallel = sampler.sampleMany(50, 7, 4);
+    for (int i = 0; i < serial.size(); i++) {
+        EXPECT_EQUAL(placementKey(serial[i]), placementKey(parallel[i]));
+        clearBoard();
+        _board[kingLoc] = 'K';
+        EXPECT(verifyStalemate(kingLoc, pieces, serial[i]));
+    }
+    EXPECT_ERROR(SolutionSampler(kingLoc, {'K', 'X'}));
+    clearBoard();
+}
+
+PROVIDED_TEST("Sampler on larger problems") {
+    Vector<Problem> problems = generateCorpus(920, 2, 6);
+    for (const Problem &problem : problems) {
+        auto start = chrono::steady_clock::now();
+        SolutionSampler sampler(problem.kingLoc, problem.pieces);
+        double countMillis = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+        if (sampler.count() == 0) {
+            cout << problem.pieces.size() << " pieces: no placement, " << countMillis << " ms" << endl;
+            continue;
+        }
+        start = chrono::steady_clock::now();
+        Vector<Map<char, Vector<GridLocation>>> placements = sampler.sampleMany(1000, 1, 1);
+        double sampleMicros = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count() / 1000;
+        clearBoard();
+        _board[problem.kingLoc] = 'K';
+        EXPECT(verifyStalemate(problem.kingLoc, problem.pieces, placements[0]));
+        cout << problem.pieces.size() << " pieces: " << sampler.count() << " placements, " << sampler.states()
+             << " states counted in " << countMillis << " ms, " << sampleMicros << " us per draw" << endl;
+    }
+    clearBoard();
+}
@@ -0,0 +1,109 @@
+/*
+ * This file contains the declarations for the uniform solution sampler, which counts the stalemate placements of a
+ * problem with a dynamic program over coverage states and draws placements by walking the counts
+ */
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <vector>
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/**
+ * Seed for one of several independent random streams, so work split across threads draws the same numbers
+ * @param seed and stream number
+ * @return the two mixed with the SplitMix64 finaliser
+ *
+ * This function runs in O(1)
+ */
+uint64_t streamSeed(uint64_t seed, uint64_t stream);
+
+/** Counts and samples the stalemate placements of a problem that keep every piece off the opponent king's 3x3
+ * neighbourhood, the placements the engines produce. The squares outside the neighbourhood are decided one at a time
+ * in order of distance from the king, each left empty or given one of the remaining piece types; a square's lines
+ * toward the king only pass through nearer squares, so a state only needs the neighbourhood squares covered so far,
+ * which lines toward the king are already blocked, and the pieces left
+ */
+class SolutionSampler {
+public:
+    /**
+     * Count the placements of a problem
+     * @param opponent king location and pieces
+     *
+     * This function runs in O(s t) for s reachable states and t piece types
+     */
+    SolutionSampler(GridLocation kingLoc, Vector<char> pieces);
+
+    /**
+     * Number of placements, every one a stalemate with every piece on its own square outside the neighbourhood
+     * @return count, raising an error in the constructor if it does not fit in 64 bits
+     *
+     * This function runs in O(1)
+     */
+    uint64_t count() const;
+
+    /**
+     * Draw a placement uniformly at random
+     * @param random number generator, raising an error if there is no placement
+     * @return map of pieces to their locations
+     *
+     * This function runs in O(64 t) for t piece types
+     */
+    Map<char, Vector<GridLocation>> sample(std::mt19937_64 &random) const;
+
+    /**
+     * Draw placements on several threads; draw i uses its own generator seeded from the seed and i, so the draws do
+     * not depend on the number of threads
+     * @param number of draws, seed and number of threads
+     * @return placements in draw order
+     *
+     * This function runs in O(64 t n / p) for n draws on p threads
+     */
+    Vector<Map<char, Vector<GridLocation>>> sampleMany(int draws, uint64_t seed, int threads) const;
+
+    /**
+     * Number of states the count stored
+     * @return memo size
+     *
+     * This function runs in O(1)
+     */
+    int states() const;
+
+private:
+    /** A point of the walk over the squares
+     */
+    struct State {
+        int index;          // next square in _order
+        int coverage;       // neighbourhood squares attacked
+        uint64_t blocked;   // lines toward the king with a piece on them
+        int counts;         // pieces left, five bits per type
+    };
+
+    struct StateHash {
+        size_t operator()(const std::pair<uint64_t, uint64_t> &key) const;
+    };
+
+    bool settled(const State &state, uint64_t &value) const;
+    uint64_t countFrom(const State &state);
+    uint64_t lookup(const State &state) const;
+    bool step(const State &state, int type, State &next) const;
+
+    GridLocation _kingLoc;
+    int _full;
+    int _rootCounts;                    // the problem's pieces, five bits per type
+    uint64_t _total;
+    Vector<GridLocation> _order;        // squares outside the neighbourhood, nearest first
+    std::vector<uint64_t> _rays;        // lines through each square in _order
+    std::vector<uint64_t> _live;        // lines with a square at or after each index
+    std::vector<int> _reach;            // neighbourhood squares any piece could attack from an index on
+    std::vector<int> _leaping[2];       // squares a king and a knight attack from each square, -1 if it checks
+    uint64_t _rayKinds[2] = {0, 0};     // straight and diagonal lines
+    uint64_t _kingRays = 0;             // lines from the king's own square
+    std::vector<int> _rayTarget;        // neighbourhood bit each line runs to, 0 for the king's lines
+    std::vector<uint64_t> _openRays;    // lines still worth tracking for each coverage: the king's and the uncovered
+                                        // squares'
+    std::unordered_map<std::pair<uint64_t, uint64_t>, uint64_t, StateHash> _memo;
+};
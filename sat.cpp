@@ -0,0 +1,837 @@
+/*
+ * This file contains the implementation of a small CDCL SAT solver and the stalemate engine that encodes piece
+ * placement as a SAT instance
+ */
+#include <chrono>
+#include <climits>
+#include "sat.h"
+#include "bitboard.h"
+#include "engines.h"
+#include "pieces.h"
+#include "profiler.h"
+#include "random.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const int kRestartBase = 64;         // conflicts in the first restart interval
+static const double kActivityDecay = 0.95;
+static const int kDiversePoolFactor = 3;   // solutions found for each placement wanted
+
+/* This function takes in a DIMACS literal and returns the internal literal 2 * var + sign with variables from 0.
+ */
+static int toLit(int literal) {
+    return literal > 0 ? 2 * (literal - 1) : 2 * (-literal - 1) + 1;
+}
+
+/* This function takes in a restart count and returns the matching term of the Luby sequence 1 1 2 1 1 2 4 ...
+ */
+static long luby(long i) {
+    long size = 1;
+    int power = 0;
+    while (size < i + 1) {
+        size = 2 * size + 1;
+        power++;
+    }
+    while (size - 1 != i) {
+        size = (size - 1) / 2;
+        power--;
+        i %= size;
+    }
+    return 1L << power;
+}
+
+int SatSolver::newVar() {
+    _assigns.add(-1);
+    _levels.add(0);
+    _reasons.add(-1);
+    _activity.add(0);
+    _phase.add(0);
+    _seen.add(0);
+    _watches.add(Vector<int>());
+    _watches.add(Vector<int>());
+    return _assigns.size();
+}
+
+int SatSolver::numVars() const {
+    return _assigns.size();
+}
+
+int SatSolver::numClauses() const {
+    return _clauses.size();
+}
+
+long SatSolver::conflicts() const {
+    return _conflicts;
+}
+
+long SatSolver::decisions() const {
+    return _decisions;
+}
+
+bool SatSolver::value(int var) const {
+    return _assigns[var - 1] == 1;
+}
+
+/* This function takes in an internal literal and returns 1 if it is true, 0 if false and -1 if unassigned.
+ */
+int SatSolver::litValue(int lit) const {
+    int value = _assigns[lit >> 1];
+    return value < 0 ? -1 : value ^ (lit & 1);
+}
+
+int SatSolver::level() const {
+    return _trailLimits.size();
+}
+
+/* This function takes in a literal and the clause that implies it and makes it true at the current level.
+ */
+void SatSolver::enqueue(int lit, int reason) {
+    int var = lit >> 1;
+    _assigns[var] = 1 - (lit & 1);
+    _levels[var] = level();
+    _reasons[var] = reason;
+    _trail.add(lit);
+}
+
+/* This function takes in a clause of at least two literals whose first two are the ones to watch, stores it and
+ * returns its index.
+ */
+int SatSolver::attach(const Vector<int> &clause) {
+    _clauses.add(clause);
+    _watches[clause[0]].add(_clauses.size() - 1);
+    _watches[clause[1]].add(_clauses.size() - 1);
+    return _clauses.size() - 1;
+}
+
+/* This function takes in DIMACS literals and adds their clause at level 0, dropping repeated and false literals and
+ * clauses that are already satisfied. An empty clause makes the instance unsatisfiable and a unit clause is assigned
+ * straight away. After a solve the assignment is undone down to level 0 first, saving its phases.
+ */
+void SatSolver::addClause(Vector<int> literals) {
+    backtrack(0);
+    Vector<int> clause;
+    for (int literal : literals) {
+        int lit = toLit(literal);
+        if (litValue(lit) == 1 || clause.contains(lit ^ 1)) {
+            return;
+        }
+        if (litValue(lit) == -1 && !clause.contains(lit)) {
+            clause.add(lit);
+        }
+    }
+    if (clause.isEmpty()) {
+        _unsat = true;
+    } else if (clause.size() == 1) {
+        enqueue(clause[0], -1);
+        if (propagate() != -1) {
+            _unsat = true;
+        }
+    } else {
+        attach(clause);
+    }
+}
+
+/* This function propagates every assignment on the trail that has not been propagated yet. For each literal made false
+ * it visits the clauses watching it: a clause whose other watch is true is left alone, otherwise it moves the watch to
+ * a literal that is not false, and failing that the clause is unit and its other watch is assigned, or it is false
+ * and its index is returned as the conflict. It returns -1 when there is no conflict.
+ */
+int SatSolver::propagate() {
+    while (_propagated < _trail.size()) {
+        int falseLit = _trail[_propagated++] ^ 1;
+        Vector<int> &watching = _watches[falseLit];
+        int kept = 0;
+        int conflict = -1;
+        for (int i = 0; i < watching.size(); i++) {
+            int index = watching[i];
+            if (conflict != -1) {
+                watching[kept++] = index;
+                continue;
+            }
+            Vector<int> &clause = _clauses[index];
+            if (clause[0] == falseLit) {
+                clause[0] = clause[1];
+                clause[1] = falseLit;
+            }
+            if (litValue(clause[0]) == 1) {
+                watching[kept++] = index;
+                continue;
+            }
+            bool moved = false;
+            for (int k = 2; k < clause.size() && !moved; k++) {
+                if (litValue(clause[k]) != 0) {
+                    clause[1] = clause[k];
+                    clause[k] = falseLit;
+                    _watches[clause[1]].add(index);
+                    moved = true;
+                }
+            }
+            if (moved) {
+                continue;
+            }
+            watching[kept++] = index;
+            if (litValue(clause[0]) == 0) {
+                conflict = index;
+            } else {
+                enqueue(clause[0], index);
+            }
+        }
+        while (watching.size() > kept) {
+            watching.removeBack();
+        }
+        if (conflict != -1) {
+            _propagated = _trail.size();
+            return conflict;
+        }
+    }
+    return -1;
+}
+
+/* This function takes in a variable and raises its activity, scaling every activity down when they grow too large.
+ */
+void SatSolver::bump(int var) {
+    _activity[var] += _bumpAmount;
+    if (_activity[var] > 1e100) {
+        for (int i = 0; i < _activity.size(); i++) {
+            _activity[i] *= 1e-100;
+        }
+        _bumpAmount *= 1e-100;
+    }
+}
+
+/* This function takes in a DIMACS literal, goes back to level 0 so the saved phase is not overwritten by the current
+ * assignment, and sets the variable's phase to the literal's value and bumps its activity.
+ */
+void SatSolver::prefer(int literal) {
+    backtrack(0);
+    int var = abs(literal) - 1;
+    _phase[var] = literal > 0 ? 1 : 0;
+    bump(var);
+}
+
+/* This function takes in a conflicting clause and fills in the first-UIP learnt clause: it resolves the conflict with
+ * the reasons of the current level's literals, latest first, until one literal of the current level is left. That
+ * literal's negation goes first and the literal of the highest remaining level second. It returns the level to
+ * backtrack to, where the learnt clause is unit.
+ */
+int SatSolver::analyze(int conflict, Vector<int> &learnt) {
+    learnt.clear();
+    learnt.add(-1);
+    int pending = 0;
+    int lit = -1;
+    int index = _trail.size() - 1;
+    do {
+        const Vector<int> &clause = _clauses[conflict];
+        for (int k = lit == -1 ? 0 : 1; k < clause.size(); k++) {
+            int var = clause[k] >> 1;
+            if (!_seen[var] && _levels[var] > 0) {
+                _seen[var] = 1;
+                bump(var);
+                if (_levels[var] >= level()) {
+                    pending++;
+                } else {
+                    learnt.add(clause[k]);
+                }
+            }
+        }
+        while (!_seen[_trail[index] >> 1]) {
+            index--;
+        }
+        lit = _trail[index--];
+        conflict = _reasons[lit >> 1];
+        _seen[lit >> 1] = 0;
+        pending--;
+    } while (pending > 0);
+    learnt[0] = lit ^ 1;
+
+    int backtrackLevel = 0;
+    for (int k = 1; k < learnt.size(); k++) {
+        _seen[learnt[k] >> 1] = 0;
+        if (_levels[learnt[k] >> 1] > backtrackLevel) {
+            backtrackLevel = _levels[learnt[k] >> 1];
+            int swap = learnt[1];
+            learnt[1] = learnt[k];
+            learnt[k] = swap;
+        }
+    }
+    _bumpAmount /= kActivityDecay;
+    return backtrackLevel;
+}
+
+/* This function takes in a level and undoes every assignment above it, saving each variable's value as its phase.
+ */
+void SatSolver::backtrack(int target) {
+    if (level() <= target) {
+        return;
+    }
+    int limit = _trailLimits[target];
+    while (_trail.size() > limit) {
+        int var = _trail.removeBack() >> 1;
+        _phase[var] = _assigns[var];
+        _assigns[var] = -1;
+        _reasons[var] = -1;
+    }
+    while (_trailLimits.size() > target) {
+        _trailLimits.removeBack();
+    }
+    _propagated = _trail.size();
+}
+
+/* This function returns the unassigned variable with the highest activity, or -1 if every variable is assigned.
+ */
+int SatSolver::pickBranchVar() {
+    int best = -1;
+    for (int var = 0; var < _assigns.size(); var++) {
+        if (_assigns[var] < 0 && (best < 0 || _activity[var] > _activity[best])) {
+            best = var;
+        }
+    }
+    return best;
+}
+
+/* This function runs the CDCL loop: propagate, and on a conflict learn a clause, backtrack to where it is unit and
+ * assign it; otherwise restart when the Luby interval's conflicts are used up, or decide the most active variable in
+ * its saved phase. Learnt clauses are kept for the whole search, which suits the few thousand conflicts the stalemate
+ * instances need. The loop is a profiler phase whose depth is the decision level.
+ */
+SatResult SatSolver::solve() {
+    ProfilePhase phase("cdcl");
+    if (_unsat || propagate() != -1) {
+        _unsat = true;
+        return SatResult::Unsatisfiable;
+    }
+    long restarts = 0;
+    long conflictsLeft = kRestartBase * luby(restarts);
+    Vector<int> learnt;
+    while (true) {
+        int conflict = propagate();
+        if (conflict != -1) {
+            _conflicts++;
+            conflictsLeft--;
+            if (level() == 0) {
+                _unsat = true;
+                return SatResult::Unsatisfiable;
+            }
+            backtrack(analyze(conflict, learnt));
+            enqueue(learnt[0], learnt.size() == 1 ? -1 : attach(learnt));
+            profileDepth(level());
+        } else if (conflictsLeft <= 0) {
+            backtrack(0);
+            conflictsLeft = kRestartBase * luby(++restarts);
+        } else {
+            int var = pickBranchVar();
+            if (var < 0) {
+                return SatResult::Satisfiable;
+            }
+            if (searchShouldStop()) {
+                backtrack(0);
+                return SatResult::Unknown;
+            }
+            _decisions++;
+            _trailLimits.add(_trail.size());
+            enqueue(2 * var + (_phase[var] == 1 ? 0 : 1), -1);
+            profileDepth(level());
+        }
+    }
+}
+
+/** The variables of a stalemate instance: the squares pieces may take, an occupancy variable per square and a
+ * variable per piece instance and square
+ */
+struct SatEncoding {
+    Vector<GridLocation> squares;
+    Vector<int> occupied;
+    Vector<Vector<int>> placed;     // placed[i][s] is true when piece i stands on squares[s]
+};
+
+/* This function takes in two locations and fills in the squares strictly between them, returning false if they are
+ * not on one rank, file or diagonal.
+ */
+static bool squaresBetween(GridLocation from, GridLocation to, Vector<GridLocation> &between) {
+    int dr = to.row - from.row;
+    int dc = to.col - from.col;
+    if (dr != 0 && dc != 0 && abs(dr) != abs(dc)) {
+        return false;
+    }
+    int steps = max(abs(dr), abs(dc));
+    between.clear();
+    for (int i = 1; i < steps; i++) {
+        between.add(GridLocation(from.row + dr / steps * i, from.col + dc / steps * i));
+    }
+    return true;
+}
+
+/* This function takes in a solver and variables and adds clauses making at most one of them true, with the sequential
+ * counter encoding: one extra variable per position records that some earlier variable is true.
+ */
+static void atMostOne(SatSolver &solver, const Vector<int> &vars) {
+    if (vars.size() <= 4) {
+        for (int i = 0; i < vars.size(); i++) {
+            for (int j = i + 1; j < vars.size(); j++) {
+                solver.addClause({-vars[i], -vars[j]});
+            }
+        }
+        return;
+    }
+    int previous = 0;
+    for (int i = 0; i < vars.size(); i++) {
+        int counter = solver.newVar();
+        solver.addClause({-vars[i], counter});
+        if (previous != 0) {
+            solver.addClause({-previous, counter});
+            solver.addClause({-previous, -vars[i]});
+        }
+        previous = counter;
+    }
+}
+
+/* This function takes in a solver, the opponent king location, its neighbourhood and the pieces, adds the stalemate
+ * instance to the solver and returns its variables. Every piece instance gets a variable per square outside the king's
+ * neighbourhood, every piece type a variable per square that is true when one of its instances is there, and every
+ * square an occupancy variable that is true exactly when some piece is there. Exactly one square per instance and at
+ * most one instance per square are required, and equal instances take increasing squares so the solver does not revisit
+ * their permutations. A neighbourhood square is covered by a knight or king on an attacking square, or by a slider on
+ * an attacking line whose squares in between are all empty, expressed with one extra variable per such line. The king's
+ * square is not attacked: no knight or king attacks it, and a slider lined up with it has a piece in between. Lines
+ * through the king's square are blocked by the king and never cover anything. The board is read with the king lifted
+ * off so pieceAttackingLocs gives whole lines.
+ */
+static SatEncoding encodeStalemate(SatSolver &solver, GridLocation kingLoc, const Set<GridLocation> &adjacentLocs,
+                                   const Vector<char> &pieces) {
+    Vector<GridLocation> squares;
+    Grid<int> squareIndex(8, 8, -1);
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            if (!adjacentLocs.contains(GridLocation(row, col))) {
+                squareIndex[row][col] = squares.size();
+                squares.add(GridLocation(row, col));
+            }
+        }
+    }
+
+    Vector<int> occupied;
+    for (int s = 0; s < squares.size(); s++) {
+        occupied.add(solver.newVar());
+    }
+    Vector<Vector<int>> placed(pieces.size());
+    Map<char, Vector<int>> typeAt;
+    for (int i = 0; i < pieces.size(); i++) {
+        for (int s = 0; s < squares.size(); s++) {
+            placed[i].add(solver.newVar());
+        }
+        solver.addClause(placed[i]);
+        atMostOne(solver, placed[i]);
+        if (i > 0 && pieces[i] == pieces[i - 1]) {
+            for (int s = 0; s < squares.size(); s++) {
+                Vector<int> clause = {-placed[i][s]};
+                for (int t = 0; t < s; t++) {
+                    clause.add(placed[i - 1][t]);
+                }
+                solver.addClause(clause);
+            }
+        }
+        if (!typeAt.containsKey(pieces[i])) {
+            for (int s = 0; s < squares.size(); s++) {
+                typeAt[pieces[i]].add(solver.newVar());
+            }
+        }
+        for (int s = 0; s < squares.size(); s++) {
+            solver.addClause({-placed[i][s], typeAt[pieces[i]][s]});
+        }
+    }
+    for (int s = 0; s < squares.size(); s++) {
+        Vector<int> instances;
+        Vector<int> anyType = {-occupied[s]};
+        for (int i = 0; i < pieces.size(); i++) {
+            instances.add(placed[i][s]);
+        }
+        for (char type : typeAt) {
+            Vector<int> clause = {-typeAt[type][s]};
+            for (int i = 0; i < pieces.size(); i++) {
+                if (pieces[i] == type) {
+                    clause.add(placed[i][s]);
+                }
+            }
+            solver.addClause(clause);
+            solver.addClause({-typeAt[type][s], occupied[s]});
+            anyType.add(typeAt[type][s]);
+        }
+        solver.addClause(anyType);
+        atMostOne(solver, instances);
+    }
+
+    Map<GridLocation, Vector<int>> cover;
+    for (GridLocation loc : adjacentLocs) {
+        if (loc != kingLoc) {
+            cover[loc] = Vector<int>();
+        }
+    }
+    char king = _board[kingLoc];
+    _board[kingLoc] = 'E';
+    Vector<GridLocation> between;
+    for (char type : typeAt) {
+        bool slider = isRider(type);
+        for (int s = 0; s < squares.size(); s++) {
+            for (GridLocation target : pieceAttackingLocs(type, squares[s])) {
+                if (target != kingLoc && !cover.containsKey(target)) {
+                    continue;
+                }
+                Vector<int> blockers;
+                bool throughKing = false;
+                if (slider && squaresBetween(squares[s], target, between)) {
+                    for (GridLocation loc : between) {
+                        throughKing |= loc == kingLoc;
+                        if (squareIndex[loc.row][loc.col] >= 0) {
+                            blockers.add(occupied[squareIndex[loc.row][loc.col]]);
+                        }
+                    }
+                }
+                if (throughKing) {
+                    continue;
+                }
+                if (target == kingLoc) {
+                    Vector<int> clause = {-typeAt[type][s]};
+                    solver.addClause(clause + blockers);
+                } else if (blockers.isEmpty()) {
+                    cover[target].add(typeAt[type][s]);
+                } else {
+                    int line = solver.newVar();
+                    solver.addClause({-line, typeAt[type][s]});
+                    for (int blocker : blockers) {
+                        solver.addClause({-line, -blocker});
+                    }
+                    cover[target].add(line);
+                }
+            }
+        }
+    }
+    _board[kingLoc] = king;
+    for (GridLocation target : cover) {
+        solver.addClause(cover[target]);
+    }
+
+    return {squares, occupied, placed};
+}
+
+/* This function takes in a solved encoding and the pieces and returns the placement the solver's assignment gives.
+ */
+static Map<char, Vector<GridLocation>> decodePlacement(const SatSolver &solver, const SatEncoding &encoding,
+                                                       const Vector<char> &pieces) {
+    Map<char, Vector<GridLocation>> placement;
+    for (int i = 0; i < pieces.size(); i++) {
+        for (int s = 0; s < encoding.squares.size(); s++) {
+            if (solver.value(encoding.placed[i][s])) {
+                placement[pieces[i]].add(encoding.squares[s]);
+            }
+        }
+    }
+    return placement;
+}
+
+/* This function takes in the opponent king location and pieces and returns a map of pieces to locations found by the
+ * SAT solver on the instance encodeStalemate builds.
+ */
+Map<char, Vector<GridLocation>> calculateStalemateSat(GridLocation kingLoc, Vector<char> pieces) {
+    Set<GridLocation> adjacentLocs = getAdjacentLocs(kingLoc);
+    SatSolver solver;
+    SatEncoding encoding = encodeStalemate(solver, kingLoc, adjacentLocs, pieces);
+
+    Map<char, Vector<GridLocation>> result;
+    if (solver.solve() == SatResult::Satisfiable) {
+        result = decodePlacement(solver, encoding, pieces);
+        for (char piece : result) {
+            for (GridLocation loc : result[piece]) {
+                _board[loc] = piece;
+            }
+        }
+    } else {
+        placeUselessPieces(pieces, adjacentLocs, kingLoc, result);
+    }
+    return result;
+}
+
+/* This function takes in a placement and returns its occupied squares as a bitboard.
+ */
+static uint64_t occupancyBits(const Map<char, Vector<GridLocation>> &placement) {
+    uint64_t bits = 0;
+    for (char piece : placement) {
+        for (GridLocation loc : placement.get(piece)) {
+            bits |= uint64_t(1) << (loc.row * 8 + loc.col);
+        }
+    }
+    return bits;
+}
+
+int occupancyDistance(const Map<char, Vector<GridLocation>> &a, const Map<char, Vector<GridLocation>> &b) {
+    return countSquares(occupancyBits(a) ^ occupancyBits(b));
+}
+
+/* This function takes in the opponent king location, pieces and k. It encodes the instance once and solves it again
+ * and again on the same solver, which keeps its learnt clauses. After each solution a nogood clause says some square
+ * it occupies is empty, and every square any solution has used is steered toward empty, with its placement variables
+ * false, so the next solve reaches for new squares. Once kDiversePoolFactor * k solutions are found, or none are left,
+ * k are chosen farthest point first: starting from the first solution, each pick is the one whose distance to the
+ * nearest chosen solution is largest.
+ */
+Vector<Map<char, Vector<GridLocation>>> calculateDiverseStalemates(GridLocation kingLoc, Vector<char> pieces, int k) {
+    Vector<Map<char, Vector<GridLocation>>> chosen;
+    if (k <= 0) {
+        return chosen;
+    }
+    SatSolver solver;
+    SatEncoding encoding = encodeStalemate(solver, kingLoc, getAdjacentLocs(kingLoc), pieces);
+    Vector<Map<char, Vector<GridLocation>>> pool;
+    Vector<int> used(encoding.squares.size(), 0);
+    while (pool.size() < kDiversePoolFactor * k && solver.solve() == SatResult::Satisfiable) {
+        pool.add(decodePlacement(solver, encoding, pieces));
+        Vector<int> nogood;
+        for (int s = 0; s < encoding.squares.size(); s++) {
+            if (solver.value(encoding.occupied[s])) {
+                nogood.add(-encoding.occupied[s]);
+                used[s] = 1;
+            }
+        }
+        solver.addClause(nogood);
+        for (int s = 0; s < encoding.squares.size(); s++) {
+            if (used[s]) {
+                solver.prefer(-encoding.occupied[s]);
+                for (int i = 0; i < pieces.size(); i++) {
+                    solver.prefer(-encoding.placed[i][s]);
+                }
+            }
+        }
+    }
+
+    Vector<int> nearest(pool.size(), INT_MAX);
+    int next = pool.isEmpty() ? -1 : 0;
+    while (next >= 0 && chosen.size() < k) {
+        chosen.add(pool[next]);
+        nearest[next] = -1;
+        next = -1;
+        for (int j = 0; j < pool.size(); j++) {
+            if (nearest[j] >= 0) {
+                nearest[j] = min(nearest[j], occupancyDistance(pool[j], chosen.back()));
+                if (next < 0 || nearest[j] > nearest[next]) {
+                    next = j;
+                }
+            }
+        }
+    }
+    return chosen;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+/* This function takes in a solver and DIMACS clauses and returns whether the solver's assignment satisfies them all.
+ */
+static bool satisfies(const SatSolver &solver, const Vector<Vector<int>> &clauses) {
+    for (const Vector<int> &clause : clauses) {
+        bool satisfied = false;
+        for (int literal : clause) {
+            satisfied |= solver.value(abs(literal)) == (literal > 0);
+        }
+        if (!satisfied) {
+            return false;
+        }
+    }
+    return true;
+}
+
+PROVIDED_TEST("SatSolver on pigeonhole and random 3-SAT") {
+    for (int holes = 2; holes <= 5; holes++) {
+        SatSolver solver;
+        Grid<int> in(holes + 1, holes, 0);
+        for (int p = 0; p <= holes; p++) {
+            Vector<int> somewhere;
+            for (int h = 0; h < holes; h++) {
+                in[p][h] = solver.newVar();
+                somewhere.add(in[p][h]);
+            }
+            solver.addClause(somewhere);
+        }
+        for (int h = 0; h < holes; h++) {
+            for (int p = 0; p <= holes; p++) {
+                for (int q = p + 1; q <= holes; q++) {
+                    solver.addClause({-in[p][h], -in[q][h]});
+                }
+            }
+        }
+        EXPECT(solver.solve() == SatResult::Unsatisfiable);
+    }
+
+    setRandomSeed(85);
+    int satisfiable = 0;
+    for (int round = 0; round < 40; round++) {
+        SatSolver solver;
+        int vars = 40;
+        for (int v = 0; v < vars; v++) {
+            solver.newVar();
+        }
+        Vector<Vector<int>> clauses;
+        for (int c = 0; c < 170; c++) {
+            Vector<int> clause;
+            for (int k = 0; k < 3; k++) {
+                clause.add(randomInteger(1, vars) * (randomChance(0.5) ? 1 : -1));
+            }
+            clauses.add(clause);
+            solver.addClause(clause);
+        }
+        resetSearch();
+        if (solver.solve() == SatResult::Satisfiable) {
+            satisfiable++;
+            EXPECT(satisfies(solver, clauses));
+        }
+    }
+    EXPECT(satisfiable > 0 && satisfiable < 40);
+}
+
+PROVIDED_TEST("SAT engine on the large-piece problems") {
+    GridLocation kingLoc = GridLocation(2, 1);
+    for (Vector<char> pieces : Vector<Vector<char>>({{'K', 'H', 'B', 'Q', 'R', 'Q', 'Q', 'Q', 'H', 'H', 'H'},
+                                                     {'K', 'R', 'Q', 'Q', 'Q', 'Q', 'B', 'H', 'H', 'H', 'H'},
+                                                     {'K', 'Q', 'Q', 'Q', 'Q', 'Q', 'R', 'R', 'R', 'R', 'R'}})) {
+        EngineRun run = runEngine(findEngine("sat"), kingLoc, pieces);
+        EXPECT(run.verified);
+        EXPECT(isStalemate(kingLoc, run.result));
+    }
+    for (const Problem &problem : generateCorpus(850, 20, 6)) {
+        bool solvable = false;
+        for (string name : {"greedy", "sorted-greedy", "meet-in-middle"}) {
+            solvable |= runEngine(findEngine(name), problem.kingLoc, problem.pieces).verified;
+        }
+        EXPECT(runEngine(findEngine("sat"), problem.kingLoc, problem.pieces).verified || !solvable);
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("SAT engine against backtracking on the hardest corpus entries") {
+    Vector<Problem> problems = generateCorpus(851, 40, 10);
+    Vector<EngineRun> greedy;
+    for (const Problem &problem : problems) {
+        greedy.add(runEngine(findEngine("sorted-greedy"), problem.kingLoc, problem.pieces, 1, nullptr, 300000));
+    }
+    Vector<int> hardest;
+    for (int i = 0; i < problems.size(); i++) {
+        hardest.add(i);
+    }
+    hardest.sort();
+    for (int i = 0; i < hardest.size(); i++) {
+        for (int j = i + 1; j < hardest.size(); j++) {
+            if (greedy[hardest[j]].nodes > greedy[hardest[i]].nodes) {
+                swap(hardest[i], hardest[j]);
+            }
+        }
+    }
+    for (int k = 0; k < 5; k++) {
+        const Problem &problem = problems[hardest[k]];
+        EngineRun sat = runEngine(findEngine("sat"), problem.kingLoc, problem.pieces);
+        EXPECT(sat.verified);
+        cout << "problem " << hardest[k] << ": sorted-greedy " << greedy[hardest[k]].micros / 1000 << " ms, "
+             << greedy[hardest[k]].nodes << " nodes, verified " << boolalpha << greedy[hardest[k]].verified
+             << "; sat " << sat.micros / 1000 << " ms, " << sat.nodes << " decisions" << endl;
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("SAT engine with fairy pieces") {
+    for (Vector<char> pieces : Vector<Vector<char>>({{'K', 'A'}, {'C', 'C'}, {'K', 'M', 'M', 'C'}, {'A', 'M', 'H'}})) {
+        int verified = 0;
+        for (int square = 0; square < 64; square += 9) {
+            EngineRun run = runEngine(findEngine("sat"), GridLocation(square / 8, square % 8), pieces);
+            verified += run.verified;
+        }
+        cout << pieces << ": " << verified << "/8 king squares stalemated" << endl;
+        EXPECT(verified > 0);
+    }
+    clearBoard();
+}
+
+/* This function takes in placements and returns the smallest occupancy distance between two of them.
+ */
+static int minimumDistance(const Vector<Map<char, Vector<GridLocation>>> &placements) {
+    int smallest = INT_MAX;
+    for (int i = 0; i < placements.size(); i++) {
+        for (int j = i + 1; j < placements.size(); j++) {
+            smallest = min(smallest, occupancyDistance(placements[i], placements[j]));
+        }
+    }
+    return smallest;
+}
+
+PROVIDED_TEST("Diverse stalemates are verified and far apart") {
+    clearBoard();
+    GridLocation kingLoc = GridLocation(0, 0);
+    _board[kingLoc] = 'K';
+    resetSearch();
+    Vector<char> pieces = {'K', 'Q', 'R', 'B'};
+    Vector<Map<char, Vector<GridLocation>>> placements = calculateDiverseStalemates(kingLoc, pieces, 5);
+    EXPECT_EQUAL(placements.size(), 5);
+    for (Map<char, Vector<GridLocation>> &placement : placements) {
+        EXPECT(verifyStalemate(kingLoc, pieces, placement));
+    }
+    EXPECT(minimumDistance(placements) > 0);
+    EXPECT_EQUAL(occupancyDistance(placements[0], placements[0]), 0);
+
+    placements = calculateDiverseStalemates(kingLoc, {'H'}, 3);
+    EXPECT(placements.isEmpty());
+    EXPECT(calculateDiverseStalemates(kingLoc, pieces, 0).isEmpty());
+    clearBoard();
+}
+
+PROVIDED_TEST("Diverse stalemates against independent enumerations") {
+    const int k = 5;
+    Vector<Problem> problems = generateCorpus(1000, 12, 6);
+    double incremental = 0;
+    double independent = 0;
+    int diverseDistance = 0;
+    int plainDistance = 0;
+    for (const Problem &problem : problems) {
+        clearBoard();
+        _board[problem.kingLoc] = 'K';
+        resetSearch();
+        auto start = chrono::steady_clock::now();
+        Vector<Map<char, Vector<GridLocation>>> diverse = calculateDiverseStalemates(problem.kingLoc, problem.pieces,
+                                                                                     k);
+        incremental += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        start = chrono::steady_clock::now();
+        Vector<Map<char, Vector<GridLocation>>> plain;
+        Vector<Vector<int>> nogoods;
+        for (int round = 0; round < kDiversePoolFactor * k; round++) {
+            SatSolver solver;
+            SatEncoding encoding = encodeStalemate(solver, problem.kingLoc, getAdjacentLocs(problem.kingLoc),
+                                                   problem.pieces);
+            for (const Vector<int> &nogood : nogoods) {
+                solver.addClause(nogood);
+            }
+            if (solver.solve() != SatResult::Satisfiable) {
+                break;
+            }
+            plain.add(decodePlacement(solver, encoding, problem.pieces));
+            Vector<int> nogood;
+            for (int s = 0; s < encoding.squares.size(); s++) {
+                if (solver.value(encoding.occupied[s])) {
+                    nogood.add(-encoding.occupied[s]);
+                }
+            }
+            nogoods.add(nogood);
+        }
+        independent += chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+
+        for (Map<char, Vector<GridLocation>> &placement : diverse) {
+            EXPECT(verifyStalemate(problem.kingLoc, problem.pieces, placement));
+        }
+        EXPECT_EQUAL(diverse.size(), min(plain.size(), k));
+        if (diverse.size() == k) {
+            diverseDistance += minimumDistance(diverse);
+            plainDistance += minimumDistance(plain.subList(0, k));
+        }
+    }
+    cout << kDiversePoolFactor * k << " solutions: one incremental search " << incremental / 1000 << " ms, "
+         << kDiversePoolFactor * k << " independent searches " << independent / 1000
+         << " ms; summed minimum occupancy distance among " << k << " chosen: " << diverseDistance
+         << " diverse, " << plainDistance << " first found" << endl;
+    EXPECT(diverseDistance > plainDistance);
+    clearBoard();
+}
@@ -0,0 +1,130 @@
+/*
+ * This file contains the declarations for a small CDCL SAT solver and the stalemate engine that encodes piece placement
+ * as a SAT instance
+ */
+#pragma once
+
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/** Outcome of SatSolver::solve
+ */
+enum class SatResult {
+    Satisfiable,
+    Unsatisfiable,
+    Unknown     // the search was stopped through _search
+};
+
+/** A conflict-driven clause-learning SAT solver with two watched literals per clause, first-UIP learning, activity-based
+ * branching with saved phases and Luby restarts. Literals are written as in DIMACS: variable v is v, its negation -v
+ */
+class SatSolver {
+public:
+    /**
+     * Add a variable
+     * @return its number, counting from 1
+     *
+     * This function runs in O(1)
+     */
+    int newVar();
+
+    /**
+     * Add a clause, the disjunction of its literals. A clause added after solve returns, such as one ruling out the
+     * solution found, takes the solver back to level 0 and is kept with everything learnt for the next solve
+     * @param literals
+     *
+     * This function runs in O(n) for n literals
+     */
+    void addClause(Vector<int> literals);
+
+    /**
+     * Steer the next solve: the literal's variable gets an activity bump, so it is decided early, and is tried with
+     * the literal's value first
+     * @param literal
+     *
+     * This function runs in O(1)
+     */
+    void prefer(int literal);
+
+    /**
+     * Search for an assignment satisfying every clause, counting a search node per decision
+     * @return whether one exists, or Unknown if the search was stopped
+     *
+     * This function runs in O(2^v) for v variables in the worst case
+     */
+    SatResult solve();
+
+    /**
+     * Value of a variable in the assignment found by solve
+     * @param variable
+     * @return true or false
+     *
+     * This function runs in O(1)
+     */
+    bool value(int var) const;
+
+    int numVars() const;
+    int numClauses() const;
+    long conflicts() const;
+    long decisions() const;
+
+private:
+    int litValue(int lit) const;
+    int level() const;
+    void enqueue(int lit, int reason);
+    int propagate();
+    int analyze(int conflict, Vector<int> &learnt);
+    void backtrack(int level);
+    void bump(int var);
+    int pickBranchVar();
+    int attach(const Vector<int> &clause);
+
+    Vector<Vector<int>> _clauses;   // internal literals 2 * var + sign, watched literals first
+    Vector<Vector<int>> _watches;   // clauses watching each literal, visited when it becomes false
+    Vector<int> _assigns;           // -1 unassigned, else 1 for true and 0 for false
+    Vector<int> _levels;
+    Vector<int> _reasons;           // clause that implied each variable, -1 for decisions
+    Vector<double> _activity;
+    Vector<int> _phase;             // last value of each variable, tried first
+    Vector<int> _seen;
+    Vector<int> _trail;
+    Vector<int> _trailLimits;       // trail size at each decision
+    int _propagated = 0;
+    double _bumpAmount = 1;
+    bool _unsat = false;
+    long _conflicts = 0;
+    long _decisions = 0;
+};
+
+/**
+ * Calculates a stalemate position with the SAT solver: one variable per piece and square, exactly one square per
+ * piece, at most one piece per square, every square around the king attacked along an unblocked line and the king
+ * itself not attacked
+ * @param opponent king location and random set of pieces
+ * @return map of pieces to their locations to achieve a stalemate
+ *
+ * This function runs in O(2^v) for v variables in the worst case, with v in O(64n) for n pieces
+ */
+Map<char, Vector<GridLocation>> calculateStalemateSat(GridLocation kingLoc, Vector<char> pieces);
+
+/**
+ * Number of squares occupied in exactly one of two placements
+ * @param two placements
+ * @return Hamming distance of their occupancy
+ *
+ * This function runs in O(n) for n pieces
+ */
+int occupancyDistance(const Map<char, Vector<GridLocation>> &a, const Map<char, Vector<GridLocation>> &b);
+
+/**
+ * Calculates up to k stalemate placements that differ from each other as much as possible, in one incremental SAT
+ * search: each solution found is ruled out by a clause on its occupancy and the solver is steered toward squares not
+ * used yet, and the k farthest apart by occupancyDistance are chosen from the solutions found. The current thread's
+ * board holds only the opponent king and is left that way
+ * @param opponent king location, pieces and number of placements wanted
+ * @return placements, each the farthest from those before it, fewer than k if no more exist
+ *
+ * This function runs in O(k 2^v) for v variables in the worst case, with v in O(64n) for n pieces
+ */
+Vector<Map<char, Vector<GridLocation>>> calculateDiverseStalemates(GridLocation kingLoc, Vector<char> pieces, int k);
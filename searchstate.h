@@ -0,0 +1,97 @@
+/*
+ * This file contains the declarations for a suspendable version of the placePieceGreedy search, whose state can be
+ * paused, serialised and resumed later on any thread
+ */
+#pragma once
+
+#include <string>
+#include "map.h"
+#include "set.h"
+#include "vector.h"
+#include "bitboard.h"
+#include "martin.h"
+
+/** Where a suspendable search stands
+ */
+enum class SearchStatus {
+    Running,    // suspended with work left, or not started
+    Solved,     // the placement is a stalemate
+    Exhausted   // every combination was tried, or the search was stopped through _search
+};
+
+/** The placePieceGreedy search with an explicit stack in place of recursion
+ */
+class GreedySearch {
+public:
+    /**
+     * Start a search for pieces in the given order, as placePieceGreedy would from piece index 0
+     * @param opponent king location and pieces
+     *
+     * This function runs in O(n) for n pieces
+     */
+    GreedySearch(GridLocation kingLoc, Vector<char> pieces);
+
+    /**
+     * Search until solved, exhausted or out of budget; the board is rebuilt from the saved state first, so a search
+     * can be resumed on any thread
+     * @param number of search nodes to visit before suspending, -1 for no limit
+     * @return status after the run
+     *
+     * This function runs in O(k^n) for k optimal moves for n pieces, over all runs of the search
+     */
+    SearchStatus run(long nodeBudget = -1);
+
+    /**
+     * Place the pieces the search did not use, as calculateStalemate does after placePieceGreedy
+     * @return map of every piece to its location
+     *
+     * This function runs in O(n) for n pieces
+     */
+    Map<char, Vector<GridLocation>> finish();
+
+    /**
+     * Save the full search state: pieces, candidate cursor per depth, placement and exclusion set
+     * @return small byte buffer
+     *
+     * This function runs in O(n) for n pieces
+     */
+    std::string serialize() const;
+
+    /**
+     * Rebuild a search saved by serialize
+     * @param byte buffer
+     * @return search ready to resume, raising an error if the buffer is malformed
+     *
+     * This function runs in O(n) for n pieces
+     */
+    static GreedySearch deserialize(const std::string &buffer);
+
+    SearchStatus status() const;
+    long nodes() const;
+    Map<char, Vector<GridLocation>> placement() const;
+
+private:
+    GreedySearch() {}
+    void restoreBoard();
+    void popFrame();
+
+    GridLocation _kingLoc;
+    Vector<char> _pieces;
+    Map<char, Vector<GridLocation>> _moves;
+    Vector<int> _cursors;               // next candidate per depth, -1 until the node is visited
+    Vector<GridLocation> _placed;       // location placed at each depth below the top, the undo log
+    Map<char, Vector<GridLocation>> _result;
+    Set<GridLocation> _exclusion;
+    AttackBoard _attacks;               // rebuilt with the board, not saved
+    SearchStatus _status = SearchStatus::Running;
+    long _nodes = 0;
+};
+
+/**
+ * Whether a registered engine's search is reproduced exactly by GreedySearch
+ * @param engine name and set to whether the engine sorts the pieces first
+ * @return true for calculateStalemate and calculateStalemateAlternative
+ *
+ * This function runs in O(1)
+ */
+bool isResumableEngine(std::string name, bool &sortPieces);
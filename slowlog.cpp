@@ -0,0 +1,347 @@
+/*
+ * This file contains the implementation of the slow-solve log, which captures every engine run slower than a threshold
+ * with its exact input and search statistics to a rotating JSON lines file, and the tool that replays captured runs
+ */
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include "slowlog.h"
+#include "profiler.h"
+#include "strlib.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static mutex logLock;
+static atomic<bool> logEnabled(false);
+static string logFilename;
+static SlowLogOptions logOptions;
+static SlowLogStats logStats;
+static long logBytes = 0;                   // size of the current file
+static double logTokens = 0;                // captures the rate limit allows right now
+static chrono::steady_clock::time_point logRefilled;
+static thread_local bool replaying = false;
+
+void setSlowSolveLog(string filename, SlowLogOptions options) {
+    lock_guard<mutex> lock(logLock);
+    logFilename = filename;
+    logOptions = options;
+    logStats = SlowLogStats();
+    logTokens = options.capturesPerSecond;
+    logRefilled = chrono::steady_clock::now();
+    logBytes = 0;
+    if (!filename.empty()) {
+        ifstream in(filename, ios::binary | ios::ate);
+        if (in) {
+            logBytes = in.tellg();
+        }
+    }
+    logEnabled.store(!filename.empty(), memory_order_release);
+}
+
+SlowLogStats slowSolveLogStats() {
+    lock_guard<mutex> lock(logLock);
+    return logStats;
+}
+
+/* This function takes in a string and returns it as a quoted JSON string, escaping quotes, backslashes and control
+ * characters.
+ */
+static string jsonString(const string &text) {
+    string quoted = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\') {
+            quoted += '\\';
+            quoted += c;
+        } else if ((unsigned char) c < 0x20) {
+            char escape[8];
+            snprintf(escape, sizeof(escape), "\\u%04x", c);
+            quoted += escape;
+        } else {
+            quoted += c;
+        }
+    }
+    return quoted + "\"";
+}
+
+/* This function takes in pieces and returns them as a string, one character per piece.
+ */
+static string piecesString(const Vector<char> &pieces) {
+    string text;
+    for (char piece : pieces) {
+        text += piece;
+    }
+    return text;
+}
+
+/* This function shifts the rotated files up by one, dropping the oldest, and moves the current file to filename.1. It
+ * is called with the log lock held.
+ */
+static void rotateLog() {
+    if (logOptions.keepFiles <= 0) {
+        remove(logFilename.c_str());
+    } else {
+        remove((logFilename + "." + integerToString(logOptions.keepFiles)).c_str());
+        for (int i = logOptions.keepFiles - 1; i >= 1; i--) {
+            string from = logFilename + "." + integerToString(i);
+            rename(from.c_str(), (logFilename + "." + integerToString(i + 1)).c_str());
+        }
+        rename(logFilename.c_str(), (logFilename + ".1").c_str());
+    }
+    logBytes = 0;
+    logStats.rotations++;
+}
+
+/* This function takes in a run and the input and options it was run with. Runs that are fast, replayed or made while
+ * the log is off return after one atomic load. A slow run takes a token from the rate limiter, which refills at
+ * capturesPerSecond up to a burst of that many, and is written as one JSON object per line, rotating the file first
+ * if the line would take it past maxBytes.
+ */
+void captureSlowSolve(const string &engine, GridLocation kingLoc, const Vector<char> &pieces, long nodeBudget,
+                      int repetitions, const EngineRun &run) {
+    if (!logEnabled.load(memory_order_acquire) || replaying) {
+        return;
+    }
+    lock_guard<mutex> lock(logLock);
+    if (logFilename.empty() || run.micros < logOptions.thresholdMicros) {
+        return;
+    }
+    auto now = chrono::steady_clock::now();
+    double seconds = chrono::duration<double>(now - logRefilled).count();
+    logRefilled = now;
+    logTokens = min(logOptions.capturesPerSecond, logTokens + seconds * logOptions.capturesPerSecond);
+    if (logTokens < 1) {
+        logStats.dropped++;
+        return;
+    }
+    logTokens--;
+
+    long long timestamp = chrono::duration_cast<chrono::milliseconds>(
+                              chrono::system_clock::now().time_since_epoch()).count();
+    ostringstream line;
+    line.precision(17);
+    line << "{\"timestamp\":" << timestamp << ",\"king\":[" << kingLoc.row << "," << kingLoc.col << "],\"pieces\":"
+         << jsonString(piecesString(pieces)) << ",\"engine\":" << jsonString(engine)
+         << ",\"nodeBudget\":" << nodeBudget << ",\"repetitions\":" << repetitions << ",\"micros\":" << run.micros
+         << ",\"nodes\":" << run.nodes << ",\"stopped\":" << boolalpha << run.stopped << ",\"verified\":"
+         << run.verified << ",\"threw\":" << run.threw << "}\n";
+    string text = line.str();
+    if (logBytes > 0 && logBytes + long(text.size()) > logOptions.maxBytes) {
+        rotateLog();
+    }
+    ofstream out(logFilename, ios::app | ios::binary);
+    out << text;
+    logBytes += text.size();
+    logStats.captured++;
+}
+
+/* This function takes in a line of the log, a key and a string for the value. It finds the key and copies out its raw
+ * value: the unescaped contents of a string, the contents of an array, or a number or literal up to the next comma
+ * or brace. It returns false if the key is missing or the value is cut off.
+ */
+static bool jsonField(const string &line, const string &key, string &value) {
+    size_t at = line.find("\"" + key + "\":");
+    if (at == string::npos) {
+        return false;
+    }
+    size_t i = at + key.size() + 3;
+    value.clear();
+    if (i < line.size() && line[i] == '"') {
+        for (i++; i < line.size() && line[i] != '"'; i++) {
+            if (line[i] == '\\' && i + 1 < line.size()) {
+                i++;
+                if (line[i] == 'u' && i + 4 < line.size()) {
+                    value += char(strtol(line.substr(i + 1, 4).c_str(), nullptr, 16));
+                    i += 4;
+                    continue;
+                }
+            }
+            value += line[i];
+        }
+        return i < line.size();
+    }
+    char end = i < line.size() && line[i] == '[' ? ']' : 0;
+    if (end) {
+        i++;
+    }
+    for (; i < line.size() && line[i] != (end ? end : ',') && (end || line[i] != '}'); i++) {
+        value += line[i];
+    }
+    return i < line.size() && !value.empty();
+}
+
+/* This function takes in the text of a number and a variable and reads the whole text into it, returning whether it
+ * was a number.
+ */
+template <typename T>
+static bool parseNumber(const string &text, T &value) {
+    istringstream in(text);
+    return (in >> value) && (in >> ws).eof();
+}
+
+/* This function takes in a line of the log and an entry to fill and returns whether every field was read.
+ */
+static bool parseSlowSolve(const string &line, SlowSolve &entry) {
+    string king, pieces, nodeBudget, repetitions, micros, nodes, stopped, verified, threw, timestamp;
+    if (!jsonField(line, "timestamp", timestamp) || !jsonField(line, "king", king)
+            || !jsonField(line, "pieces", pieces) || !jsonField(line, "engine", entry.engine)
+            || !jsonField(line, "nodeBudget", nodeBudget) || !jsonField(line, "repetitions", repetitions)
+            || !jsonField(line, "micros", micros) || !jsonField(line, "nodes", nodes)
+            || !jsonField(line, "stopped", stopped) || !jsonField(line, "verified", verified)
+            || !jsonField(line, "threw", threw)) {
+        return false;
+    }
+    Vector<string> square = stringSplit(king, ",");
+    if (square.size() != 2 || !parseNumber(square[0], entry.kingLoc.row) || !parseNumber(square[1], entry.kingLoc.col)
+            || !parseNumber(timestamp, entry.timestamp) || !parseNumber(nodeBudget, entry.nodeBudget)
+            || !parseNumber(repetitions, entry.repetitions) || !parseNumber(micros, entry.micros)
+            || !parseNumber(nodes, entry.nodes)) {
+        return false;
+    }
+    entry.pieces.clear();
+    for (char piece : pieces) {
+        entry.pieces.add(piece);
+    }
+    entry.stopped = stopped == "true";
+    entry.verified = verified == "true";
+    entry.threw = threw == "true";
+    return true;
+}
+
+Vector<SlowSolve> readSlowSolveLog(string filename) {
+    Vector<SlowSolve> entries;
+    ifstream in(filename);
+    string line;
+    while (getline(in, line)) {
+        SlowSolve entry;
+        if (parseSlowSolve(line, entry)) {
+            entries.add(entry);
+        }
+    }
+    return entries;
+}
+
+/* This function takes in a captured entry and runs its engine again on the same input with the same node budget and
+ * repetitions, marking the thread as replaying so the run is not captured a second time.
+ */
+EngineRun replaySlowSolve(const SlowSolve &entry) {
+    replaying = true;
+    EngineRun run;
+    try {
+        run = runEngine(findEngine(entry.engine), entry.kingLoc, entry.pieces, max(entry.repetitions, 1), nullptr,
+                        entry.nodeBudget);
+    } catch (...) {
+        replaying = false;
+        throw;
+    }
+    replaying = false;
+    return run;
+}
+
+/* This function takes in a log filename, an output stream and an optional folded-stack stream and replays the entries
+ * in order, printing one line per entry. The engines are deterministic, so a different node count or verification
+ * means the code changed since the capture, and the entry is flagged. With a folded-stack stream the whole replay is
+ * one profiling session.
+ */
+int replaySlowSolveLog(string filename, ostream &out, ostream *folded) {
+    Vector<SlowSolve> entries = readSlowSolveLog(filename);
+    bool profiling = folded != nullptr && startProfiler();
+    for (int i = 0; i < entries.size(); i++) {
+        const SlowSolve &entry = entries[i];
+        EngineRun run = replaySlowSolve(entry);
+        bool changed = run.nodes != entry.nodes || run.verified != entry.verified;
+        out << "#" << i << " " << entry.engine << " king " << entry.kingLoc << " pieces "
+            << piecesString(entry.pieces) << ": captured " << entry.micros << " us, "
+            << entry.nodes << " nodes; replayed " << run.micros << " us, " << run.nodes << " nodes"
+            << (run.verified ? ", verified" : ", not verified") << (changed ? " (changed)" : "") << endl;
+    }
+    if (profiling) {
+        ProfileReport report = stopProfiler();
+        writeFoldedStacks(report, *folded);
+        out << report.samples << " profile samples in " << report.stacks.size() << " stacks" << endl;
+    }
+    return entries.size();
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Slow-solve log captures, rotates and replays") {
+    string logFile = "slowsolves_test.jsonl";
+    for (string name : {logFile, logFile + ".1", logFile + ".2"}) {
+        remove(name.c_str());
+    }
+    SlowLogOptions options;
+    options.thresholdMicros = 0;
+    options.maxBytes = 600;
+    options.keepFiles = 2;
+    options.capturesPerSecond = 1000;
+    setSlowSolveLog(logFile, options);
+    Vector<Problem> problems = generateCorpus(980, 10, 6);
+    Vector<EngineRun> runs;
+    for (const Problem &problem : problems) {
+        runs.add(runEngine(findEngine("sat"), problem.kingLoc, problem.pieces, 1, nullptr, 50000));
+    }
+    SlowLogStats stats = slowSolveLogStats();
+    EXPECT_EQUAL(stats.captured, problems.size());
+    EXPECT_EQUAL(stats.dropped, 0);
+    EXPECT(stats.rotations > 0);
+
+    Vector<SlowSolve> entries = readSlowSolveLog(logFile + ".2") + readSlowSolveLog(logFile + ".1")
+                                + readSlowSolveLog(logFile);
+    EXPECT(!entries.isEmpty() && entries.size() < problems.size());
+    int first = problems.size() - entries.size();
+    for (int i = 0; i < entries.size(); i++) {
+        const SlowSolve &entry = entries[i];
+        EXPECT_EQUAL(entry.kingLoc, problems[first + i].kingLoc);
+        EXPECT(entry.pieces.equals(problems[first + i].pieces));
+        EXPECT_EQUAL(entry.engine, "sat");
+        EXPECT_EQUAL(entry.nodeBudget, 50000);
+        EXPECT_EQUAL(entry.nodes, runs[first + i].nodes);
+        EXPECT_EQUAL(entry.verified, runs[first + i].verified);
+        EXPECT(entry.timestamp > 0);
+        EngineRun replayed = replaySlowSolve(entry);
+        EXPECT_EQUAL(replayed.nodes, entry.nodes);
+        EXPECT_EQUAL(replayed.verified, entry.verified);
+    }
+    EXPECT_EQUAL(slowSolveLogStats().captured, problems.size());
+
+    ostringstream report;
+    ostringstream folded;
+    EXPECT_EQUAL(replaySlowSolveLog(logFile, report, &folded), readSlowSolveLog(logFile).size());
+    EXPECT(report.str().find("(changed)") == string::npos);
+    EXPECT(report.str().find("profile samples") != string::npos);
+    setSlowSolveLog("");
+    for (string name : {logFile, logFile + ".1", logFile + ".2"}) {
+        remove(name.c_str());
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Slow-solve log threshold and rate limit") {
+    string logFile = "slowsolves_limit_test.jsonl";
+    remove(logFile.c_str());
+    SlowLogOptions options;
+    options.thresholdMicros = 1e9;
+    setSlowSolveLog(logFile, options);
+    GridLocation kingLoc = GridLocation(2, 1);
+    runEngine(findEngine("greedy"), kingLoc, {'K', 'Q', 'Q', 'R'});
+    EXPECT_EQUAL(slowSolveLogStats().captured, 0);
+
+    options.thresholdMicros = 0;
+    options.capturesPerSecond = 2;
+    setSlowSolveLog(logFile, options);
+    for (int i = 0; i < 20; i++) {
+        runEngine(findEngine("greedy"), kingLoc, {'K', 'Q', 'Q', 'R'});
+    }
+    SlowLogStats stats = slowSolveLogStats();
+    setSlowSolveLog("");
+    EXPECT(stats.captured >= 2 && stats.captured <= 3);
+    EXPECT_EQUAL(stats.captured + stats.dropped, 20);
+    EXPECT_EQUAL(readSlowSolveLog(logFile).size(), stats.captured);
+    remove(logFile.c_str());
+    clearBoard();
+}
@@ -0,0 +1,99 @@
+/*
+ * This file contains the declarations for the slow-solve log, which captures every engine run slower than a threshold
+ * with its exact input and search statistics to a rotating JSON lines file, and the tool that replays captured runs
+ */
+#pragma once
+
+#include <iostream>
+#include <string>
+#include "vector.h"
+#include "engines.h"
+
+/** Settings of the slow-solve log
+ */
+struct SlowLogOptions {
+    double thresholdMicros = 50000;     // runs at least this slow are captured
+    long maxBytes = 1 << 20;            // the file is rotated before it grows past this
+    int keepFiles = 3;                  // rotated files kept as filename.1 (newest) to filename.keepFiles
+    double capturesPerSecond = 10;      // sustained capture rate; a burst of up to this many is allowed
+};
+
+/** One captured run: the input and options it was run with, and what the search did
+ */
+struct SlowSolve {
+    long long timestamp = 0;            // milliseconds since the Unix epoch when the run finished
+    GridLocation kingLoc;
+    Vector<char> pieces;
+    std::string engine;
+    long nodeBudget = -1;
+    int repetitions = 1;
+    double micros = 0;                  // wall time of the fastest repetition
+    long nodes = 0;
+    bool stopped = false;
+    bool verified = false;
+    bool threw = false;
+};
+
+/** Counters of the slow-solve log since it was last set
+ */
+struct SlowLogStats {
+    long captured = 0;
+    long dropped = 0;                   // slow runs not written because the rate limit was reached
+    long rotations = 0;
+};
+
+/**
+ * Start capturing slow runs of runEngine to a file, or stop with an empty filename. The file keeps any entries it has
+ * and the counters start again from zero
+ * @param filename and options
+ *
+ * This function runs in O(1)
+ */
+void setSlowSolveLog(std::string filename, SlowLogOptions options = SlowLogOptions());
+
+/**
+ * Capture a run if the log is set, the run is slow enough and the rate limit allows it; runEngine calls this after
+ * every run, and runs replayed by replaySlowSolve are never captured again
+ * @param engine name, opponent king location, pieces, node budget, repetitions and the run
+ *
+ * This function runs in O(n) for n pieces when the run is captured, in O(1) otherwise
+ */
+void captureSlowSolve(const std::string &engine, GridLocation kingLoc, const Vector<char> &pieces, long nodeBudget,
+                      int repetitions, const EngineRun &run);
+
+/**
+ * Counters of the current log
+ * @return captured, dropped and rotation counts
+ *
+ * This function runs in O(1)
+ */
+SlowLogStats slowSolveLogStats();
+
+/**
+ * Read a slow-solve log file, one JSON object per line, skipping lines that do not parse
+ * @param filename
+ * @return captured runs in file order
+ *
+ * This function runs in O(b) for b bytes
+ */
+Vector<SlowSolve> readSlowSolveLog(std::string filename);
+
+/**
+ * Run a captured entry again with the same engine, input and options, without capturing it
+ * @param captured run
+ * @return the new run
+ *
+ * This function runs in the time of the engine on the captured input
+ */
+EngineRun replaySlowSolve(const SlowSolve &entry);
+
+/**
+ * Replay every entry of a slow-solve log file and print each one's captured and replayed time and nodes, flagging
+ * entries whose node count or verification changed. Given a stream for folded stacks, the replays run under the
+ * sampling profiler and its folded stacks are written there
+ * @param filename, output stream and optional folded-stack stream
+ * @return number of entries replayed
+ *
+ * This function runs in the time of the engines on the captured inputs
+ */
+int replaySlowSolveLog(std::string filename, std::ostream &out, std::ostream *folded = nullptr);
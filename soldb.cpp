@@ -0,0 +1,512 @@
+/*
+ * This file contains the implementation of the solution database: a file of verified solutions keyed by the canonical
+ * form of their problem, memory mapped and hot-swappable while lookups are running
+ */
+#include <cstring>
+#include <fstream>
+#include <thread>
+#include <vector>
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#include "soldb.h"
+#include "error.h"
+#include "hashset.h"
+#include "placement.h"
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+static const char kDbMagic[4] = {'M', 'S', 'D', 'B'};
+static const int kDbVersion = 1;
+static const int kHeaderBytes = 32;
+static const int kRecordBytes = 32;
+static const int kKeyBytes = 2 + kMaxDbPieces;  // king square, number of pieces, pieces
+
+/** A published database file: the mapped bytes, or a heap copy where mmap is not available
+ */
+struct SolutionDatabase::Snapshot {
+    const unsigned char *data = nullptr;
+    size_t size = 0;
+    int count = 0;
+    long generation = 0;
+    bool mapped = false;
+    Vector<LargeBlock> replicas;    // copies of data, one per NUMA node or one on huge pages, read in its place
+};
+
+/* This function takes in a buffer and little-endian bytes and returns the value stored there.
+ */
+static uint64_t readBytes(const unsigned char *data, int bytes) {
+    uint64_t value = 0;
+    for (int i = 0; i < bytes; i++) {
+        value |= uint64_t(data[i]) << (8 * i);
+    }
+    return value;
+}
+
+/* This function takes in a buffer, a value and a number of bytes and appends the value little-endian.
+ */
+static void writeBytes(string &buffer, uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buffer += char((value >> (8 * i)) & 0xFF);
+    }
+}
+
+/* This function takes in bytes and returns their 64-bit FNV-1a hash, used as the database checksum.
+ */
+static uint64_t checksum(const unsigned char *data, size_t size) {
+    uint64_t hash = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ data[i]) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+/* This function takes in a canonical king location and canonical pieces and fills in the record key: the king square,
+ * the number of pieces and the pieces padded with zeros. Keys compare with memcmp.
+ */
+static void encodeKey(GridLocation kingLoc, const Vector<char> &pieces, unsigned char *key) {
+    memset(key, 0, kKeyBytes);
+    key[0] = kingLoc.row * 8 + kingLoc.col;
+    key[1] = pieces.size();
+    for (int i = 0; i < pieces.size(); i++) {
+        key[2 + i] = pieces[i];
+    }
+}
+
+/* This function takes in problems and an engine and solves each canonical problem once, keeping the verified
+ * solutions with the piece locations listed in canonical piece order.
+ */
+Vector<DbEntry> buildDbEntries(Vector<Problem> problems, Engine engine) {
+    Vector<DbEntry> entries;
+    HashSet<string> seen;
+    for (const Problem &problem : problems) {
+        string key = canonicalKey(problem.kingLoc, problem.pieces);
+        if (seen.contains(key)) {
+            continue;
+        }
+        seen.add(key);
+        DbEntry entry;
+        entry.kingLoc = transformLoc(problem.kingLoc, canonicalSymmetry(problem.kingLoc));
+        entry.pieces = canonicalPieces(problem.pieces);
+        EngineRun run = runEngine(engine, entry.kingLoc, entry.pieces);
+        if (!run.verified || entry.pieces.size() > kMaxDbPieces) {
+            continue;
+        }
+        for (int i = 0; i < entry.pieces.size(); i++) {
+            if (i == 0 || entry.pieces[i] != entry.pieces[i - 1]) {
+                for (GridLocation loc : run.result[entry.pieces[i]]) {
+                    entry.locs.add(loc);
+                }
+            }
+        }
+        entries.add(entry);
+    }
+    return entries;
+}
+
+/* This function takes in a filename and entries and writes the database: the header, then one record per canonical
+ * problem sorted by key so lookups can binary search. A record is the key followed by the square of each piece. Entries
+ * with the same key as an earlier one are dropped.
+ */
+void writeSolutionDatabase(string filename, Vector<DbEntry> entries) {
+    Vector<string> records;
+    for (const DbEntry &entry : entries) {
+        if (entry.pieces.size() > kMaxDbPieces || entry.locs.size() != entry.pieces.size()) {
+            error("Database entry does not fit in a record");
+        }
+        unsigned char record[kRecordBytes] = {};
+        encodeKey(entry.kingLoc, entry.pieces, record);
+        for (int i = 0; i < entry.locs.size(); i++) {
+            record[kKeyBytes + i] = entry.locs[i].row * 8 + entry.locs[i].col;
+        }
+        records.add(string((const char *) record, kRecordBytes));
+    }
+    records.sort();
+
+    string body;
+    int count = 0;
+    for (int i = 0; i < records.size(); i++) {
+        if (i == 0 || records[i].compare(0, kKeyBytes, records[i - 1], 0, kKeyBytes) != 0) {
+            body += records[i];
+            count++;
+        }
+    }
+    string header(kDbMagic, 4);
+    writeBytes(header, kDbVersion, 4);
+    writeBytes(header, kRecordBytes, 4);
+    writeBytes(header, count, 4);
+    writeBytes(header, checksum((const unsigned char *) body.data(), body.size()), 8);
+    writeBytes(header, 0, kHeaderBytes - header.size());
+
+    ofstream out(filename, ios::binary);
+    out << header << body;
+    if (!out) {
+        error("Cannot write solution database " + filename);
+    }
+}
+
+/* This function takes in a snapshot and releases its bytes.
+ */
+static void freeSnapshot(SolutionDatabase::Snapshot *snapshot) {
+    if (snapshot == nullptr) {
+        return;
+    }
+#if defined(__unix__) || defined(__APPLE__)
+    if (snapshot->mapped) {
+        munmap((void *) snapshot->data, snapshot->size);
+    }
+#endif
+    if (!snapshot->mapped) {
+        delete[] snapshot->data;
+    }
+    for (LargeBlock &replica : snapshot->replicas) {
+        freeLarge(replica);
+    }
+    delete snapshot;
+}
+
+/* This function takes in a filename and returns the file's bytes as a snapshot, memory mapped where the platform allows
+ * and read into memory otherwise. It raises an error if the file cannot be opened.
+ */
+static SolutionDatabase::Snapshot *mapSnapshot(const string &filename) {
+    SolutionDatabase::Snapshot *snapshot = new SolutionDatabase::Snapshot;
+#if defined(__unix__) || defined(__APPLE__)
+    int fd = open(filename.c_str(), O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        delete snapshot;
+        error("Cannot open solution database " + filename);
+    }
+    snapshot->size = info.st_size;
+    if (snapshot->size > 0) {
+        void *data = mmap(nullptr, snapshot->size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+            delete snapshot;
+            error("Cannot map solution database " + filename);
+        }
+        snapshot->data = (const unsigned char *) data;
+        snapshot->mapped = true;
+    } else {
+        close(fd);
+    }
+#else
+    ifstream in(filename, ios::binary);
+    if (!in) {
+        delete snapshot;
+        error("Cannot open solution database " + filename);
+    }
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    unsigned char *data = new unsigned char[contents.size()];
+    memcpy(data, contents.data(), contents.size());
+    snapshot->data = data;
+    snapshot->size = contents.size();
+#endif
+    return snapshot;
+}
+
+/* This function takes in a snapshot and returns why it is not a valid database, or an empty string if it is: the
+ * header must match, the size must match the record count, the checksum must match and the records must be strictly
+ * sorted with valid squares, since lookups rely on all of these without checking again.
+ */
+static string validateSnapshot(SolutionDatabase::Snapshot *snapshot) {
+    const unsigned char *data = snapshot->data;
+    if (snapshot->size < size_t(kHeaderBytes) || memcmp(data, kDbMagic, 4) != 0) {
+        return "not a solution database";
+    }
+    if (readBytes(data + 4, 4) != uint64_t(kDbVersion) || readBytes(data + 8, 4) != uint64_t(kRecordBytes)) {
+        return "unsupported version";
+    }
+    uint64_t count = readBytes(data + 12, 4);
+    if (snapshot->size != kHeaderBytes + count * kRecordBytes) {
+        return "size does not match record count";
+    }
+    if (readBytes(data + 16, 8) != checksum(data + kHeaderBytes, count * kRecordBytes)) {
+        return "checksum mismatch";
+    }
+    for (uint64_t i = 0; i < count; i++) {
+        const unsigned char *record = data + kHeaderBytes + i * kRecordBytes;
+        if (record[0] >= 64 || record[1] > kMaxDbPieces) {
+            return "invalid record";
+        }
+        for (int j = 0; j < record[1]; j++) {
+            if (record[kKeyBytes + j] >= 64) {
+                return "invalid record";
+            }
+        }
+        if (i > 0 && memcmp(record - kRecordBytes, record, kKeyBytes) >= 0) {
+            return "records out of order";
+        }
+    }
+    snapshot->count = count;
+    return "";
+}
+
+SolutionDatabase::SolutionDatabase() : _current(nullptr), _epoch(0) {
+    _readers[0] = 0;
+    _readers[1] = 0;
+}
+
+SolutionDatabase::~SolutionDatabase() {
+    freeSnapshot(_current.load());
+}
+
+/* This function takes in a variable for the reader slot and registers a lookup with the reader counter of the current
+ * epoch's parity before loading the published snapshot. It is wait-free: one load, one increment, one load.
+ */
+SolutionDatabase::Snapshot *SolutionDatabase::enterRead(int &slot) const {
+    slot = _epoch.load() & 1;
+    _readers[slot].fetch_add(1);
+    return _current.load();
+}
+
+void SolutionDatabase::exitRead(int slot) const {
+    _readers[slot].fetch_sub(1);
+}
+
+/* This function takes in a filename and publishes it as the database. The file is mapped and validated before anything
+ * is published, so a bad file leaves the current database in place. Publishing swaps the snapshot pointer, then flips
+ * the epoch twice, each time waiting for the lookups counted under the old parity to finish. A lookup that could still
+ * hold the old pointer registered before the swap under one of the two parities, so after both waits nobody is reading
+ * the old snapshot and it is unmapped. Lookups never wait; only reload does.
+ */
+void SolutionDatabase::reload(string filename) {
+    Snapshot *next = mapSnapshot(filename);
+    string problem = validateSnapshot(next);
+    if (!problem.empty()) {
+        freeSnapshot(next);
+        error("Invalid solution database " + filename + ": " + problem);
+    }
+
+    lock_guard<mutex> lock(_reloadLock);
+    if (_replicatePerNode || _hugePages) {
+        int replicas = _replicatePerNode ? numaNodeCount() : 1;
+        for (int node = 0; node < replicas; node++) {
+            next->replicas.add(replicateOnNode(next->data, next->size, _replicatePerNode ? node : currentNumaNode(),
+                                               _hugePages));
+        }
+    }
+    next->generation = ++_generation;
+    Snapshot *old = _current.exchange(next);
+    for (int flip = 0; flip < 2; flip++) {
+        long epoch = _epoch.fetch_add(1);
+        while (_readers[epoch & 1].load() != 0) {
+            this_thread::yield();
+        }
+    }
+    freeSnapshot(old);
+}
+
+/* This function takes in whether to use huge pages and whether to replicate per NUMA node and keeps them for the
+ * next reload.
+ */
+void SolutionDatabase::setPlacement(bool hugePages, bool replicatePerNode) {
+    lock_guard<mutex> lock(_reloadLock);
+    _hugePages = hugePages;
+    _replicatePerNode = replicatePerNode;
+}
+
+/* This function takes in a problem and a map for its solution. It puts the problem in canonical form, binary searches
+ * the published records for its key, reading the replica on the calling thread's node if there is one, and maps the
+ * stored squares back through the inverse symmetry.
+ */
+bool SolutionDatabase::lookup(GridLocation kingLoc, Vector<char> pieces,
+                              Map<char, Vector<GridLocation>> &result) const {
+    Vector<char> sorted = canonicalPieces(pieces);
+    if (sorted.size() > kMaxDbPieces) {
+        return false;
+    }
+    int symmetry = canonicalSymmetry(kingLoc);
+    unsigned char key[kKeyBytes];
+    encodeKey(transformLoc(kingLoc, symmetry), sorted, key);
+
+    int slot;
+    Snapshot *snapshot = enterRead(slot);
+    const unsigned char *found = nullptr;
+    if (snapshot != nullptr) {
+        const unsigned char *data = snapshot->data;
+        if (!snapshot->replicas.isEmpty()) {
+            data = snapshot->replicas[currentNumaNode() % snapshot->replicas.size()].data;
+        }
+        int low = 0;
+        int high = snapshot->count - 1;
+        while (low <= high && found == nullptr) {
+            int mid = (low + high) / 2;
+            const unsigned char *record = data + kHeaderBytes + size_t(mid) * kRecordBytes;
+            int order = memcmp(record, key, kKeyBytes);
+            if (order == 0) {
+                found = record;
+            } else if (order < 0) {
+                low = mid + 1;
+            } else {
+                high = mid - 1;
+            }
+        }
+    }
+    if (found != nullptr) {
+        result.clear();
+        int inverse = inverseSymmetry(symmetry);
+        for (int i = 0; i < sorted.size(); i++) {
+            int square = found[kKeyBytes + i];
+            result[sorted[i]].add(transformLoc(GridLocation(square / 8, square % 8), inverse));
+        }
+    }
+    exitRead(slot);
+    return found != nullptr;
+}
+
+int SolutionDatabase::size() const {
+    int slot;
+    Snapshot *snapshot = enterRead(slot);
+    int count = snapshot == nullptr ? 0 : snapshot->count;
+    exitRead(slot);
+    return count;
+}
+
+long SolutionDatabase::generation() const {
+    int slot;
+    Snapshot *snapshot = enterRead(slot);
+    long generation = snapshot == nullptr ? 0 : snapshot->generation;
+    exitRead(slot);
+    return generation;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Solution database round trip") {
+    Vector<Problem> problems = generateCorpus(820, 30, 6);
+    Vector<DbEntry> entries = buildDbEntries(problems, findEngine("greedy"));
+    string dbFile = "soldb_test.db";
+    writeSolutionDatabase(dbFile, entries);
+
+    SolutionDatabase db;
+    Map<char, Vector<GridLocation>> result;
+    EXPECT(!db.lookup(problems[0].kingLoc, problems[0].pieces, result));
+    db.reload(dbFile);
+    EXPECT_EQUAL(db.size(), entries.size());
+    EXPECT_EQUAL(db.generation(), 1);
+    int found = 0;
+    for (const Problem &problem : problems) {
+        Vector<char> reversed = problem.pieces;
+        reversed.reverse();
+        GridLocation moved = transformLoc(problem.kingLoc, 5);
+        if (db.lookup(problem.kingLoc, problem.pieces, result)) {
+            found++;
+            EXPECT(verifyStalemate(problem.kingLoc, problem.pieces, result));
+            EXPECT(db.lookup(moved, reversed, result));
+            EXPECT(verifyStalemate(moved, reversed, result));
+        }
+    }
+    EXPECT(entries.size() > 0);
+    EXPECT(found >= entries.size());
+    remove(dbFile.c_str());
+    clearBoard();
+}
+
+PROVIDED_TEST("Solution database rejects invalid files") {
+    string dbFile = "soldb_test.db";
+    string badFile = "soldb_bad_test.db";
+    writeSolutionDatabase(dbFile, buildDbEntries(generateCorpus(821, 10, 5), findEngine("greedy")));
+    SolutionDatabase db;
+    db.reload(dbFile);
+    int size = db.size();
+
+    ifstream in(dbFile, ios::binary);
+    string contents((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+    for (string bad : {contents.substr(0, contents.size() - 1), contents.substr(0, 10), string("not a database")}) {
+        ofstream(badFile, ios::binary) << bad;
+        EXPECT_ERROR(db.reload(badFile));
+    }
+    contents[kHeaderBytes + kKeyBytes] ^= 1;
+    ofstream(badFile, ios::binary) << contents;
+    EXPECT_ERROR(db.reload(badFile));
+    EXPECT_ERROR(db.reload("missing_soldb_test.db"));
+    EXPECT_EQUAL(db.size(), size);
+    EXPECT_EQUAL(db.generation(), 1);
+    remove(dbFile.c_str());
+    remove(badFile.c_str());
+    clearBoard();
+}
+
+PROVIDED_TEST("Lookups run during hot reloads") {
+    Vector<Problem> problems = generateCorpus(822, 20, 5);
+    Vector<DbEntry> entries = buildDbEntries(problems, findEngine("greedy"));
+    Vector<string> files = {"soldb_a_test.db", "soldb_b_test.db"};
+    writeSolutionDatabase(files[0], entries);
+    entries.removeBack();
+    writeSolutionDatabase(files[1], entries);
+
+    SolutionDatabase db;
+    db.reload(files[0]);
+    atomic<bool> done(false);
+    atomic<long> lookups(0);
+    atomic<long> failures(0);
+    vector<thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&]() {
+            Map<char, Vector<GridLocation>> result;
+            while (!done) {
+                for (const Problem &problem : problems) {
+                    if (db.lookup(problem.kingLoc, problem.pieces, result)) {
+                        failures += !verifyStalemate(problem.kingLoc, problem.pieces, result);
+                    }
+                    lookups++;
+                }
+            }
+        });
+    }
+    while (lookups == 0) {
+        this_thread::yield();
+    }
+    for (int i = 1; i <= 50; i++) {
+        db.reload(files[i % 2]);
+    }
+    done = true;
+    for (thread &t : readers) {
+        t.join();
+    }
+    EXPECT_EQUAL(failures.load(), 0);
+    EXPECT(lookups > 0);
+    EXPECT_EQUAL(db.generation(), 51);
+    EXPECT_EQUAL(db.size(), entries.size() + 1);
+    for (string file : files) {
+        remove(file.c_str());
+    }
+    clearBoard();
+}
+
+PROVIDED_TEST("Solution database on huge pages and per-node replicas") {
+    Vector<Problem> problems = generateCorpus(823, 20, 5);
+    string dbFile = "soldb_test.db";
+    writeSolutionDatabase(dbFile, buildDbEntries(problems, findEngine("greedy")));
+    SolutionDatabase db;
+    db.setPlacement(true, true);
+    db.reload(dbFile);
+    vector<thread> readers;
+    atomic<long> found(0);
+    for (int node = 0; node < numaNodeCount(); node++) {
+        readers.emplace_back([&, node]() {
+            pinThreadToNode(node);
+            Map<char, Vector<GridLocation>> result;
+            for (const Problem &problem : problems) {
+                if (db.lookup(problem.kingLoc, problem.pieces, result)) {
+                    found += verifyStalemate(problem.kingLoc, problem.pieces, result);
+                }
+            }
+        });
+    }
+    for (thread &t : readers) {
+        t.join();
+    }
+    EXPECT(found.load() >= db.size() * numaNodeCount());
+    remove(dbFile.c_str());
+    clearBoard();
+}
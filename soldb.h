@@ -0,0 +1,110 @@
+/*
+ * This file contains the declarations for the solution database: a file of verified solutions keyed by the canonical
+ * form of their problem, memory mapped and hot-swappable while lookups are running
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "map.h"
+#include "vector.h"
+#include "engines.h"
+#include "martin.h"
+
+/** Most pieces, the opponent king included, a database record can hold
+ */
+const int kMaxDbPieces = 15;
+
+/** A solution in canonical form: the king on its canonical square and the pieces in canonical order
+ */
+struct DbEntry {
+    GridLocation kingLoc;
+    Vector<char> pieces;
+    Vector<GridLocation> locs;  // location of each piece, in the order of pieces
+};
+
+/**
+ * Solve problems and keep the verified solutions, one entry per canonical problem
+ * @param problems and engine to solve them with
+ * @return entries in canonical form
+ *
+ * This function runs in O(p * s) for p problems taking s to solve
+ */
+Vector<DbEntry> buildDbEntries(Vector<Problem> problems, Engine engine);
+
+/**
+ * Write a database file: a header with the record count and a checksum, then fixed-size records sorted by key
+ * @param filename and entries, raising an error if an entry has too many pieces
+ *
+ * This function runs in O(n log n) for n entries
+ */
+void writeSolutionDatabase(std::string filename, Vector<DbEntry> entries);
+
+/** A solution database that can be reloaded from a new file while other threads look up solutions
+ */
+class SolutionDatabase {
+public:
+    SolutionDatabase();
+    ~SolutionDatabase();
+    SolutionDatabase(const SolutionDatabase &) = delete;
+    SolutionDatabase &operator=(const SolutionDatabase &) = delete;
+
+    /**
+     * Map a database file, validate its header and checksum and publish it in place of the current one, which is
+     * unmapped once the lookups reading it have finished
+     * @param filename, raising an error and keeping the current database if the file is missing or invalid
+     *
+     * This function runs in O(n) for n records, plus the time for in-flight lookups to drain
+     */
+    void reload(std::string filename);
+
+    /**
+     * Choose where later reloads place the records: on huge pages, and as one copy per NUMA node first touched on that
+     * node so each lookup reads memory local to its thread. By default lookups read the mapped file directly
+     * @param whether to use huge pages and whether to replicate per node
+     *
+     * This function runs in O(1)
+     */
+    void setPlacement(bool hugePages, bool replicatePerNode);
+
+    /**
+     * Look up a problem's solution; never blocks, even while a reload is in progress
+     * @param opponent king location, pieces and map to fill with the solution
+     * @return whether the problem, up to symmetry and piece order, is in the database
+     *
+     * This function runs in O(log n + p log p) for n records and p pieces
+     */
+    bool lookup(GridLocation kingLoc, Vector<char> pieces, Map<char, Vector<GridLocation>> &result) const;
+
+    /**
+     * Number of records in the published database
+     * @return 0 before the first reload
+     *
+     * This function runs in O(1)
+     */
+    int size() const;
+
+    /**
+     * Number of reloads published so far
+     * @return generation of the published database
+     *
+     * This function runs in O(1)
+     */
+    long generation() const;
+
+    struct Snapshot;    // a published file, opaque outside soldb.cpp
+
+private:
+    Snapshot *enterRead(int &slot) const;
+    void exitRead(int slot) const;
+
+    std::atomic<Snapshot *> _current;
+    mutable std::atomic<long> _epoch;       // parity picks the reader counter new lookups join
+    mutable std::atomic<long> _readers[2];  // lookups in flight per epoch parity
+    std::mutex _reloadLock;
+    long _generation = 0;
+    bool _hugePages = false;
+    bool _replicatePerNode = false;
+};
@@ -0,0 +1,179 @@
+/*
+ * This file contains the implementation of the symmetries of the board (rotations and reflections) and the canonical
+ * form of a problem under them
+ */
+#include "symmetry.h"
+#include "testing/SimpleTest.h"
+
+using namespace std;
+
+/* This function takes in a location and a symmetry. Bit 2 of the symmetry transposes the board, then bit 0 flips the
+ * rows and bit 1 flips the columns, which gives all eight symmetries of the square.
+ */
+GridLocation transformLoc(GridLocation loc, int symmetry) {
+    int row = loc.row;
+    int col = loc.col;
+    if (symmetry & 4) {
+        swap(row, col);
+    }
+    if (symmetry & 1) {
+        row = 7 - row;
+    }
+    if (symmetry & 2) {
+        col = 7 - col;
+    }
+    return GridLocation(row, col);
+}
+
+/* This function takes in a symmetry and returns its inverse. Flips on their own undo themselves; with a transpose the
+ * row and column flips trade places.
+ */
+int inverseSymmetry(int symmetry) {
+    if (symmetry & 4) {
+        return 4 | ((symmetry & 1) << 1) | ((symmetry & 2) >> 1);
+    }
+    return symmetry;
+}
+
+/* This function takes in a placement and a symmetry and returns the placement with every location transformed.
+ */
+Map<char, Vector<GridLocation>> transformPlacement(Map<char, Vector<GridLocation>> placement, int symmetry) {
+    Map<char, Vector<GridLocation>> result;
+    for (char piece : placement) {
+        for (GridLocation loc : placement[piece]) {
+            result[piece].add(transformLoc(loc, symmetry));
+        }
+    }
+    return result;
+}
+
+/* This function takes in the opponent king location and returns the smallest symmetry that moves it to the lowest
+ * numbered square in its orbit.
+ */
+int canonicalSymmetry(GridLocation kingLoc) {
+    int best = 0;
+    int bestSquare = 64;
+    for (int symmetry = 0; symmetry < kNumSymmetries; symmetry++) {
+        GridLocation loc = transformLoc(kingLoc, symmetry);
+        if (loc.row * 8 + loc.col < bestSquare) {
+            bestSquare = loc.row * 8 + loc.col;
+            best = symmetry;
+        }
+    }
+    return best;
+}
+
+/* This function takes in a king location and returns its index among the canonical squares, numbering them once in a
+ * table.
+ */
+int canonicalKingIndex(GridLocation kingLoc) {
+    static const Vector<int> indices = []() {
+        Vector<int> table(64, -1);
+        int next = 0;
+        for (int square = 0; square < 64; square++) {
+            GridLocation loc(square / 8, square % 8);
+            if (transformLoc(loc, canonicalSymmetry(loc)) == loc) {
+                table[square] = next++;
+            }
+        }
+        return table;
+    }();
+    return indices[kingLoc.row * 8 + kingLoc.col];
+}
+
+/* This function takes in an index and returns the canonical king square with that index: the canonical squares are
+ * those with row <= col <= 3, numbered row by row.
+ */
+GridLocation canonicalKingSquare(int index) {
+    int row = 0;
+    while (index >= 4 - row) {
+        index -= 4 - row;
+        row++;
+    }
+    return GridLocation(row, row + index);
+}
+
+/* This function takes in pieces and returns them sorted with the kings moved to the front, so the result keeps the
+ * king-first order the engines expect.
+ */
+Vector<char> canonicalPieces(Vector<char> pieces) {
+    pieces.sort();
+    Vector<char> result;
+    for (char piece : pieces) {
+        if (piece == 'K') {
+            result.add(piece);
+        }
+    }
+    for (char piece : pieces) {
+        if (piece != 'K') {
+            result.add(piece);
+        }
+    }
+    return result;
+}
+
+/* This function takes in the opponent king location and pieces and returns the canonical king square as one
+ * character followed by the canonical pieces.
+ */
+string canonicalKey(GridLocation kingLoc, Vector<char> pieces) {
+    GridLocation loc = transformLoc(kingLoc, canonicalSymmetry(kingLoc));
+    string key(1, char(loc.row * 8 + loc.col));
+    for (char piece : canonicalPieces(pieces)) {
+        key += piece;
+    }
+    return key;
+}
+
+/* * * * * Provided Tests Below This Point * * * * */
+
+PROVIDED_TEST("Symmetries and their inverses") {
+    for (int symmetry = 0; symmetry < kNumSymmetries; symmetry++) {
+        Set<GridLocation> image;
+        for (int row = 0; row < 8; row++) {
+            for (int col = 0; col < 8; col++) {
+                GridLocation loc = transformLoc(GridLocation(row, col), symmetry);
+                image.add(loc);
+                EXPECT_EQUAL(transformLoc(loc, inverseSymmetry(symmetry)), GridLocation(row, col));
+            }
+        }
+        EXPECT_EQUAL(image.size(), 64);
+    }
+}
+
+PROVIDED_TEST("Canonical king squares") {
+    int canonical = 0;
+    for (int square = 0; square < 64; square++) {
+        GridLocation loc(square / 8, square % 8);
+        int index = canonicalKingIndex(loc);
+        EXPECT_EQUAL(index >= 0, transformLoc(loc, canonicalSymmetry(loc)) == loc);
+        if (index >= 0) {
+            EXPECT_EQUAL(canonicalKingSquare(index), loc);
+            canonical++;
+        }
+    }
+    EXPECT_EQUAL(canonical, kNumCanonicalKings);
+}
+
+PROVIDED_TEST("canonicalKey") {
+    EXPECT_EQUAL(canonicalKey(GridLocation(6, 1), {'K', 'Q', 'B'}), canonicalKey(GridLocation(1, 1), {'B', 'K', 'Q'}));
+    EXPECT_EQUAL(canonicalKey(GridLocation(2, 5), {'K', 'R'}), canonicalKey(GridLocation(5, 2), {'K', 'R'}));
+    EXPECT(canonicalKey(GridLocation(2, 5), {'K', 'R'}) != canonicalKey(GridLocation(2, 4), {'K', 'R'}));
+
+    Set<string> squares;
+    for (int row = 0; row < 8; row++) {
+        for (int col = 0; col < 8; col++) {
+            squares.add(canonicalKey(GridLocation(row, col), {}));
+        }
+    }
+    EXPECT_EQUAL(squares.size(), 10);
+}
+
+PROVIDED_TEST("transformPlacement keeps a stalemate") {
+    clearBoard();
+    GridLocation kingLoc = GridLocation(1, 1);
+    Map<char, Vector<GridLocation>> placement = {{'Q', {GridLocation(3, 0)}}, {'K', {GridLocation(1, 3)}},
+                                                 {'B', {GridLocation(3, 4)}}};
+    for (int symmetry = 0; symmetry < kNumSymmetries; symmetry++) {
+        EXPECT(isStalemate(transformLoc(kingLoc, symmetry), transformPlacement(placement, symmetry)));
+    }
+}
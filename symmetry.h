@@ -0,0 +1,90 @@
+/*
+ * This file contains the declarations for the symmetries of the board (rotations and reflections) and the canonical
+ * form of a problem under them
+ */
+#pragma once
+
+#include <string>
+#include "map.h"
+#include "vector.h"
+#include "martin.h"
+
+/** Number of symmetries of the board: four rotations, each with or without a reflection
+ */
+const int kNumSymmetries = 8;
+
+/** Number of canonical king squares, the squares with row <= col <= 3
+ */
+const int kNumCanonicalKings = 10;
+
+/**
+ * Apply a symmetry to a location; symmetry 0 is the identity
+ * @param location and symmetry from 0 to 7
+ * @return transformed location
+ *
+ * This function runs in O(1)
+ */
+GridLocation transformLoc(GridLocation loc, int symmetry);
+
+/**
+ * Find the symmetry that undoes another
+ * @param symmetry
+ * @return inverse symmetry
+ *
+ * This function runs in O(1)
+ */
+int inverseSymmetry(int symmetry);
+
+/**
+ * Apply a symmetry to every location of a placement; the pieces move symmetrically, so a stalemate stays a stalemate
+ * @param map of pieces to their locations and symmetry
+ * @return transformed map
+ *
+ * This function runs in O(n) for n pieces
+ */
+Map<char, Vector<GridLocation>> transformPlacement(Map<char, Vector<GridLocation>> placement, int symmetry);
+
+/**
+ * Find the symmetry that takes the king to its canonical square, the lowest row * 8 + col square it can reach
+ * @param opponent king location
+ * @return smallest such symmetry
+ *
+ * This function runs in O(1)
+ */
+int canonicalSymmetry(GridLocation kingLoc);
+
+/**
+ * Number a canonical king square among the canonical squares in increasing order
+ * @param king location
+ * @return index from 0 to kNumCanonicalKings - 1, or -1 if the square is not canonical
+ *
+ * This function runs in O(1)
+ */
+int canonicalKingIndex(GridLocation kingLoc);
+
+/**
+ * The canonical king square with a given index, the inverse of canonicalKingIndex
+ * @param index from 0 to kNumCanonicalKings - 1
+ * @return king location
+ *
+ * This function runs in O(1)
+ */
+GridLocation canonicalKingSquare(int index);
+
+/**
+ * Canonical order of pieces: kings first, then the rest sorted
+ * @param pieces
+ * @return sorted pieces
+ *
+ * This function runs in O(n log n) for n pieces
+ */
+Vector<char> canonicalPieces(Vector<char> pieces);
+
+/**
+ * Canonical form of a problem: the king on its canonical square and the pieces sorted
+ * @param opponent king location and pieces
+ * @return key shared by every problem equal to this one up to symmetry and piece order
+ *
+ * This function runs in O(n log n) for n pieces
+ */
+std::string canonicalKey(GridLocation kingLoc, Vector<char> pieces);